@@ -115,25 +115,38 @@ HRESULT LoadTextureDataFromFile( __in_z const WCHAR* szFileName, BYTE** ppHeapDa
         return E_FAIL;
     }
 
-    // DDS files always start with the same magic number ("DDS ")
-    DWORD dwMagicNumber = *( DWORD* )( *ppHeapData );
-    if( dwMagicNumber != DDS_MAGIC )
+    CloseHandle( hFile );
+
+    HRESULT hr = ParseTextureDataFromMemory( *ppHeapData, FileSize.LowPart, ppHeader, ppBitData, pBitSize );
+    if( FAILED( hr ) )
     {
-        CloseHandle( hFile );
         SAFE_DELETE_ARRAY( *ppHeapData );
-        return E_FAIL;
     }
 
-    DDS_HEADER* pHeader = reinterpret_cast<DDS_HEADER*>( *ppHeapData + sizeof( DWORD ) );
+    return hr;
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT ParseTextureDataFromMemory( BYTE* pData, UINT DataSize,
+                                    DDS_HEADER** ppHeader,
+                                    BYTE** ppBitData, UINT* pBitSize )
+{
+    // Need at least enough data to fill the header and magic number to be a valid DDS
+    if( DataSize < (sizeof(DDS_HEADER)+sizeof(DWORD)) )
+        return E_FAIL;
+
+    // DDS files always start with the same magic number ("DDS ")
+    DWORD dwMagicNumber = *( DWORD* )( pData );
+    if( dwMagicNumber != DDS_MAGIC )
+        return E_FAIL;
+
+    DDS_HEADER* pHeader = reinterpret_cast<DDS_HEADER*>( pData + sizeof( DWORD ) );
 
     // Verify header to validate DDS file
     if( pHeader->dwSize != sizeof(DDS_HEADER)
         || pHeader->ddspf.dwSize != sizeof(DDS_PIXELFORMAT) )
-    {
-        CloseHandle( hFile );
-        SAFE_DELETE_ARRAY( *ppHeapData );
         return E_FAIL;
-    }
 
     // Check for DX10 extension
     bool bDXT10Header = false;
@@ -141,12 +154,8 @@ HRESULT LoadTextureDataFromFile( __in_z const WCHAR* szFileName, BYTE** ppHeapDa
         && (MAKEFOURCC( 'D', 'X', '1', '0' ) == pHeader->ddspf.dwFourCC) )
     {
         // Must be long enough for both headers and magic value
-        if( FileSize.LowPart < (sizeof(DDS_HEADER)+sizeof(DWORD)+sizeof(DDS_HEADER_DXT10)) )
-        {
-            CloseHandle( hFile );
-            SAFE_DELETE_ARRAY( *ppHeapData );
+        if( DataSize < (sizeof(DDS_HEADER)+sizeof(DWORD)+sizeof(DDS_HEADER_DXT10)) )
             return E_FAIL;
-        }
 
         bDXT10Header = true;
     }
@@ -155,10 +164,8 @@ HRESULT LoadTextureDataFromFile( __in_z const WCHAR* szFileName, BYTE** ppHeapDa
     *ppHeader = pHeader;
     INT offset = sizeof( DWORD ) + sizeof( DDS_HEADER )
                  + (bDXT10Header ? sizeof( DDS_HEADER_DXT10 ) : 0);
-    *ppBitData = *ppHeapData + offset;
-    *pBitSize = FileSize.LowPart - offset;
-
-    CloseHandle( hFile );
+    *ppBitData = pData + offset;
+    *pBitSize = DataSize - offset;
 
     return S_OK;
 }
@@ -1063,6 +1070,17 @@ static HRESULT CreateTextureFromDDS( ID3D11Device* pDev, DDS_HEADER* pHeader, __
 }
 
 
+//--------------------------------------------------------------------------------------
+HRESULT CreateDDSTextureFromMemory( __in ID3D11Device* pDev, __in DDS_HEADER* pHeader, __in BYTE* pBitData, UINT BitSize,
+                                    __out_opt ID3D11ShaderResourceView** ppSRV, bool sRGB )
+{
+    if ( !pDev || !pHeader || !pBitData || !ppSRV )
+        return E_INVALIDARG;
+
+    return CreateTextureFromDDS( pDev, pHeader, pBitData, BitSize, ppSRV, sRGB );
+}
+
+
 //--------------------------------------------------------------------------------------
 HRESULT CreateDDSTextureFromFile( __in ID3D11Device* pDev, __in_z const WCHAR* szFileName, __out_opt ID3D11ShaderResourceView** ppSRV, bool sRGB )
 {
@@ -6,6 +6,8 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 //--------------------------------------------------------------------------------------
 
+#pragma once
+
 #include "DDS.h"
 #include <d3d11.h>
 
@@ -16,3 +18,10 @@ DXGI_FORMAT GetDXGIFormat( const DDS_PIXELFORMAT& ddpf );
 HRESULT LoadTextureDataFromFile(__in_z const WCHAR* szFileName, BYTE** ppHeapData,
                                 DDS_HEADER** ppHeader,
                                 BYTE** ppBitData, UINT* pBitSize);
+// INTEL: Validates a DDS file already in memory (e.g. mapped) and returns pointers into it; no copies are made
+HRESULT ParseTextureDataFromMemory( BYTE* pData, UINT DataSize,
+                                    DDS_HEADER** ppHeader,
+                                    BYTE** ppBitData, UINT* pBitSize );
+// INTEL: Create from already loaded data (see LoadTextureDataFromFile) so files can be shared between workloads
+HRESULT CreateDDSTextureFromMemory( __in ID3D11Device* pDev, __in DDS_HEADER* pHeader, __in BYTE* pBitData, UINT BitSize,
+                                    __out_opt ID3D11ShaderResourceView** ppSRV, bool sRGB = false );
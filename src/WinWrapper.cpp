@@ -31,6 +31,21 @@
 #include "camera.h"
 #include "profile.h"
 #include "gui.h"
+#include "startup.h"
+#include "texture.h"
+#include "asset_loader.h"
+#include "frame_governor.h"
+#include "frame_pacer.h"
+#include "perf_overlay.h"
+#include "metrics_shm.h"
+#include "sampling_profiler.h"
+#include "benchmark_results.h"
+#include "scenario.h"
+#include "sim_shards.h"
+#include "sim_publish.h"
+#include "starfield.h"
+#include "asset_params.h"
+#include "self_test.h"
 
 #include <fstream>
 #include <utility>
@@ -53,6 +68,9 @@ GUI gGUI;
 GUISprite* gD3D11Control;
 GUISprite* gD3D12Control;
 GUIText* gFPSControl;
+PerfOverlay* gPerfOverlay;
+
+const char* SKYBOX_FILE_NAME = "starbox_1024.dds";
 
 enum
 {
@@ -125,6 +143,23 @@ void ToggleFullscreen(HWND hWnd)
     }
 }
 
+// After a change of window size or render scale
+void ResizeRenderTarget(HWND hWnd)
+{
+    gSettings.renderWidth = (UINT)(double(gSettings.windowWidth)  * gSettings.renderScale);
+    gSettings.renderHeight = (UINT)(double(gSettings.windowHeight) * gSettings.renderScale);
+
+    // Update camera projection
+    float aspect = (float)gSettings.renderWidth / (float)gSettings.renderHeight;
+    gCamera.Projection(XM_PIDIV2 * 0.8f * 3 / 2, aspect);
+
+    // Resize currently active swap chain
+    if (gSettings.d3d12)
+        gWorkloadD3D12->ResizeSwapChain(gDXGIFactory, hWnd, gSettings.renderWidth, gSettings.renderHeight);
+    else
+        gWorkloadD3D11->ResizeSwapChain(gDXGIFactory, hWnd, gSettings.renderWidth, gSettings.renderHeight);
+}
+
 
 } // namespace
 
@@ -150,18 +185,7 @@ LRESULT CALLBACK WindowProc(
 
             gSettings.windowWidth = (int)ww;
             gSettings.windowHeight = (int)wh;
-            gSettings.renderWidth = (UINT)(double(gSettings.windowWidth)  * gSettings.renderScale);
-            gSettings.renderHeight = (UINT)(double(gSettings.windowHeight) * gSettings.renderScale);
-
-            // Update camera projection
-            float aspect = (float)gSettings.renderWidth / (float)gSettings.renderHeight;
-            gCamera.Projection(XM_PIDIV2 * 0.8f * 3 / 2, aspect);
-
-            // Resize currently active swap chain
-            if (gSettings.d3d12)
-                gWorkloadD3D12->ResizeSwapChain(gDXGIFactory, hWnd, gSettings.renderWidth, gSettings.renderHeight);
-            else
-                gWorkloadD3D11->ResizeSwapChain(gDXGIFactory, hWnd, gSettings.renderWidth, gSettings.renderHeight);
+            ResizeRenderTarget(hWnd);
 
             return 0;
         }
@@ -194,6 +218,10 @@ LRESULT CALLBACK WindowProc(
                 gSettings.submitRendering = !gSettings.submitRendering;
                 std::cout << "Submit Rendering: " << gSettings.submitRendering << std::endl;
                 return 0;
+            case 'P':
+                gSettings.perfOverlay = !gSettings.perfOverlay;
+                gPerfOverlay->Visible(gSettings.perfOverlay);
+                return 0;
 
             case '1': gSettings.d3d12 = (gWorkloadD3D11 == nullptr); return 0;
             case '2': gSettings.d3d12 = (gWorkloadD3D12 != nullptr); return 0;
@@ -276,6 +304,21 @@ int main(int argc, char** argv)
     gSettings.windowWidth *= dpi / 96;
     gSettings.windowHeight *= dpi / 96;
 
+    std::string writeAssetPackFileName;
+    std::string readMetricsName;
+    std::string compareBaselineFileName;
+    std::string compareCandidateFileName;
+    double compareThresholdPercent = 5.0;
+    std::string scenarioName;
+    unsigned int simulationShardCount = 0;
+    std::string simulationWorkerName;
+    unsigned int simulationWorkerShard = 0;
+    std::string publishSimulationName;
+    std::string viewSimulationName;
+    std::string assetParamsFileName;
+    bool runSelfTests = false;
+    std::vector<AsteroidField> asteroidFields;
+    std::vector<float> asteroidFieldShares;
     for (int a = 1; a < argc; ++a) {
         if (_stricmp(argv[a], "-close_after") == 0 && a + 1 < argc) {
             gSettings.closeAfterSeconds = atof(argv[++a]);
@@ -294,17 +337,112 @@ int main(int argc, char** argv)
             gSettings.windowHeight = atoi(argv[++a]);
         } else if (_stricmp(argv[a], "-render_scale") == 0 && a + 1 < argc) {
             gSettings.renderScale = atof(argv[++a]);
+        } else if (_stricmp(argv[a], "-target_fps") == 0) {
+            gSettings.targetFrameRate = 60.0;
+            if (a + 1 < argc && argv[a + 1][0] >= '0' && argv[a + 1][0] <= '9') {
+                gSettings.targetFrameRate = atof(argv[++a]);
+            }
+        } else if (_stricmp(argv[a], "-full_lod") == 0) {
+            gSettings.incrementalLOD = false;
+        } else if (_stricmp(argv[a], "-perf_overlay") == 0) {
+            gSettings.perfOverlay = true;
+        } else if (_stricmp(argv[a], "-triangle_budget") == 0 && a + 1 < argc) {
+            gSettings.triangleBudget = atoi(argv[++a]);
         } else if (_stricmp(argv[a], "-locked_fps") == 0 && a + 1 < argc) {
             gSettings.lockedFrameRate = atoi(argv[++a]);
         } else if (_stricmp(argv[a], "-stats_csv_file_name") == 0 && a + 1 < argc) {
             gSettings.statsCsvFileName = argv[++a];
         } else if (_stricmp(argv[a], "-stats_summary_csv_file_name") == 0 && a + 1 < argc) {
             gSettings.statsSummaryCsvFileName = argv[++a];
+        } else if (_stricmp(argv[a], "-startup_json_file_name") == 0 && a + 1 < argc) {
+            gSettings.startupJsonFileName = argv[++a];
+        } else if (_stricmp(argv[a], "-threadpool_io") == 0) {
+            gSettings.threadPoolIO = true;
+        } else if (_stricmp(argv[a], "-io_read_into_memory") == 0) {
+            gSettings.ioReadIntoMemory = true;
+        } else if (_stricmp(argv[a], "-procedural_skybox") == 0) {
+            gSettings.proceduralSkybox = true;
+            if (a + 1 < argc && argv[a + 1][0] >= '0' && argv[a + 1][0] <= '9') {
+                gSettings.skyboxResolution = atoi(argv[++a]);
+            }
+            if (gSettings.skyboxResolution == 0 || (gSettings.skyboxResolution & (gSettings.skyboxResolution - 1)) != 0) {
+                fprintf(stderr, "error: skybox resolution must be a power of two\n");
+                return -1;
+            }
+        } else if (_stricmp(argv[a], "-skybox_seed") == 0 && a + 1 < argc) {
+            gSettings.skyboxSeed = atoi(argv[++a]);
+        } else if (_stricmp(argv[a], "-mesh_baked_noise") == 0) {
+            gSettings.meshBakedNoiseTolerance = 0.01f;
+            if (a + 1 < argc && ((argv[a + 1][0] >= '0' && argv[a + 1][0] <= '9') || argv[a + 1][0] == '.')) {
+                gSettings.meshBakedNoiseTolerance = (float)atof(argv[++a]);
+            }
+            if (gSettings.meshBakedNoiseTolerance <= 0.0f) {
+                fprintf(stderr, "error: mesh baked noise tolerance must be positive\n");
+                return -1;
+            }
+        } else if (_stricmp(argv[a], "-mesh_craters") == 0) {
+            gSettings.meshCraterCount = 300;
+            if (a + 1 < argc && argv[a + 1][0] >= '0' && argv[a + 1][0] <= '9') {
+                gSettings.meshCraterCount = atoi(argv[++a]);
+            }
+        } else if (_stricmp(argv[a], "-texture_pool") == 0) {
+            gSettings.texturePoolSize = 4096;
+            if (a + 1 < argc && argv[a + 1][0] >= '0' && argv[a + 1][0] <= '9') {
+                gSettings.texturePoolSize = atoi(argv[++a]);
+            }
+        } else if (_stricmp(argv[a], "-texture_pool_mb") == 0 && a + 1 < argc) {
+            gSettings.texturePoolBudgetMB = atoi(argv[++a]);
+        } else if (_stricmp(argv[a], "-asset_pack") == 0 && a + 1 < argc) {
+            gSettings.assetPackFileName = argv[++a];
+        } else if (_stricmp(argv[a], "-write_asset_pack") == 0 && a + 1 < argc) {
+            writeAssetPackFileName = argv[++a];
+        } else if (_stricmp(argv[a], "-publish_metrics") == 0) {
+            gSettings.metricsName = (a + 1 < argc && argv[a + 1][0] != '-') ? argv[++a] : DEFAULT_METRICS_NAME;
+        } else if (_stricmp(argv[a], "-read_metrics") == 0) {
+            readMetricsName = (a + 1 < argc && argv[a + 1][0] != '-') ? argv[++a] : DEFAULT_METRICS_NAME;
+        } else if (_stricmp(argv[a], "-results_json_file_name") == 0 && a + 1 < argc) {
+            gSettings.resultsJsonFileName = argv[++a];
+        } else if (_stricmp(argv[a], "-compare_results") == 0 && a + 2 < argc) {
+            compareBaselineFileName = argv[++a];
+            compareCandidateFileName = argv[++a];
+            if (a + 1 < argc && argv[a + 1][0] >= '0' && argv[a + 1][0] <= '9') {
+                compareThresholdPercent = atof(argv[++a]);
+            }
+        } else if (_stricmp(argv[a], "-sim_shards") == 0 && a + 1 < argc) {
+            simulationShardCount = atoi(argv[++a]);
+        } else if (_stricmp(argv[a], "-sim_worker") == 0 && a + 2 < argc) {
+            simulationWorkerName = argv[++a];
+            simulationWorkerShard = atoi(argv[++a]);
+        } else if (_stricmp(argv[a], "-publish_simulation") == 0) {
+            publishSimulationName = (a + 1 < argc && argv[a + 1][0] != '-') ? argv[++a] : DEFAULT_SIMULATION_NAME;
+        } else if (_stricmp(argv[a], "-view_simulation") == 0) {
+            viewSimulationName = (a + 1 < argc && argv[a + 1][0] != '-') ? argv[++a] : DEFAULT_SIMULATION_NAME;
+        } else if (_stricmp(argv[a], "-selftest") == 0) {
+            runSelfTests = true;
+        } else if (_stricmp(argv[a], "-asset_params") == 0 && a + 1 < argc) {
+            assetParamsFileName = argv[++a];
+        } else if (_stricmp(argv[a], "-asteroid_field") == 0 && a + 1 < argc &&
+                   asteroidFields.size() < MAX_ASTEROID_FIELDS) {
+            auto field = DefaultAsteroidField(0);
+            auto numberFollows = [&]() { return a + 1 < argc && argv[a + 1][0] >= '0' && argv[a + 1][0] <= '9'; };
+            asteroidFieldShares.push_back(std::max(0.0f, (float)atof(argv[++a])));
+            if (numberFollows()) field.orbitRadius = (float)atof(argv[++a]);
+            if (numberFollows()) field.discRadius = (float)atof(argv[++a]);
+            if (numberFollows()) field.tilt = XMConvertToRadians((float)atof(argv[++a]));
+            asteroidFields.push_back(field);
+        } else if (_stricmp(argv[a], "-scenario") == 0 && a + 1 < argc) {
+            scenarioName = argv[++a];
+        } else if (_stricmp(argv[a], "-sample_profile") == 0 && a + 1 < argc) {
+            gSettings.sampleProfileFileName = argv[++a];
+            if (a + 1 < argc && argv[a + 1][0] >= '0' && argv[a + 1][0] <= '9') {
+                gSettings.sampleProfileHz = atoi(argv[++a]);
+            }
         } else {
             fprintf(stderr, "error: unrecognized argument '%s'\n", argv[a]);
             fprintf(stderr, "usage: asteroids_d3d12 [options]\n");
             fprintf(stderr, "options:\n");
             fprintf(stderr, "  -close_after [seconds]\n");
+            fprintf(stderr, "  -scenario <flythrough|closeup|wide|scenario file name>\n");
             fprintf(stderr, "  -nod3d11\n");
             fprintf(stderr, "  -nod3d12\n");
             fprintf(stderr, "  -fullscreen\n");
@@ -312,12 +450,63 @@ int main(int argc, char** argv)
             fprintf(stderr, "  -render_scale [scale]\n");
             fprintf(stderr, "  -stats_csv_file_name <stats csv file name>\n");
             fprintf(stderr, "  -stats_summary_csv_file_name <stats summary csv file name>\n");
+            fprintf(stderr, "  -startup_json_file_name <startup report json file name>\n");
+            fprintf(stderr, "  -results_json_file_name <benchmark results json file name>\n");
+            fprintf(stderr, "  -compare_results <baseline json> <candidate json> [regression threshold %%]\n");
+            fprintf(stderr, "  -selftest\n");
+            fprintf(stderr, "  -threadpool_io\n");
+            fprintf(stderr, "  -io_read_into_memory\n");
+            fprintf(stderr, "  -procedural_skybox [resolution]\n");
+            fprintf(stderr, "  -skybox_seed [seed]\n");
+            fprintf(stderr, "  -mesh_baked_noise [bake tolerance]\n");
+            fprintf(stderr, "  -mesh_craters [count]\n");
+            fprintf(stderr, "  -texture_pool [count]\n");
+            fprintf(stderr, "  -texture_pool_mb [MB]\n");
+            fprintf(stderr, "  -asset_pack <asset pack file name>\n");
+            fprintf(stderr, "  -write_asset_pack <asset pack file name>\n");
             fprintf(stderr, "  -locked_fps [fps]\n");
+            fprintf(stderr, "  -target_fps [fps]\n");
+            fprintf(stderr, "  -triangle_budget <triangles per frame>\n");
+            fprintf(stderr, "  -asteroid_field <share of asteroids> [orbit radius] [disc radius] [tilt degrees]\n");
+            fprintf(stderr, "  -sim_shards <worker process count>\n");
+            fprintf(stderr, "  -publish_simulation [name]\n");
+            fprintf(stderr, "  -view_simulation [name]\n");
+            fprintf(stderr, "  -asset_params <asset parameters file name>\n");
+            fprintf(stderr, "  -full_lod\n");
+            fprintf(stderr, "  -perf_overlay\n");
+            fprintf(stderr, "  -publish_metrics [name]\n");
+            fprintf(stderr, "  -read_metrics [name]\n");
+            fprintf(stderr, "  -sample_profile <folded stacks file name> [Hz]\n");
             fprintf(stderr, "  -warp\n");
             return -1;
         }
     }
 
+    // Reader modes: no window or device
+    if (!readMetricsName.empty()) {
+        return RunMetricsReader(readMetricsName);
+    }
+    if (!compareBaselineFileName.empty()) {
+        return RunBenchmarkComparison(compareBaselineFileName, compareCandidateFileName, compareThresholdPercent);
+    }
+    if (runSelfTests) {
+        return RunSelfTests() == 0 ? 0 : -1;
+    }
+    if (!simulationWorkerName.empty()) {
+        return RunSimulationWorker(simulationWorkerName, simulationWorkerShard);
+    }
+
+    // A scenario runs to its end (or -close_after, if sooner) on scenario time, which advances by a fixed step
+    Scenario scenario;
+    if (!scenarioName.empty()) {
+        if (FAILED(scenario.Load(scenarioName))) return -1;
+        if (gSettings.closeAfterSeconds <= 0.0 || gSettings.closeAfterSeconds > scenario.Duration()) {
+            gSettings.closeAfterSeconds = scenario.Duration();
+        }
+        std::cout << "Scenario '" << scenario.Name() << "': " << scenario.Duration() << " s in steps of "
+                  << 1000.0 * scenario.TimeStep() << " ms" << std::endl;
+    }
+
     if (!d3d11Available && !d3d12Available) {
         fprintf(stderr, "error: neither D3D11 nor D3D12 available.\n");
         return -1;
@@ -330,40 +519,190 @@ int main(int argc, char** argv)
     gD3D12Control = gGUI.AddSprite(5, 10, 140, 50, "directx12.dds");
     gD3D11Control = gGUI.AddSprite(5, 10, 140, 50, "directx11.dds");
     gFPSControl = gGUI.AddText(150, 10);
+    gPerfOverlay = new PerfOverlay(&gGUI, 5, 70, 1.0 / (gSettings.targetFrameRate > 0.0 ? gSettings.targetFrameRate : 60.0));
+    gPerfOverlay->Visible(gSettings.perfOverlay);
+
+    if (!writeAssetPackFileName.empty()) {
+        std::vector<std::string> fileNames(1, SKYBOX_FILE_NAME);
+        for (size_t i = 0; i < gGUI.size(); ++i) {
+            auto textureFile = gGUI[i]->TextureFile();
+            if (textureFile.length() > 0 && !IsGeneratedGUITexture(textureFile)) fileNames.push_back(textureFile);
+        }
+        return SUCCEEDED(AssetPack::Write(writeAssetPackFileName.c_str(), fileNames)) ? 0 : -1;
+    }
 
     ResetCameraView();
     // Camera projection set up in WM_SIZE
 
-    AsteroidsSimulation asteroids(1337, NUM_ASTEROIDS, NUM_UNIQUE_MESHES, MESH_MAX_SUBDIV_LEVELS, NUM_UNIQUE_TEXTURES);
+    // Fields split the asteroids in proportion to their shares; the renderers are sized for NUM_ASTEROIDS
+    if (asteroidFields.empty()) {
+        asteroidFields.push_back(DefaultAsteroidField(NUM_ASTEROIDS));
+    } else {
+        float totalShare = 0.0f;
+        for (auto share : asteroidFieldShares) totalShare += share;
+        unsigned int assigned = 0;
+        for (size_t f = 0; f < asteroidFields.size(); ++f) {
+            auto count = f + 1 == asteroidFields.size() ? NUM_ASTEROIDS - assigned :
+                totalShare > 0.0f ? (unsigned int)(NUM_ASTEROIDS * (asteroidFieldShares[f] / totalShare)) : 0;
+            asteroidFields[f].asteroidCount = std::min(count, NUM_ASTEROIDS - assigned);
+            assigned += asteroidFields[f].asteroidCount;
+        }
+    }
+
+    // Generation parameters; edits to the file are applied while running (see the main loop). A viewer
+    // draws the publisher's assets, so has none of its own.
+    AssetParams assetParams;
+    std::unique_ptr<FileWatcher> assetParamsWatcher;
+    if (!assetParamsFileName.empty() && !viewSimulationName.empty()) {
+        fprintf(stderr, "warning: -asset_params ignored when viewing a simulation\n");
+    } else if (!assetParamsFileName.empty()) {
+        if (FAILED(LoadAssetParams(assetParamsFileName, &assetParams))) return -1;
+        assetParamsWatcher.reset(new FileWatcher(assetParamsFileName));
+    }
+    if (gSettings.meshCraterCount) assetParams.meshes.craterCount = gSettings.meshCraterCount;
+
+    // Every field draws on the same meshes and textures
+    const unsigned int simulationSeed = 1337;
+    auto asteroidAssets = std::make_shared<AsteroidAssets>(simulationSeed, NUM_UNIQUE_MESHES, assetParams.subdivCount,
+                                                           NUM_UNIQUE_TEXTURES, assetParams);
+    AsteroidsSimulation asteroids(asteroidAssets, simulationSeed, asteroidFields.data(), (unsigned int)asteroidFields.size());
+    asteroids.SetColorSchemes(assetParams.colorSchemes);
+    SimulationViewer simulationViewer;
+
+    // If requested, enumerate the warp adapter
+    // TODO: Allow picking from multiple hardware adapters
+    IDXGIAdapter1* adapter = nullptr;
+    if (d3d12Available && gSettings.warp) {
+        IDXGIFactory4* DXGIFactory4 = nullptr;
+        if (FAILED(gDXGIFactory->QueryInterface(&DXGIFactory4))) {
+            fprintf(stderr, "error: WARP requires IDXGIFactory4 interface which is not present on this system!\n");
+            return -1;
+        }
+
+        auto hr = DXGIFactory4->EnumWarpAdapter(IID_PPV_ARGS(&adapter));
+        DXGIFactory4->Release();
+
+        if (FAILED(hr)) {
+            fprintf(stderr, "error: WARP adapter not present on this system!\n");
+            return -1;
+        }
+    }
+
+    // Asset generation, file loads and workload creation run as a dependency graph
+    StartupGraph startup;
+
+    AssetPack assetPack;
+    if (!gSettings.assetPackFileName.empty() && FAILED(assetPack.Open(gSettings.assetPackFileName.c_str()))) {
+        fprintf(stderr, "error: failed to open asset pack '%s'\n", gSettings.assetPackFileName.c_str());
+        return -1;
+    }
+
+    // File loads are issued up front and complete in priority order: the GUI sprites are needed for the
+    // first frame, the skybox streams in afterwards so its size doesn't hold up startup
+    AssetLoader assetLoader(gSettings.threadPoolIO ? AssetLoader::BACKEND_THREAD_POOL : AssetLoader::BACKEND_IOCP,
+                            assetPack.IsOpen() ? &assetPack : nullptr, gSettings.ioReadIntoMemory);
+    UINT64 skyboxLoadStart = 0;
+    QueryPerformanceCounter((LARGE_INTEGER*)&skyboxLoadStart);
+
+    std::map<std::string, concurrency::task<const DDSFile*>> spriteLoads;
+    for (size_t i = 0; i < gGUI.size(); ++i) {
+        auto textureFile = gGUI[i]->TextureFile();
+        if (textureFile.length() > 0 && !IsGeneratedGUITexture(textureFile) && spriteLoads.find(textureFile) == spriteLoads.end()) {
+            spriteLoads.emplace(textureFile, assetLoader.Load(textureFile, AssetLoader::PRIORITY_UI));
+        }
+    }
+    auto skyboxLoad = gSettings.proceduralSkybox
+        ? concurrency::task_from_result<const DDSFile*>(nullptr)
+        : assetLoader.Load(SKYBOX_FILE_NAME, AssetLoader::PRIORITY_FULL_RESOLUTION);
+
+    // A viewer uses the publisher's assets rather than generating its own
+    StartupGraph::TaskId simMeshes, simTextures;
+    if (viewSimulationName.empty()) {
+        simMeshes = startup.AddTask("Simulation: meshes", [&]() { asteroidAssets->CreateMeshes(gSettings.meshBakedNoiseTolerance); });
+        simTextures = startup.AddTask("Simulation: textures", [&]() { asteroidAssets->CreateTextures(); });
+    } else {
+        simMeshes = simTextures = startup.AddTask("Simulation: attach to publisher", [&]() {
+            ThrowIfFailed(simulationViewer.Open(viewSimulationName, &asteroids, simulationSeed, 30000));
+        });
+    }
+
+    std::map<std::string, const DDSFile*> spriteFiles;
+    auto loadSprites = startup.AddTask("Load: GUI sprites", [&]() {
+        for (auto& i : spriteLoads) {
+            spriteFiles[i.first] = i.second.get();
+            ThrowIfFailed(spriteFiles[i.first] ? S_OK : E_FAIL);
+        }
+    });
 
     // Create workloads
     if (d3d11Available) {
-        gWorkloadD3D11 = new AsteroidsD3D11::Asteroids(&asteroids, &gGUI, gSettings.warp);
+        auto device = startup.AddTask("D3D11: device and pipelines", [&]() {
+            gWorkloadD3D11 = new AsteroidsD3D11::Asteroids(&asteroids, &gGUI, gSettings.warp);
+            if (gSettings.texturePoolSize) {
+                gWorkloadD3D11->EnableTexturePool(gSettings.texturePoolSize, (UINT64)gSettings.texturePoolBudgetMB << 20);
+            }
+        });
+        startup.AddTask("D3D11: meshes", [&]() { gWorkloadD3D11->CreateMeshes(); }, { device, simMeshes });
+        startup.AddTask("D3D11: textures", [&]() { gWorkloadD3D11->InitializeTextureData(); }, { device, simTextures });
+        startup.AddTask("D3D11: GUI", [&]() { gWorkloadD3D11->CreateGUIResources(spriteFiles); }, { device, loadSprites });
     }
 
     if (d3d12Available) {
-        // If requested, enumerate the warp adapter
-        // TODO: Allow picking from multiple hardware adapters
-        IDXGIAdapter1* adapter = nullptr;
-
-        if (gSettings.warp) {
-            IDXGIFactory4* DXGIFactory4 = nullptr;
-            if (FAILED(gDXGIFactory->QueryInterface(&DXGIFactory4))) {
-                fprintf(stderr, "error: WARP requires IDXGIFactory4 interface which is not present on this system!\n");
-                return -1;
+        auto device = startup.AddTask("D3D12: device and pipelines", [&]() {
+            gWorkloadD3D12 = new AsteroidsD3D12::Asteroids(&asteroids, &gGUI, NUM_SUBSETS, adapter);
+            if (gSettings.texturePoolSize) {
+                gWorkloadD3D12->EnableTexturePool(gSettings.texturePoolSize, (UINT64)gSettings.texturePoolBudgetMB << 20);
             }
+        });
+        startup.AddTask("D3D12: meshes", [&]() { gWorkloadD3D12->CreateMeshes(); }, { device, simMeshes });
+        startup.AddTask("D3D12: textures", [&]() { gWorkloadD3D12->CreateTextures(); }, { device, simTextures });
+        startup.AddTask("D3D12: GUI", [&]() { gWorkloadD3D12->CreateGUIResources(spriteFiles); }, { device, loadSprites });
+    }
 
-            auto hr = DXGIFactory4->EnumWarpAdapter(IID_PPV_ARGS(&adapter));
-            DXGIFactory4->Release();
+    startup.Run();
+    startup.PrintSummary();
 
-            if (FAILED(hr)) {
-                fprintf(stderr, "error: WARP adapter not present on this system!\n");
-                return -1;
-            }
+    SimulationShards simulationShards;
+    if (simulationShardCount > 0) {
+        auto hr = simulationShards.Start(&asteroids, simulationSeed, simulationShardCount);
+        if (FAILED(hr)) {
+            fprintf(stderr, "warning: failed to start %u simulation worker processes (0x%08x); simulating locally\n",
+                    simulationShardCount, (unsigned int)hr);
         }
+    }
 
-        gWorkloadD3D12 = new AsteroidsD3D12::Asteroids(&asteroids, &gGUI, NUM_SUBSETS, adapter);
+    SimulationPublisher simulationPublisher;
+    if (!publishSimulationName.empty() && viewSimulationName.empty() &&
+        FAILED(simulationPublisher.Open(publishSimulationName, asteroids, simulationSeed))) {
+        fprintf(stderr, "warning: failed to publish simulation as '%s'\n", publishSimulationName.c_str());
     }
+
+    // Mips are generated and streamed in coarsest first on a worker while we render; the workloads pick
+    // each step up at the start of a frame
+    TextureMipChain skyboxMips;
+    DDSFile skyboxCache;
+    auto skyboxReady = skyboxLoad.then([&](const DDSFile* file) {
+        if (gSettings.proceduralSkybox) {
+            StarfieldParams params;
+            params.faceSize = gSettings.skyboxResolution;
+            params.seed = gSettings.skyboxSeed;
+            ThrowIfFailed(CreateStarfieldMipChain(params, &skyboxCache, &skyboxMips));
+        } else {
+            ThrowIfFailed(file ? S_OK : E_FAIL);
+            ThrowIfFailed(CreateMipChainFromDDS_XXXX8(*file, &skyboxMips));
+        }
+        concurrency::parallel_invoke(
+            [&]() { if (gWorkloadD3D11) gWorkloadD3D11->CreateSkybox(skyboxMips); },
+            [&]() { if (gWorkloadD3D12) gWorkloadD3D12->CreateSkybox(skyboxMips); });
+
+        // Load through upload, for comparing the loader's paths (-threadpool_io, -io_read_into_memory)
+        UINT64 skyboxLoadEnd = 0, frequency = 0;
+        QueryPerformanceCounter((LARGE_INTEGER*)&skyboxLoadEnd);
+        QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+        std::cout << "Skybox ready " << 1000.0 * double(skyboxLoadEnd - skyboxLoadStart) / double(frequency)
+                  << " ms after its load was issued" << std::endl;
+    });
+
     gSettings.d3d12 = (gWorkloadD3D12 != nullptr);
 
 
@@ -408,6 +747,11 @@ int main(int argc, char** argv)
     QueryPerformanceFrequency((LARGE_INTEGER*)&perfCounterFreq);
     QueryPerformanceCounter((LARGE_INTEGER*)&lastPerfCount);
 
+    // Asset parameter changes regenerate in the background; at most one at a time
+    concurrency::task<AssetChanges> assetRegeneration;
+    bool assetRegenerationPending = false;
+    double nextAssetParamsPoll = 0.0;
+
     // main loop
     double elapsedTime = 0.0;
     double timeInterval = 0.0;
@@ -417,6 +761,7 @@ int main(int argc, char** argv)
     double minFPS = 99999999;
     double maxFPS = 0;
     std::uint64_t numFrames = 0;
+    std::uint64_t numRenderedFrames = 0;
     if (gSettings.statsCsvFileName == "")
     {
         gSettings.statsCsvFileName = "asteroid_summary_stats.csv";
@@ -425,8 +770,51 @@ int main(int argc, char** argv)
     {
         gSettings.statsSummaryCsvFileName = "asteroid_stats.csv";
     }
+    if (gSettings.startupJsonFileName == "")
+    {
+        gSettings.startupJsonFileName = "asteroid_startup_stats.json";
+    }
 
-    std::vector<std::tuple<double, double, double>> fpsHistoryVector;
+    // Also the quality knobs in effect, so the governor's decisions show up in the stats
+    std::vector<std::tuple<double, double, double, WorkloadCounters, FrameGovernor::Decision>> fpsHistoryVector;
+
+    // Starts at full quality; the starting render scale is the most it will use
+    std::unique_ptr<FrameGovernor> governor;
+    if (gSettings.targetFrameRate > 0.0) {
+        FrameGovernor::Config config;
+        config.targetFrameTime = 1.0 / gSettings.targetFrameRate;
+        config.maxRenderScale = gSettings.renderScale;
+        config.minRenderScale = 0.5 * gSettings.renderScale;
+        config.maxDrawBudget = NUM_ASTEROIDS;
+        config.minDrawBudget = NUM_ASTEROIDS / 4;
+        governor.reset(new FrameGovernor(config));
+    }
+
+    FramePacer pacer(double(gSettings.lockedFrameRate));
+
+    MetricsPublisher metrics;
+    if (!gSettings.metricsName.empty()) {
+        if (FAILED(metrics.Open(gSettings.metricsName))) {
+            fprintf(stderr, "warning: failed to publish metrics as '%s'\n", gSettings.metricsName.c_str());
+        } else {
+            std::cout << "Publishing metrics as '" << gSettings.metricsName << "'" << std::endl;
+        }
+    }
+
+    BenchmarkRecorder benchmark;
+
+    SamplingProfiler sampler(gSettings.sampleProfileHz);
+    auto writeSampleProfile = [&]() {
+        if (gSettings.sampleProfileFileName.empty()) return;
+        sampler.Stop();
+        sampler.PrintSummary();
+        if (FAILED(sampler.WriteFolded(gSettings.sampleProfileFileName))) {
+            fprintf(stderr, "error: failed to write '%s'\n", gSettings.sampleProfileFileName.c_str());
+        }
+    };
+    if (!gSettings.sampleProfileFileName.empty()) {
+        sampler.Start();
+    }
 
     int lastMouseX = 0;
     int lastMouseY = 0;
@@ -448,8 +836,13 @@ int main(int argc, char** argv)
         while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
             if (msg.message == WM_QUIT) {
                 // Cleanup
+                if (pacer.FrameCount()) pacer.PrintSummary();
+                writeSampleProfile();
+                skyboxReady.wait();
+                if (assetRegenerationPending) assetRegeneration.wait();
                 delete gWorkloadD3D11;
                 delete gWorkloadD3D12;
+                delete gPerfOverlay;
                 SafeRelease(&gDXGIFactory);
                 timeEndPeriod(1);
                 EnableMouseInPointer(FALSE);
@@ -460,6 +853,15 @@ int main(int argc, char** argv)
             DispatchMessage(&msg);
         }
 
+        if (!scenarioName.empty()) {
+            auto renderScale = gSettings.renderScale;
+            auto perfOverlay = gSettings.perfOverlay;
+            scenario.ApplySettings(&gSettings);
+            gSettings.d3d12 = gSettings.d3d12 ? (gWorkloadD3D12 != nullptr) : (gWorkloadD3D11 == nullptr);
+            if (gSettings.renderScale != renderScale) ResizeRenderTarget(hWnd);
+            if (gSettings.perfOverlay != perfOverlay) gPerfOverlay->Visible(gSettings.perfOverlay);
+        }
+
         // If we swap to a new API we need to recreate swap chains
         if (d3d12LastFrame != gSettings.d3d12) {
             if (gSettings.d3d12) {
@@ -471,8 +873,44 @@ int main(int argc, char** argv)
             }
         }
 
-        // Still need to process inertia even when no interaction is happening
-        gCamera.ProcessInertia();
+        // Scripted camera; otherwise still need to process inertia even when no interaction is happening
+        if (!scenarioName.empty()) {
+            scenario.ApplyCamera(&gCamera);
+        } else {
+            gCamera.ProcessInertia();
+        }
+
+        // Poll the asset parameters a couple of times a second. Colors apply at once; the meshes and textures
+        // whose parameters changed are regenerated on a worker and uploaded between frames once done.
+        if (assetParamsWatcher) {
+            if (assetRegenerationPending && assetRegeneration.is_done()) {
+                assetRegenerationPending = false;
+                auto changes = assetRegeneration.get();
+                if (gWorkloadD3D11) gWorkloadD3D11->UpdateAssets(changes);
+                if (gWorkloadD3D12) gWorkloadD3D12->UpdateAssets(changes);
+                if (!publishSimulationName.empty()) simulationPublisher.PublishAssets(changes, asteroids);
+                std::cout << "Asset parameters: regenerated " << changes.meshes.size() << " meshes, "
+                          << changes.textures.size() << " textures" << std::endl;
+                if (changes.layout) {
+                    fprintf(stderr, "warning: texture_dim and subdiv_count changes only apply at startup\n");
+                }
+            }
+            if (!assetRegenerationPending && elapsedTime >= nextAssetParamsPoll) {
+                nextAssetParamsPoll = elapsedTime + 0.5;
+                AssetParams params;
+                if (assetParamsWatcher->Changed() && SUCCEEDED(LoadAssetParams(assetParamsFileName, &params))) {
+                    if (gSettings.meshCraterCount) params.meshes.craterCount = gSettings.meshCraterCount;
+                    if (asteroids.SetColorSchemes(params.colorSchemes)) {
+                        if (gWorkloadD3D12) gWorkloadD3D12->UpdateStaticData();
+                        std::cout << "Asset parameters: updated colors" << std::endl;
+                    }
+                    assetRegeneration = concurrency::create_task([asteroidAssets, params]() {
+                        return asteroidAssets->Regenerate(params);
+                    });
+                    assetRegenerationPending = true;
+                }
+            }
+        }
 
         // In D3D12 we'll wait on the GPU before taking the timestamp (more consistent)
         if (gSettings.d3d12) {
@@ -490,6 +928,16 @@ int main(int argc, char** argv)
         double alpha = 0.2f;
         frameTime = alpha * rawFrameTime + (1.0f - alpha) * frameTime;
 
+        if (governor && governor->Update(rawFrameTime)) {
+            auto decision = governor->Current();
+            gSettings.lodBias = decision.lodBias;
+            gSettings.drawBudget = decision.drawBudget;
+            if (decision.renderScale != gSettings.renderScale) {
+                gSettings.renderScale = decision.renderScale;
+                ResizeRenderTarget(hWnd);
+            }
+        }
+
         // Update GUI
         {
             char buffer[256];
@@ -525,7 +973,10 @@ int main(int argc, char** argv)
 
                 if (timeInterval >= 1000)
                 {
-                    fpsHistoryVector.emplace_back(std::make_tuple(elapsedTime, frameTime * 1000.f, rawFrameTime * 1000.f));
+                    // Workload of the last rendered frame
+                    FrameGovernor::Decision knobs = { gSettings.renderScale, gSettings.lodBias, gSettings.drawBudget };
+                    fpsHistoryVector.emplace_back(std::make_tuple(elapsedTime, frameTime * 1000.f, rawFrameTime * 1000.f,
+                                                                  asteroids.FrameCounters(), knobs));
                     timeInterval = 0;
                 }
             }
@@ -536,30 +987,88 @@ int main(int argc, char** argv)
             gD3D11Control->Visible(!gSettings.d3d12);
         }
 
+        // Motion comes from the publisher; the asteroids move under the LOD slack, so LODs are recomputed in full
+        if (!viewSimulationName.empty()) {
+            gSettings.animate = false;
+            gSettings.incrementalLOD = false;
+            simulationViewer.Update(&asteroids);
+
+            // Republished when the publisher's asset parameters change
+            bool colorsChanged = false;
+            auto changes = simulationViewer.UpdateAssets(&asteroids, &colorsChanged);
+            if (colorsChanged && gWorkloadD3D12) gWorkloadD3D12->UpdateStaticData();
+            if (!changes.Empty()) {
+                if (gWorkloadD3D11) gWorkloadD3D11->UpdateAssets(changes);
+                if (gWorkloadD3D12) gWorkloadD3D12->UpdateAssets(changes);
+                std::cout << "Viewed simulation: updated " << changes.meshes.size() << " meshes, "
+                          << changes.textures.size() << " textures" << std::endl;
+            }
+        }
+
+        auto simulationTime = scenarioName.empty() ? frameTime : scenario.TimeStep();
         if (gSettings.d3d12) {
-            gWorkloadD3D12->Render((float)frameTime, gCamera, gSettings);
+            gWorkloadD3D12->Render((float)simulationTime, gCamera, gSettings);
         } else {
-            gWorkloadD3D11->Render((float)frameTime, gCamera, gSettings);
+            gWorkloadD3D11->Render((float)simulationTime, gCamera, gSettings);
         }
+        scenario.Step();
 
-        if (gSettings.lockFrameRate) {
-            ProfileBeginFrameLockWait();
+        if (!publishSimulationName.empty()) {
+            simulationPublisher.Publish(numRenderedFrames, asteroids);
+        }
 
-            UINT64 afterRenderCount;
-            QueryPerformanceCounter((LARGE_INTEGER*)&afterRenderCount);
-            double renderTime = (double)(afterRenderCount - count) / perfCounterFreq;
+        gPerfOverlay->Update(rawFrameTime, [&](PerfOverlay::Counters* counters) {
+            counters->workload = asteroids.FrameCounters();
+            counters->meshBytes = asteroidAssets->MeshBytes();
+            counters->textureBytes = asteroidAssets->TextureBytes();
+            counters->texturePoolBytes = (size_t)(gSettings.d3d12 ? gWorkloadD3D12->TexturePoolBytes()
+                                                                  : gWorkloadD3D11->TexturePoolBytes());
+        });
+
+        if (!gSettings.metricsName.empty()) {
+            MetricsSnapshot snapshot = {};
+            snapshot.frameIndex = numRenderedFrames + 1;
+            snapshot.elapsedSeconds = elapsedTime;
+            snapshot.processId = GetCurrentProcessId();
+            snapshot.d3d12 = gSettings.d3d12;
+            snapshot.workload = asteroids.FrameCounters();
+            snapshot.meshBytes = asteroidAssets->MeshBytes();
+            snapshot.textureBytes = asteroidAssets->TextureBytes();
+            snapshot.texturePoolBytes = gSettings.d3d12 ? gWorkloadD3D12->TexturePoolBytes() : gWorkloadD3D11->TexturePoolBytes();
+            metrics.Publish(rawFrameTime, snapshot);
+        }
 
-            double targetRenderTime = 1.0 / double(gSettings.lockedFrameRate);
-            double deltaMs = (targetRenderTime - renderTime) * 1000.0;
-            if (deltaMs > 1.0) {
-                Sleep((DWORD)deltaMs);
-            }
+        if (gSettings.closeAfterSeconds > 0.0 && !gSettings.resultsJsonFileName.empty()) {
+            benchmark.AddFrame(rawFrameTime);
+        }
 
+        // Startup report covers time to the first presented frame
+        if (numRenderedFrames++ == 0) {
+            startup.MarkFirstFrame();
+            startup.WriteReport(gSettings.startupJsonFileName);
+        }
+
+        if (gSettings.lockFrameRate) {
+            // Scenarios may change the rate; each rate gets its own summary
+            if (double(gSettings.lockedFrameRate) != pacer.FrameRate()) {
+                if (pacer.FrameCount()) pacer.PrintSummary();
+                pacer.SetFrameRate(double(gSettings.lockedFrameRate));
+            }
+            ProfileBeginFrameLockWait();
+            pacer.Wait();
             ProfileEndFrameLockWait();
         }
 
         // All done?
-        if (gSettings.closeAfterSeconds > 0.0 && elapsedTime > gSettings.closeAfterSeconds) {
+        auto runTime = scenarioName.empty() ? elapsedTime : scenario.Time();
+        if (gSettings.closeAfterSeconds > 0.0 && runTime >= gSettings.closeAfterSeconds) {
+            if (pacer.FrameCount()) pacer.PrintSummary();
+            writeSampleProfile();
+
+            if (!gSettings.resultsJsonFileName.empty() &&
+                FAILED(benchmark.Write(gSettings.resultsJsonFileName, gSettings, BenchmarkAdapterName(gDXGIFactory, adapter)))) {
+                fprintf(stderr, "error: failed to write '%s'\n", gSettings.resultsJsonFileName.c_str());
+            }
 
             std::ofstream statsFile;
             statsFile.open(gSettings.statsSummaryCsvFileName);
@@ -569,14 +1078,23 @@ int main(int argc, char** argv)
             statsFile.close();
 
             statsFile.open(gSettings.statsCsvFileName);
-            statsFile << "ElapsedTime(s),FrameTime(ms),RawFrameTime(ms)" << std::endl;
+            statsFile << "ElapsedTime(s),FrameTime(ms),RawFrameTime(ms),Draws,Culled,Indices,EstimatedPixels";
+            for (int l = 0; l <= MESH_MAX_SUBDIV_LEVELS; ++l) statsFile << ",LOD" << l;
+            statsFile << ",RenderScale,LODBias,DrawBudget" << std::endl;
             for (auto sample : fpsHistoryVector)
             {
-                statsFile << std::get<0>(sample) << "," << std::get<1>(sample) << "," << std::get<2>(sample) << std::endl;
+                auto& counters = std::get<3>(sample);
+                statsFile << std::get<0>(sample) << "," << std::get<1>(sample) << "," << std::get<2>(sample) << ","
+                          << counters.draws << "," << counters.culled << "," << counters.indices << ","
+                          << counters.estimatedPixels;
+                for (int l = 0; l <= MESH_MAX_SUBDIV_LEVELS; ++l) statsFile << "," << counters.lodCounts[l];
+                auto& knobs = std::get<4>(sample);
+                statsFile << "," << knobs.renderScale << "," << knobs.lodBias << "," << knobs.drawBudget << std::endl;
             }
             statsFile.close();
 
             SendMessage(hWnd, WM_CLOSE, 0, 0);
+            skyboxReady.wait();
             return 0;
             break;
         }
@@ -0,0 +1,313 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "asset_loader.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+const UINT CHUNK_SIZE = 1024 * 1024;
+const UINT MAX_READS_IN_FLIGHT = 8;
+const UINT THREAD_POOL_SIZE = 2;
+const UINT PAGE_TOUCH_STRIDE = 4096;
+
+// Completion keys
+const ULONG_PTR KEY_FILE = 0;
+const ULONG_PTR KEY_WAKE = 1; // New work queued or shutting down
+
+} // namespace
+
+
+AssetLoader::AssetLoader(Backend backend, const AssetPack* pack, bool readIntoMemory)
+    : mBackend(backend)
+    , mPack(pack)
+    , mReadIntoMemory(readIntoMemory)
+{
+    if (mBackend == BACKEND_IOCP) {
+        // A single thread issues and retires all of the reads
+        mPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+        if (mPort == NULL) {
+            std::cout << "I/O completion port unavailable; falling back to thread pool asset loading." << std::endl;
+            mBackend = BACKEND_THREAD_POOL;
+        }
+    }
+
+    if (mBackend == BACKEND_IOCP) {
+        mThreads.emplace_back(&AssetLoader::IOCPThread, this);
+    } else {
+        for (UINT i = 0; i < THREAD_POOL_SIZE; ++i) {
+            mThreads.emplace_back(&AssetLoader::WorkerThread, this);
+        }
+    }
+}
+
+
+AssetLoader::~AssetLoader()
+{
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this]() { return mOutstanding == 0; });
+        mQuit = true;
+    }
+    mCondition.notify_all();
+    if (mPort) PostQueuedCompletionStatus(mPort, 0, KEY_WAKE, nullptr);
+
+    for (auto& t : mThreads) {
+        t.join();
+    }
+
+    if (mPort) CloseHandle(mPort);
+}
+
+
+concurrency::task<const DDSFile*> AssetLoader::Load(const std::string& fileName, Priority priority)
+{
+    Request* request = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto& slot = mRequests[fileName];
+        if (slot) return slot->task; // NOTE: Keeps the priority of the first request
+
+        slot.reset(new Request);
+        request = slot.get();
+        request->fileName = fileName;
+        request->task = concurrency::create_task(request->loaded);
+        ++mOutstanding;
+    }
+
+    if (mPack && mPack->Contains(fileName)) {
+        // Decompression is compute bound and parallel over chunks already, so it goes straight to the
+        // concurrency runtime rather than through the I/O backends (and their priorities)
+        concurrency::create_task([this, request]() {
+            std::unique_ptr<BYTE[]> data;
+            UINT size = 0;
+            HRESULT hr = mPack->Extract(request->fileName, &data, &size);
+            if (SUCCEEDED(hr)) {
+                hr = request->file.Load(std::move(data), size);
+            }
+            Complete(request, hr);
+        });
+    } else if (mBackend == BACKEND_IOCP) {
+        HRESULT hr = BeginIOCPRequest(request, priority);
+        if (FAILED(hr)) Complete(request, hr);
+    } else {
+        Enqueue(request, priority, 0, 0);
+    }
+
+    return request->task;
+}
+
+
+void AssetLoader::Enqueue(Request* request, Priority priority, UINT offset, UINT size)
+{
+    auto item = new WorkItem;
+    item->request = request;
+    item->priority = priority;
+    item->offset = offset;
+    item->size = size;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        item->sequence = mSequence++;
+        mQueue.push(item);
+    }
+    mCondition.notify_one();
+}
+
+
+void AssetLoader::Complete(Request* request, HRESULT hr)
+{
+    if (request->fileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(request->fileHandle);
+        request->fileHandle = INVALID_HANDLE_VALUE;
+    }
+
+    if (FAILED(hr)) {
+        std::cerr << "error: failed to load '" << request->fileName << "' (hr = 0x"
+            << std::hex << hr << std::dec << ")" << std::endl;
+        request->loaded.set(nullptr);
+    } else {
+        request->loaded.set(&request->file);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        --mOutstanding;
+    }
+    mCondition.notify_all();
+}
+
+
+HRESULT AssetLoader::BeginIOCPRequest(Request* request, Priority priority)
+{
+    if (priority != PRIORITY_UI && !mReadIntoMemory) {
+        return BeginMappedRequest(request, priority);
+    }
+
+    auto file = CreateFileA(request->fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                            FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+    request->fileHandle = file;
+
+    LARGE_INTEGER fileSize = {};
+    if (!GetFileSizeEx(file, &fileSize)) {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+    if (fileSize.HighPart > 0 || fileSize.LowPart == 0) {
+        return E_FAIL;
+    }
+
+    if (CreateIoCompletionPort(file, mPort, KEY_FILE, 0) == NULL) {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    request->size = fileSize.LowPart;
+    request->data.reset(new BYTE[request->size]);
+    request->chunksRemaining = (request->size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+    for (UINT offset = 0; offset < request->size; offset += CHUNK_SIZE) {
+        Enqueue(request, priority, offset, std::min(CHUNK_SIZE, request->size - offset));
+    }
+    PostQueuedCompletionStatus(mPort, 0, KEY_WAKE, nullptr);
+
+    return S_OK;
+}
+
+
+HRESULT AssetLoader::BeginMappedRequest(Request* request, Priority priority)
+{
+    // Mapping only touches the header; the chunks page in the rest
+    HRESULT hr = request->file.Load(request->fileName.c_str(), false);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    request->mapped = true;
+    request->size = request->file.BitSize();
+    if (request->size == 0) {
+        Complete(request, S_OK);
+        return S_OK;
+    }
+    request->chunksRemaining = (request->size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+    for (UINT offset = 0; offset < request->size; offset += CHUNK_SIZE) {
+        Enqueue(request, priority, offset, std::min(CHUNK_SIZE, request->size - offset));
+    }
+    PostQueuedCompletionStatus(mPort, 0, KEY_WAKE, nullptr);
+
+    return S_OK;
+}
+
+
+void AssetLoader::IOCPThread()
+{
+    std::vector<WorkItem*> issue;
+    issue.reserve(MAX_READS_IN_FLIGHT);
+
+    auto retire = [this](WorkItem* item, HRESULT hr) {
+        auto request = item->request;
+        delete item;
+
+        if (FAILED(hr)) request->hr = hr;
+        if (--request->chunksRemaining == 0) {
+            hr = request->hr;
+            if (SUCCEEDED(hr) && !request->mapped) {
+                hr = request->file.Load(std::move(request->data), request->size);
+            }
+            Complete(request, hr);
+        }
+    };
+
+    for (;;) {
+        // Top up the reads in flight, most urgent first
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            while (mReadsInFlight + issue.size() < MAX_READS_IN_FLIGHT && !mQueue.empty()) {
+                issue.push_back(mQueue.top());
+                mQueue.pop();
+            }
+        }
+        for (auto item : issue) {
+            auto request = item->request;
+            if (request->mapped) {
+                // Only queues the page reads, so it completes straight away; the upload waits on any pages
+                // still in flight rather than faulting them in one at a time. Just a hint; ignore failure.
+                WIN32_MEMORY_RANGE_ENTRY range = { const_cast<BYTE*>(request->file.Bits()) + item->offset, item->size };
+                PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+                ++mReadsInFlight;
+                PostQueuedCompletionStatus(mPort, item->size, KEY_FILE, &item->overlapped);
+                continue;
+            }
+            item->overlapped.Offset = item->offset;
+            if (ReadFile(request->fileHandle, request->data.get() + item->offset, item->size, nullptr, &item->overlapped) ||
+                GetLastError() == ERROR_IO_PENDING) {
+                ++mReadsInFlight; // Completion is posted to the port either way
+            } else {
+                retire(item, HRESULT_FROM_WIN32(GetLastError()));
+            }
+        }
+        issue.clear();
+
+        DWORD bytes = 0;
+        ULONG_PTR key = 0;
+        OVERLAPPED* overlapped = nullptr;
+        BOOL ok = GetQueuedCompletionStatus(mPort, &bytes, &key, &overlapped, INFINITE);
+
+        if (overlapped == nullptr) {
+            assert(key == KEY_WAKE);
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mQuit) return;
+            continue;
+        }
+
+        auto item = CONTAINING_RECORD(overlapped, WorkItem, overlapped);
+        --mReadsInFlight;
+        retire(item, !ok ? HRESULT_FROM_WIN32(GetLastError()) : (bytes == item->size ? S_OK : E_FAIL));
+    }
+}
+
+
+void AssetLoader::WorkerThread()
+{
+    for (;;) {
+        WorkItem* item = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this]() { return mQuit || !mQueue.empty(); });
+            if (mQueue.empty()) return; // Quit
+            item = mQueue.top();
+            mQueue.pop();
+        }
+
+        auto request = item->request;
+        delete item;
+
+        HRESULT hr = request->file.Load(request->fileName.c_str());
+        if (SUCCEEDED(hr)) {
+            // Take the page faults here rather than in the upload
+            volatile BYTE touch = 0;
+            auto bits = request->file.Bits();
+            for (UINT offset = 0; offset < request->file.BitSize(); offset += PAGE_TOUCH_STRIDE) {
+                touch = bits[offset];
+            }
+        }
+        Complete(request, hr);
+    }
+}
@@ -0,0 +1,127 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <windows.h>
+#include <ppltasks.h>
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asset_pack.h"
+#include "texture.h"
+
+// Asynchronous DDS file loader.
+// Requests are served highest priority first. Large files are read in chunks so a later, more urgent
+// request doesn't queue up behind the rest of a big one. Completion is signalled through a PPL task so
+// the texture upload can be chained on with then().
+// The IOCP backend reads PRIORITY_UI files into memory. Anything less urgent is mapped instead, so the upload
+// reads the file cache directly rather than a heap copy; its chunks only queue the paging in of their part of
+// the mapping, in priority order.
+class AssetLoader
+{
+public:
+    enum Priority {
+        PRIORITY_UI = 0,            // Small assets needed for the first frame
+        PRIORITY_LOW_MIPS,
+        PRIORITY_FULL_RESOLUTION,   // Can stream in behind the first frames
+    };
+
+    enum Backend {
+        BACKEND_IOCP,               // Overlapped reads serviced through an I/O completion port
+        BACKEND_THREAD_POOL,        // Blocking (memory mapped) loads on a few worker threads
+    };
+
+    // Files found in the pack (if any) are decompressed from it instead of being read from disk.
+    // readIntoMemory has the IOCP backend read every file into memory rather than mapping any (for comparison).
+    explicit AssetLoader(Backend backend = BACKEND_IOCP, const AssetPack* pack = nullptr,
+                         bool readIntoMemory = false);
+    // Waits for any outstanding requests
+    ~AssetLoader();
+
+    // Result is nullptr if the file could not be loaded; otherwise it stays valid for the lifetime of
+    // the loader. Repeated requests for the same file share the load.
+    concurrency::task<const DDSFile*> Load(const std::string& fileName, Priority priority);
+
+    Backend ActiveBackend() const { return mBackend; }
+
+private:
+    struct Request
+    {
+        std::string fileName;
+        DDSFile file;
+        concurrency::task_completion_event<const DDSFile*> loaded;
+        concurrency::task<const DDSFile*> task;
+
+        // IOCP backend only
+        HANDLE fileHandle = INVALID_HANDLE_VALUE;
+        bool mapped = false; // file is already loaded; chunks prefetch it rather than reading into data
+        std::unique_ptr<BYTE[]> data;
+        UINT size = 0;
+        UINT chunksRemaining = 0;
+        HRESULT hr = S_OK;
+    };
+
+    // One read for the IOCP backend, or a whole file for the thread pool
+    struct WorkItem
+    {
+        OVERLAPPED overlapped = {};
+        Request* request = nullptr;
+        Priority priority = PRIORITY_UI;
+        UINT64 sequence = 0; // FIFO within a priority
+        UINT offset = 0;
+        UINT size = 0;
+    };
+
+    struct WorkItemOrder
+    {
+        bool operator()(const WorkItem* a, const WorkItem* b) const
+        {
+            return a->priority != b->priority ? a->priority > b->priority : a->sequence > b->sequence;
+        }
+    };
+
+    void Enqueue(Request* request, Priority priority, UINT offset, UINT size);
+    void Complete(Request* request, HRESULT hr);
+
+    HRESULT BeginIOCPRequest(Request* request, Priority priority);
+    HRESULT BeginMappedRequest(Request* request, Priority priority);
+    void IOCPThread();
+    void WorkerThread();
+
+    Backend mBackend;
+    const AssetPack* mPack;
+    bool mReadIntoMemory;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::priority_queue<WorkItem*, std::vector<WorkItem*>, WorkItemOrder> mQueue;
+    std::map<std::string, std::unique_ptr<Request>> mRequests;
+    UINT64 mSequence = 0;
+    UINT mOutstanding = 0; // Requests not yet completed
+    bool mQuit = false;
+
+    HANDLE mPort = NULL;
+    UINT mReadsInFlight = 0; // IOCP thread only
+    std::vector<std::thread> mThreads;
+};
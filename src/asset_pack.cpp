@@ -0,0 +1,322 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "asset_pack.h"
+#include "lz4_block.h"
+
+#include <ppl.h>
+
+#include <assert.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+
+namespace {
+
+UINT32 gCRCTable[256];
+
+void InitializeCRCTable()
+{
+    for (UINT32 i = 0; i < 256; ++i) {
+        UINT32 c = i;
+        for (int k = 0; k < 8; ++k) {
+            c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+        }
+        gCRCTable[i] = c;
+    }
+}
+
+UINT32 CRC32(const BYTE* data, size_t size)
+{
+    static std::once_flag once;
+    std::call_once(once, InitializeCRCTable);
+
+    UINT32 crc = 0xFFFFFFFFU;
+    for (size_t i = 0; i < size; ++i) {
+        crc = gCRCTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFU;
+}
+
+} // namespace
+
+
+AssetPack::~AssetPack()
+{
+    if (mView) UnmapViewOfFile(mView);
+    if (mMapping) CloseHandle(mMapping);
+}
+
+
+HRESULT AssetPack::Open(const char* fileName)
+{
+    assert(!IsOpen());
+
+    auto file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                            FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    LARGE_INTEGER fileSize = {};
+    GetFileSizeEx(file, &fileSize);
+    if (fileSize.QuadPart < (LONGLONG)sizeof(Header)) {
+        CloseHandle(file);
+        return E_FAIL;
+    }
+
+    mMapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mMapping == NULL) {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    mView = (const BYTE*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+    if (mView == nullptr) {
+        HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+        CloseHandle(mMapping);
+        mMapping = NULL;
+        return hr;
+    }
+    mFileSize = (UINT64)fileSize.QuadPart;
+
+    // Validate everything up front so extraction only has to check the chunk contents
+    auto fail = [this]() {
+        UnmapViewOfFile(mView);
+        CloseHandle(mMapping);
+        mView = nullptr;
+        mMapping = NULL;
+        mHeader = nullptr;
+        mChunks = nullptr;
+        mEntries.clear();
+        return E_FAIL;
+    };
+
+    mHeader = (const Header*)mView;
+    if (mHeader->magic != MAGIC || mHeader->version != VERSION || mHeader->chunkSize == 0) {
+        return fail();
+    }
+
+    UINT64 tocSize = sizeof(Header) + (UINT64)mHeader->entryCount * sizeof(Entry) +
+                     (UINT64)mHeader->chunkCount * sizeof(Chunk);
+    if (tocSize > mFileSize) {
+        return fail();
+    }
+
+    auto entries = (const Entry*)(mView + sizeof(Header));
+    mChunks = (const Chunk*)(entries + mHeader->entryCount);
+
+    for (UINT32 c = 0; c < mHeader->chunkCount; ++c) {
+        auto chunk = &mChunks[c];
+        // Not offset + storedSize, which a corrupt offset could wrap
+        if (chunk->offset < tocSize || chunk->storedSize > mHeader->chunkSize ||
+            chunk->offset > mFileSize || chunk->storedSize > mFileSize - chunk->offset) {
+            return fail();
+        }
+    }
+
+    for (UINT32 e = 0; e < mHeader->entryCount; ++e) {
+        auto entry = &entries[e];
+        UINT64 expectedChunks = (entry->size + mHeader->chunkSize - 1) / mHeader->chunkSize;
+        if (entry->name[MAX_NAME_LENGTH] != '\0' || entry->size > UINT_MAX ||
+            entry->chunkCount != expectedChunks ||
+            (UINT64)entry->firstChunk + entry->chunkCount > mHeader->chunkCount) {
+            return fail();
+        }
+        mEntries[entry->name] = entry;
+    }
+
+    return S_OK;
+}
+
+
+HRESULT AssetPack::EntrySize(const std::string& name, UINT* size) const
+{
+    auto i = mEntries.find(name);
+    if (i == mEntries.end()) {
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+    *size = (UINT)i->second->size;
+    return S_OK;
+}
+
+
+HRESULT AssetPack::Extract(const std::string& name, BYTE* destination, UINT destinationSize) const
+{
+    auto i = mEntries.find(name);
+    if (i == mEntries.end()) {
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+    auto entry = i->second;
+    auto chunkSize = mHeader->chunkSize;
+    if (destinationSize < entry->size) {
+        return E_INVALIDARG;
+    }
+
+    // Each chunk lands at a fixed offset, so they are independent; the page faults on the mapping are
+    // spread across the workers too
+    std::atomic<bool> failed(false);
+    concurrency::parallel_for(UINT32(0), entry->chunkCount, [&](UINT32 c) {
+        auto chunk = &mChunks[entry->firstChunk + c];
+        auto src = mView + chunk->offset;
+        auto dst = destination + (size_t)c * chunkSize;
+        auto dstSize = (int)std::min<UINT64>(chunkSize, entry->size - (UINT64)c * chunkSize);
+
+        if (CRC32(src, chunk->storedSize) != chunk->checksum) {
+            failed = true;
+        } else if (chunk->storedSize == (UINT32)dstSize) {
+            memcpy(dst, src, dstSize);
+        } else if (LZ4BlockDecompress(src, (int)chunk->storedSize, dst, dstSize) != dstSize) {
+            failed = true;
+        }
+    });
+
+    if (failed) {
+        std::cerr << "error: asset pack entry '" << name << "' is corrupt" << std::endl;
+        return E_FAIL;
+    }
+    return S_OK;
+}
+
+
+HRESULT AssetPack::Extract(const std::string& name, std::unique_ptr<BYTE[]>* data, UINT* size) const
+{
+    UINT entrySize = 0;
+    HRESULT hr = EntrySize(name, &entrySize);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    std::unique_ptr<BYTE[]> output(new BYTE[entrySize]);
+    hr = Extract(name, output.get(), entrySize);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    *data = std::move(output);
+    *size = entrySize;
+    return S_OK;
+}
+
+
+HRESULT AssetPack::Write(const char* packFileName, const std::vector<std::string>& fileNames, UINT32 chunkSize)
+{
+    struct Input
+    {
+        std::vector<BYTE> data;
+        UINT32 firstChunk;
+        UINT32 chunkCount;
+    };
+
+    // Sorted, unique names
+    std::map<std::string, Input> inputs;
+    for (auto& fileName : fileNames) {
+        if (fileName.length() > MAX_NAME_LENGTH) {
+            std::cerr << "error: asset name '" << fileName << "' is too long to pack" << std::endl;
+            return E_INVALIDARG;
+        }
+        std::ifstream file(fileName, std::ios::binary);
+        if (!file) {
+            std::cerr << "error: failed to open '" << fileName << "'" << std::endl;
+            return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+        }
+        auto& input = inputs[fileName];
+        input.data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    // Lay out the chunks, then compress them all in parallel
+    struct Job
+    {
+        const BYTE* src;
+        UINT32 srcSize;
+        std::vector<BYTE> stored;
+    };
+    std::vector<Job> jobs;
+    UINT64 inputSize = 0;
+    for (auto& i : inputs) {
+        auto& input = i.second;
+        input.firstChunk = (UINT32)jobs.size();
+        for (size_t offset = 0; offset < input.data.size(); offset += chunkSize) {
+            Job job;
+            job.src = input.data.data() + offset;
+            job.srcSize = (UINT32)std::min<size_t>(chunkSize, input.data.size() - offset);
+            jobs.push_back(std::move(job));
+        }
+        input.chunkCount = (UINT32)jobs.size() - input.firstChunk;
+        inputSize += input.data.size();
+    }
+
+    concurrency::parallel_for(size_t(0), jobs.size(), [&](size_t j) {
+        auto& job = jobs[j];
+        // Anything that doesn't actually shrink is stored raw
+        job.stored.resize(LZ4BlockCompressBound(job.srcSize));
+        int compressedSize = LZ4BlockCompress(job.src, job.srcSize, job.stored.data(), job.srcSize - 1);
+        if (compressedSize > 0) {
+            job.stored.resize(compressedSize);
+        } else {
+            job.stored.assign(job.src, job.src + job.srcSize);
+        }
+    });
+
+    // Tables
+    Header header = {};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.chunkSize = chunkSize;
+    header.entryCount = (UINT32)inputs.size();
+    header.chunkCount = (UINT32)jobs.size();
+
+    std::vector<Entry> entries;
+    for (auto& i : inputs) {
+        Entry entry = {};
+        strcpy_s(entry.name, i.first.c_str());
+        entry.size = i.second.data.size();
+        entry.firstChunk = i.second.firstChunk;
+        entry.chunkCount = i.second.chunkCount;
+        entries.push_back(entry);
+    }
+
+    UINT64 offset = sizeof(Header) + entries.size() * sizeof(Entry) + jobs.size() * sizeof(Chunk);
+    std::vector<Chunk> chunks;
+    for (auto& job : jobs) {
+        Chunk chunk = {};
+        chunk.offset = offset;
+        chunk.storedSize = (UINT32)job.stored.size();
+        chunk.checksum = CRC32(job.stored.data(), job.stored.size());
+        chunks.push_back(chunk);
+        offset += chunk.storedSize;
+    }
+
+    std::ofstream file(packFileName, std::ios::binary);
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)entries.data(), entries.size() * sizeof(Entry));
+    file.write((const char*)chunks.data(), chunks.size() * sizeof(Chunk));
+    for (auto& job : jobs) {
+        file.write((const char*)job.stored.data(), job.stored.size());
+    }
+    file.close();
+    if (!file) {
+        std::cerr << "error: failed to write '" << packFileName << "'" << std::endl;
+        return E_FAIL;
+    }
+
+    std::cout << "Packed " << inputs.size() << " assets (" << jobs.size() << " chunks) into " << packFileName
+        << ": " << inputSize << " -> " << offset << " bytes" << std::endl;
+    return S_OK;
+}
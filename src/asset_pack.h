@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <windows.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Read-only container of assets, each split into independently LZ4 compressed chunks.
+//
+// Layout (all little endian):
+//   Header
+//   Entry[entryCount]   table of contents, sorted by name
+//   Chunk[chunkCount]   entries own contiguous runs of chunks
+//   chunk data
+// Every chunk holds chunkSize bytes of its asset (the last may be short) and is stored raw if it doesn't
+// compress. Checksums (CRC-32) cover the stored bytes so corruption is caught before decompression.
+class AssetPack
+{
+public:
+    static const UINT32 MAGIC = 0x4B504141; // "AAPK"
+    static const UINT32 VERSION = 1;
+    static const UINT32 DEFAULT_CHUNK_SIZE = 256 * 1024;
+    static const UINT32 MAX_NAME_LENGTH = 63;
+
+    AssetPack() {}
+    ~AssetPack();
+
+    // Maps the pack and validates the table of contents
+    HRESULT Open(const char* fileName);
+    bool IsOpen() const { return mView != nullptr; }
+
+    bool Contains(const std::string& name) const { return mEntries.find(name) != mEntries.end(); }
+
+    HRESULT EntrySize(const std::string& name, UINT* size) const;
+
+    // Decompresses all chunks of an asset in parallel, each straight to its offset in destination (which may be
+    // e.g. a mapped upload buffer), so there is no intermediate copy. destinationSize must cover EntrySize().
+    HRESULT Extract(const std::string& name, BYTE* destination, UINT destinationSize) const;
+    // As above, into a newly allocated buffer
+    HRESULT Extract(const std::string& name, std::unique_ptr<BYTE[]>* data, UINT* size) const;
+
+    // Packs the given files (stored under the names given); chunks are compressed in parallel
+    static HRESULT Write(const char* packFileName, const std::vector<std::string>& fileNames,
+                         UINT32 chunkSize = DEFAULT_CHUNK_SIZE);
+
+private:
+    AssetPack(const AssetPack&);
+    AssetPack& operator=(const AssetPack&);
+
+#pragma pack(push, 1)
+    struct Header
+    {
+        UINT32 magic;
+        UINT32 version;
+        UINT32 chunkSize;
+        UINT32 entryCount;
+        UINT32 chunkCount;
+        UINT32 reserved;
+    };
+
+    struct Entry
+    {
+        char name[MAX_NAME_LENGTH + 1];
+        UINT64 size;
+        UINT32 firstChunk;
+        UINT32 chunkCount;
+    };
+
+    struct Chunk
+    {
+        UINT64 offset;      // From the start of the file
+        UINT32 storedSize;  // == uncompressed size => stored raw
+        UINT32 checksum;
+    };
+#pragma pack(pop)
+
+    HANDLE mMapping = NULL;
+    const BYTE* mView = nullptr;
+    UINT64 mFileSize = 0;
+    const Header* mHeader = nullptr;
+    const Chunk* mChunks = nullptr;
+    std::map<std::string, const Entry*> mEntries;
+};
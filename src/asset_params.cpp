@@ -0,0 +1,138 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "asset_params.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+
+const int DEFAULT_COLOR_SCHEMES[NUM_COLOR_SCHEMES][6] = {
+    { 156, 139, 113,  55,  49,  40 },
+    { 156, 139, 113,  58,  38,  14 },
+    { 156, 139, 113,  98, 101, 104 },
+    { 156, 139, 113, 205, 197, 178 },
+    { 153, 146, 136,  88,  88,  88 },
+    { 189, 181, 164, 148, 108, 102 },
+};
+
+
+AssetParams::AssetParams()
+{
+    memcpy(colorSchemes, DEFAULT_COLOR_SCHEMES, sizeof(colorSchemes));
+}
+
+
+HRESULT LoadAssetParams(const std::string& fileName, AssetParams* outParams)
+{
+    std::ifstream file(fileName);
+    if (!file) {
+        fprintf(stderr, "error: can't open asset parameters '%s'\n", fileName.c_str());
+        return E_FAIL;
+    }
+
+    AssetParams params;
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream tokens(line);
+        std::string name;
+        if (!(tokens >> name)) continue;
+
+        bool valid = false;
+        unsigned int index = 0, seed = 0;
+        if (name == "mesh_noise_scale") {
+            valid = bool(tokens >> params.meshes.noiseScale);
+        } else if (name == "mesh_radius") {
+            valid = bool(tokens >> params.meshes.radiusScale >> params.meshes.radiusBias);
+        } else if (name == "mesh_persistence") {
+            valid = (tokens >> params.meshes.persistenceMean >> params.meshes.persistenceStdDev) &&
+                    params.meshes.persistenceStdDev > 0.0f;
+        } else if (name == "mesh_craters") {
+            valid = (tokens >> params.meshes.craterCount >> params.meshes.craterRadiusMin >>
+                     params.meshes.craterRadiusMax >> params.meshes.craterDepth) &&
+                    params.meshes.craterRadiusMin > 0.0f &&
+                    params.meshes.craterRadiusMin <= params.meshes.craterRadiusMax;
+        } else if (name == "mesh_seed") {
+            valid = bool(tokens >> index >> seed);
+            if (valid) params.meshSeeds[index] = seed;
+        } else if (name == "texture_noise_scale") {
+            valid = (tokens >> params.textures.noiseScaleMin >> params.textures.noiseScaleMax) &&
+                    params.textures.noiseScaleMin < params.textures.noiseScaleMax;
+        } else if (name == "texture_persistence") {
+            valid = (tokens >> params.textures.persistenceMean >> params.textures.persistenceStdDev) &&
+                    params.textures.persistenceStdDev > 0.0f;
+        } else if (name == "texture_strength") {
+            valid = bool(tokens >> params.textures.strength);
+        } else if (name == "texture_seed") {
+            valid = bool(tokens >> index >> seed);
+            if (valid) params.textureSeeds[index] = seed;
+        } else if (name == "color_scheme") {
+            valid = (tokens >> index) && index < NUM_COLOR_SCHEMES;
+            for (int c = 0; valid && c < 6; ++c) {
+                auto& value = params.colorSchemes[index][c];
+                valid = (tokens >> value) && value >= 0 && value <= 255;
+            }
+        } else if (name == "texture_dim") {
+            valid = (tokens >> params.textureDim) && params.textureDim > 0 && params.textureDim <= TEXTURE_DIM &&
+                    (params.textureDim & (params.textureDim - 1)) == 0;
+        } else if (name == "subdiv_count") {
+            valid = (tokens >> params.subdivCount) && params.subdivCount <= MESH_MAX_SUBDIV_LEVELS;
+        } else {
+            fprintf(stderr, "error: %s:%d: unknown parameter '%s'\n", fileName.c_str(), lineNumber, name.c_str());
+            return E_FAIL;
+        }
+
+        std::string extra;
+        if (!valid || (tokens >> extra)) {
+            fprintf(stderr, "error: %s:%d: invalid '%s'\n", fileName.c_str(), lineNumber, name.c_str());
+            return E_FAIL;
+        }
+    }
+
+    *outParams = params;
+    return S_OK;
+}
+
+
+UINT64 HashBytes(const void* data, size_t size, UINT64 hash)
+{
+    auto bytes = (const BYTE*)data;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+FileWatcher::FileWatcher(const std::string& fileName)
+    : mFileName(fileName)
+{
+    Changed();
+}
+
+
+bool FileWatcher::Changed()
+{
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(mFileName.c_str(), GetFileExInfoStandard, &attributes)) {
+        return false; // Mid save, perhaps; try again next time
+    }
+    if (CompareFileTime(&attributes.ftLastWriteTime, &mLastWriteTime) == 0) return false;
+    mLastWriteTime = attributes.ftLastWriteTime;
+    return true;
+}
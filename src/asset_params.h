@@ -0,0 +1,92 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <windows.h>
+
+#include <map>
+#include <string>
+
+#include "mesh.h"
+#include "settings.h"
+
+// Parameters of the generated asteroid content. Each generated unit (a mesh, a texture, the asteroid colors)
+// hashes just the parameters it depends on, so a change only regenerates the units whose hash changed; see
+// AsteroidAssets::Regenerate. Loaded from a text file of "name values..." lines, which may be edited while
+// running (see FileWatcher):
+//   mesh_noise_scale <scale>                      mesh_radius <scale> <bias>
+//   mesh_persistence <mean> <std dev>             mesh_seed <mesh> <seed>
+//   mesh_craters <count> <min radius> <max radius> <depth>
+//   texture_noise_scale <min> <max>               texture_persistence <mean> <std dev>
+//   texture_strength <strength>                   texture_seed <texture> <seed>
+//   color_scheme <scheme> <surface r g b> <deep r g b> (sRGB, 0-255)
+//   texture_dim <pow2>                            subdiv_count <levels>
+// texture_dim and subdiv_count are at most TEXTURE_DIM and MESH_MAX_SUBDIV_LEVELS, and only apply at startup.
+
+enum { NUM_COLOR_SCHEMES = 6 };
+
+extern const int DEFAULT_COLOR_SCHEMES[NUM_COLOR_SCHEMES][6];
+
+struct AsteroidTextureParams
+{
+    float noiseScaleMin = 100.0f;
+    float noiseScaleMax = 150.0f;
+    float persistenceMean = 0.9f;
+    float persistenceStdDev = 0.2f;
+    float strength = 1.5f;
+};
+
+struct AssetParams
+{
+    AssetParams();
+
+    AsteroidShapeParams meshes;
+    std::map<unsigned int, unsigned int> meshSeeds;    // Shape seeds of single meshes, instead of the shared draws
+    AsteroidTextureParams textures;
+    std::map<unsigned int, unsigned int> textureSeeds; // Likewise for single textures
+    int colorSchemes[NUM_COLOR_SCHEMES][6];
+
+    // These size the GPU resources, so are only used at startup (see AsteroidAssets)
+    unsigned int textureDim = TEXTURE_DIM;
+    unsigned int subdivCount = MESH_MAX_SUBDIV_LEVELS;
+};
+
+// Unknown names and malformed lines are errors; anything not given keeps its default
+HRESULT LoadAssetParams(const std::string& fileName, AssetParams* outParams);
+
+// FNV-1a; chain calls through hash
+UINT64 HashBytes(const void* data, size_t size, UINT64 hash = 14695981039346656037ULL);
+
+template <typename T>
+UINT64 HashValue(const T& value, UINT64 hash = 14695981039346656037ULL)
+{
+    return HashBytes(&value, sizeof(value), hash);
+}
+
+// Polls the last write time of a file
+class FileWatcher
+{
+public:
+    explicit FileWatcher(const std::string& fileName);
+
+    // Since construction or the last time it returned true
+    bool Changed();
+
+private:
+    std::string mFileName;
+    FILETIME mLastWriteTime = {};
+};
@@ -0,0 +1,325 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "asteroid_assets.h"
+#include "noise_volume.h"
+#include "texture.h"
+#include "util.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <ppl.h>
+
+
+AsteroidAssets::AsteroidAssets(unsigned int rngSeed, unsigned int meshInstanceCount, unsigned int subdivCount,
+                               unsigned int textureCount, const AssetParams& params)
+    : mParams(params)
+    , mIndexOffsets(subdivCount + 2) // Mesh subdivs are inclusive on both ends and need forward differencing for count
+    , mSubdivCount(subdivCount)
+    , mVertexCountPerMesh(GeosphereVertexCount(subdivCount))
+    , mMeshInstanceCount(meshInstanceCount)
+    , mTextureCount(textureCount)
+{
+    // Same draw as when the simulation owned the assets, so a given seed gives the same asteroids. Textures never
+    // depended on it (see CreateTextures).
+    std::mt19937 rng(rngSeed);
+    mMeshRngSeed = rng();
+}
+
+
+AsteroidAssets::~AsteroidAssets()
+{
+}
+
+
+void AsteroidAssets::CreateMeshes(float bakedNoiseTolerance)
+{
+    // Kept for Regenerate
+    mBakedNoiseTolerance = bakedNoiseTolerance;
+    if (bakedNoiseTolerance > 0.0f) {
+        mNoiseVolume.reset(new NoiseVolume(bakedNoiseTolerance));
+        auto dim = mNoiseVolume->CellResolution() * NoiseVolume::PERIOD;
+        std::cout
+            << "Baked " << dim << "^3 mesh noise volume, trilinear error "
+            << mNoiseVolume->MeasuredError() << " against its own noise" << std::endl;
+        if (mNoiseVolume->MeasuredError() > bakedNoiseTolerance) {
+            std::cerr << "warning: mesh noise volume error exceeds " << bakedNoiseTolerance
+                      << " at its maximum resolution" << std::endl;
+        }
+    }
+
+    std::cout
+        << "Creating " << mMeshInstanceCount << " meshes, each with "
+        << mSubdivCount << " subdivision levels..." << std::endl;
+
+    // As CreateAsteroidsFromGeospheres, but keeping the base mesh and each mesh's parameters
+    CreateGeospheres(&mGeosphere, mSubdivCount, mIndexOffsets.data());
+    BuildVertexTriangleAdjacency(mGeosphere.indices.data(), mGeosphere.indices.size(), mGeosphere.vertices.size(),
+                                 &mAdjacency);
+
+    // Simulations lay out their asteroids assuming this
+    assert(mGeosphere.vertices.size() == mVertexCountPerMesh);
+
+    std::vector<AsteroidShape> shapes;
+    std::vector<unsigned int> seeds;
+    MeshShapes(mParams, &shapes, &seeds);
+
+    mMeshes.indices = mGeosphere.indices;
+    mMeshes.vertices.resize(mMeshInstanceCount * mVertexCountPerMesh);
+    mMeshHashes.resize(mMeshInstanceCount);
+    concurrency::parallel_for(0U, mMeshInstanceCount, [&](unsigned int m) {
+        ShapeAsteroid(mMeshes.vertices.data() + m * mVertexCountPerMesh, mGeosphere, mAdjacency, shapes[m],
+                      mParams.meshes, seeds[m], mNoiseVolume.get());
+        mMeshHashes[m] = MeshHash(mParams, shapes[m], seeds[m]);
+    });
+
+    mMeshView.vertices = mMeshes.vertices.data();
+    mMeshView.vertexCount = mMeshes.vertices.size();
+    mMeshView.indices = mMeshes.indices.data();
+    mMeshView.indexCount = mMeshes.indices.size();
+}
+
+
+AsteroidAssets::Layout AsteroidAssets::GetLayout() const
+{
+    Layout layout = {};
+    layout.vertexCount = (UINT32)mMeshView.vertexCount;
+    layout.indexCount = (UINT32)mMeshView.indexCount;
+    std::copy(mIndexOffsets.begin(), mIndexOffsets.end(), layout.indexOffsets);
+    layout.textureDim = mTextureDim;
+    layout.textureArraySize = mTextureArraySize;
+    layout.textureMipLevels = mTextureMipLevels;
+    layout.textureCount = mTextureCount;
+    layout.textureStride = mTextureStride;
+    return layout;
+}
+
+
+void AsteroidAssets::Attach(const Layout& layout, const Vertex* vertices, const IndexType* indices,
+                            const BYTE* textures)
+{
+    assert(layout.textureCount == mTextureCount);
+    mMeshView.vertices = vertices;
+    mMeshView.vertexCount = layout.vertexCount;
+    mMeshView.indices = indices;
+    mMeshView.indexCount = layout.indexCount;
+    SetIndexOffsets(layout.indexOffsets);
+
+    mTextureDim = layout.textureDim;
+    mTextureArraySize = layout.textureArraySize;
+    mTextureMipLevels = layout.textureMipLevels;
+    mTextureData = textures;
+    mTextureStride = (size_t)layout.textureStride;
+    SetTextureSubresources();
+}
+
+
+void AsteroidAssets::SetTextureSubresources()
+{
+    UINT texelSizeInBytes = 4; // RGBA8
+    mTextureSubresources.resize(mTextureArraySize * mTextureMipLevels * mTextureCount);
+    for (UINT t = 0; t < mTextureCount; ++t) {
+        auto data = mTextureData + t * mTextureStride;
+        for (UINT a = 0; a < mTextureArraySize; ++a) {
+            for (UINT m = 0; m < mTextureMipLevels; ++m) {
+                auto width  = mTextureDim >> m;
+                auto height = mTextureDim >> m;
+
+                D3D11_SUBRESOURCE_DATA initialData = {};
+                initialData.pSysMem = data;
+                initialData.SysMemPitch = width * texelSizeInBytes;
+                mTextureSubresources[SubresourceIndex(t, a, m)] = initialData;
+
+                data += initialData.SysMemPitch * height;
+            }
+        }
+    }
+}
+
+
+void AsteroidAssets::CreateTextures()
+{
+    auto textureCount = mTextureCount;
+
+    mTextureDim = mParams.textureDim;
+    mTextureArraySize = 3;
+    {
+        DWORD msbIndex = 0;
+        auto result = _BitScanReverse(&msbIndex, mTextureDim);
+        assert(result); // Should only fail if mTextureDim = 0
+        mTextureMipLevels = msbIndex + 1;
+    }
+
+    assert((mTextureDim & (mTextureDim-1)) == 0); // Must be pow2 currently; we don't handle wacky mip chains
+
+    std::cout
+        << "Creating " << textureCount << " "
+        << mTextureDim << "x" << mTextureDim << " textures..." << std::endl;
+    
+    // Allocate space
+    UINT texelSizeInBytes = 4; // RGBA8
+    UINT extraSpaceForMips = 2;
+    UINT totalTextureSizeInBytes = texelSizeInBytes * mTextureDim * mTextureDim * mTextureArraySize * extraSpaceForMips;
+    totalTextureSizeInBytes = Align(totalTextureSizeInBytes, 64U); // Avoid false sharing
+
+    mTextureDataBuffer.resize(totalTextureSizeInBytes * textureCount);
+    mTextureData = mTextureDataBuffer.data();
+    mTextureStride = totalTextureSizeInBytes;
+    SetTextureSubresources();
+
+    // Parallel over textures. Drawn from the default seed, not the asset seed, as they always have been.
+    mTextureSeeds.resize(textureCount);
+    {
+        std::mt19937 seeds;
+        for (auto &i : mTextureSeeds) i = seeds();
+    }
+
+    mTextureHashes.resize(textureCount);
+    concurrency::parallel_for(UINT(0), textureCount, [&](UINT t) {
+        auto seed = TextureSeed(mParams, t);
+        CreateTexture(mParams, t, seed);
+        mTextureHashes[t] = TextureHash(mParams, seed);
+    }); // parallel_for
+}
+
+
+void AsteroidAssets::CreateTexture(const AssetParams& params, unsigned int t, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    auto randomNoise = std::uniform_real_distribution<float>(0.0f, 10000.0f);
+    auto randomNoiseScale = std::uniform_real_distribution<float>(params.textures.noiseScaleMin,
+                                                                  params.textures.noiseScaleMax);
+    auto randomPersistence = std::normal_distribution<float>(params.textures.persistenceMean,
+                                                             params.textures.persistenceStdDev);
+
+    // Use same parameters for each of the tri-planar projection planes/cube map faces/etc.
+    float noiseScale = randomNoiseScale(rng) / float(mTextureDim);
+    float persistence = randomPersistence(rng);
+    float strength = params.textures.strength;
+
+    for (UINT a = 0; a < mTextureArraySize; ++a) {
+        float redScale   = 255.0f;
+        float greenScale = 255.0f;
+        float blueScale  = 255.0f;
+
+        // DEBUG colors
+#if 0
+        redScale   = t & 1 ? 255.0f : 0.0f;
+        greenScale = t & 2 ? 255.0f : 0.0f;
+        blueScale  = t & 4 ? 255.0f : 0.0f;
+#endif
+
+        FillNoise2D_RGBA8(&mTextureSubresources[SubresourceIndex(t, a)], mTextureDim, mTextureDim, mTextureMipLevels,
+                          randomNoise(rng), persistence, noiseScale, strength,
+                          redScale, greenScale, blueScale);
+    }
+}
+
+
+unsigned int AsteroidAssets::TextureSeed(const AssetParams& params, unsigned int texture) const
+{
+    auto seed = params.textureSeeds.find(texture);
+    return seed != params.textureSeeds.end() ? seed->second : mTextureSeeds[texture];
+}
+
+
+UINT64 AsteroidAssets::TextureHash(const AssetParams& params, unsigned int seed) const
+{
+    auto hash = HashValue(params.textures);
+    hash = HashValue(seed, hash);
+    return HashValue(mTextureDim, hash);
+}
+
+
+void AsteroidAssets::MeshShapes(const AssetParams& params, std::vector<AsteroidShape>* outShapes,
+                                std::vector<unsigned int>* outSeeds) const
+{
+    // The shared draws are sequential (the distributions carry state across meshes), so always draw them all
+    outShapes->resize(mMeshInstanceCount);
+    outSeeds->resize(mMeshInstanceCount);
+    DrawAsteroidShapes(mMeshRngSeed, mMeshInstanceCount, params.meshes, outShapes->data());
+    for (unsigned int m = 0; m < mMeshInstanceCount; ++m) {
+        (*outSeeds)[m] = mMeshRngSeed + m;
+    }
+
+    for (auto seed : params.meshSeeds) {
+        if (seed.first < mMeshInstanceCount) {
+            DrawAsteroidShapes(seed.second, 1, params.meshes, &(*outShapes)[seed.first]);
+            (*outSeeds)[seed.first] = seed.second;
+        }
+    }
+}
+
+
+UINT64 AsteroidAssets::MeshHash(const AssetParams& params, const AsteroidShape& shape, unsigned int seed) const
+{
+    auto hash = HashValue(params.meshes);
+    hash = HashValue(shape, hash);
+    hash = HashValue(seed, hash);
+    hash = HashValue(mSubdivCount, hash);
+    return HashValue(mBakedNoiseTolerance, hash);
+}
+
+
+AssetChanges AsteroidAssets::Regenerate(const AssetParams& params)
+{
+    assert(mMeshView.vertices == mMeshes.vertices.data()); // Not attached
+
+    // The layout is fixed by the GPU resources; everything else is compared against the current layout
+    AssetChanges changes;
+    changes.layout = params.textureDim != mTextureDim || params.subdivCount != mSubdivCount;
+
+    // Meshes depend on the shape parameters, their own draws and seed; all of these are cheap to recompute
+    std::vector<AsteroidShape> shapes;
+    std::vector<unsigned int> seeds;
+    MeshShapes(params, &shapes, &seeds);
+
+    std::vector<UINT64> meshHashes(mMeshInstanceCount);
+    for (unsigned int m = 0; m < mMeshInstanceCount; ++m) {
+        meshHashes[m] = MeshHash(params, shapes[m], seeds[m]);
+        if (meshHashes[m] != mMeshHashes[m]) {
+            changes.meshes.push_back(m);
+        }
+    }
+
+    // Textures depend on the texture parameters and their seed only
+    std::vector<unsigned int> textureSeeds(mTextureCount);
+    std::vector<UINT64> textureHashes(mTextureCount);
+    for (unsigned int t = 0; t < mTextureCount; ++t) {
+        textureSeeds[t] = TextureSeed(params, t);
+        textureHashes[t] = TextureHash(params, textureSeeds[t]);
+        if (textureHashes[t] != mTextureHashes[t]) {
+            changes.textures.push_back(t);
+        }
+    }
+
+    concurrency::parallel_for(size_t(0), changes.meshes.size(), [&](size_t i) {
+        auto m = changes.meshes[i];
+        ShapeAsteroid(mMeshes.vertices.data() + m * mVertexCountPerMesh, mGeosphere, mAdjacency, shapes[m],
+                      params.meshes, seeds[m], mNoiseVolume.get());
+    });
+    concurrency::parallel_for(size_t(0), changes.textures.size(), [&](size_t i) {
+        auto t = changes.textures[i];
+        CreateTexture(params, t, textureSeeds[t]);
+    });
+
+    std::swap(mMeshHashes, meshHashes);
+    std::swap(mTextureHashes, textureHashes);
+    mParams = params;
+    return changes;
+}
@@ -0,0 +1,145 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <d3d11.h> // For D3D11_SUBRESOURCE_DATA
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "asset_params.h"
+#include "mesh.h"
+#include "settings.h"
+
+// What AsteroidAssets::Regenerate changed, for re-uploading just those ranges
+struct AssetChanges
+{
+    std::vector<unsigned int> meshes;
+    std::vector<unsigned int> textures;
+    bool layout = false; // textureDim/subdivCount differ; ignored, as they only apply at startup
+
+    bool Empty() const { return meshes.empty() && textures.empty(); }
+};
+
+// The unique asteroid meshes and textures. Generated once and shared (std::shared_ptr) by every field of a
+// simulation, and by any other simulation drawing from the same set; asteroids only refer to them by index.
+class AsteroidAssets
+{
+public:
+    // Where the generated assets are, for sharing them with other processes (see sim_publish.h)
+    struct Layout
+    {
+        UINT32 vertexCount;
+        UINT32 indexCount;
+        UINT32 indexOffsets[MESH_MAX_SUBDIV_LEVELS + 2];
+        UINT32 textureDim;
+        UINT32 textureArraySize;
+        UINT32 textureMipLevels;
+        UINT32 textureCount;
+        UINT64 textureStride;
+    };
+
+    // Only draws the generator seeds; the (expensive) data is generated by CreateMeshes/CreateTextures so that
+    // startup can overlap them with other work
+    AsteroidAssets(unsigned int rngSeed, unsigned int meshInstanceCount, unsigned int subdivCount,
+                   unsigned int textureCount, const AssetParams& params = AssetParams());
+    ~AsteroidAssets();
+
+    // Independent of each other; each must complete before the corresponding data is used
+    // bakedNoiseTolerance > 0 displaces the meshes from a baked tileable noise volume instead of snoise4. The
+    // shapes differ from the default ones; the tolerance only bounds the trilinear error against the volume's own noise.
+    void CreateMeshes(float bakedNoiseTolerance = 0.0f);
+    void CreateTextures();
+
+    // Instead of CreateMeshes/CreateTextures: uses assets generated elsewhere, which must stay mapped
+    void Attach(const Layout& layout, const Vertex* vertices, const IndexType* indices, const BYTE* textures);
+
+    // Valid once CreateMeshes and CreateTextures have completed
+    Layout GetLayout() const;
+
+    // Regenerates, in place, only the meshes and textures whose parameters changed from the current ones.
+    // Not for attached assets. The caller re-uploads the changes; nothing else may read the CPU copies meanwhile.
+    AssetChanges Regenerate(const AssetParams& params);
+    const AssetParams& Params() const { return mParams; }
+
+    MeshView Meshes() const { return mMeshView; }
+    const D3D11_SUBRESOURCE_DATA* TextureData(unsigned int textureIndex)
+    {
+        return mTextureSubresources.data() + SubresourceIndex(textureIndex);
+    }
+    const BYTE* TextureBuffer() const { return mTextureData; }
+
+    unsigned int MeshInstanceCount() const { return mMeshInstanceCount; }
+    unsigned int SubdivCount() const { return mSubdivCount; }
+    unsigned int TextureDim() const { return mTextureDim; } // Once CreateTextures has completed or attached
+    unsigned int VertexCountPerMesh() const { return mVertexCountPerMesh; }
+    unsigned int TextureCount() const { return mTextureCount; }
+    unsigned int TextureSubresourceCount() const { return mTextureArraySize * mTextureMipLevels; }
+
+    // [SubdivCount() + 2], valid once CreateMeshes has completed; shard workers are given them instead
+    const unsigned int* IndexOffsets() const { return mIndexOffsets.data(); }
+    void SetIndexOffsets(const unsigned int* offsets) { std::copy(offsets, offsets + mSubdivCount + 2, mIndexOffsets.begin()); }
+
+    size_t MeshBytes() const
+    {
+        return mMeshView.vertexCount * sizeof(Vertex) + mMeshView.indexCount * sizeof(IndexType);
+    }
+    size_t TextureBytes() const { return mTextureStride * mTextureCount; }
+
+private:
+    void SetTextureSubresources();
+
+    // Shape and displacement seed of every mesh under params
+    void MeshShapes(const AssetParams& params, std::vector<AsteroidShape>* outShapes,
+                    std::vector<unsigned int>* outSeeds) const;
+    UINT64 MeshHash(const AssetParams& params, const AsteroidShape& shape, unsigned int seed) const;
+
+    unsigned int TextureSeed(const AssetParams& params, unsigned int texture) const;
+    UINT64 TextureHash(const AssetParams& params, unsigned int seed) const;
+    void CreateTexture(const AssetParams& params, unsigned int texture, unsigned int seed);
+
+    unsigned int SubresourceIndex(unsigned int texture, unsigned int arrayElement = 0, unsigned int mip = 0)
+    {
+        return mip + mTextureMipLevels * (arrayElement + mTextureArraySize * texture);
+    }
+
+    AssetParams mParams;
+
+    Mesh mMeshes;
+    MeshView mMeshView = {}; // mMeshes, or attached
+    Mesh mGeosphere;         // Undisplaced; every mesh is reshaped from it
+    VertexTriangleAdjacency mAdjacency; // mGeosphere's, for the normals
+    std::unique_ptr<NoiseVolume> mNoiseVolume;
+    float mBakedNoiseTolerance = 0.0f;
+    std::vector<UINT64> mMeshHashes;
+    std::vector<unsigned int> mIndexOffsets; // Fixed size; simulations keep a pointer
+    unsigned int mSubdivCount;
+    unsigned int mVertexCountPerMesh;
+    unsigned int mMeshInstanceCount;
+    unsigned int mMeshRngSeed;
+
+    unsigned int mTextureDim = 0;
+    unsigned int mTextureCount;
+    unsigned int mTextureArraySize = 0;
+    unsigned int mTextureMipLevels = 0;
+    std::vector<unsigned int> mTextureSeeds; // Shared draws, before any AssetParams::textureSeeds
+    std::vector<UINT64> mTextureHashes;
+    std::vector<BYTE> mTextureDataBuffer;
+    const BYTE* mTextureData = nullptr; // mTextureDataBuffer, or attached
+    size_t mTextureStride = 0;          // Bytes per texture (all array elements and mips)
+    std::vector<D3D11_SUBRESOURCE_DATA> mTextureSubresources;
+};
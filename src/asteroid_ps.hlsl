@@ -18,7 +18,7 @@
 #include "common_defines.h"
 
 // Apparently tools don't like unbounded/bindless texture arrays, so use the real constant for now
-Texture2DArray<float4> Tex[NUM_UNIQUE_TEXTURES] : register(t0);
+Texture2DArray<float4> Tex[NUM_TEXTURE_SLOTS] : register(t0);
 sampler Sampler : register(s0);
 
 float4 asteroid_ps(VSOut input) : SV_Target
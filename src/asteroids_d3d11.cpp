@@ -24,8 +24,6 @@
 #include <future>
 #include <limits>
 #include <random>
-#include <locale>
-#include <codecvt>
 
 #include "asteroids_d3d11.h"
 #include "util.h"
@@ -47,6 +45,9 @@ using namespace DirectX;
 
 namespace AsteroidsD3D11 {
 
+// Skybox streaming; a 1024^2 mip 0 is 24 MB across its faces, too much for one frame's UpdateSubresource
+static const UINT SKYBOX_UPLOAD_BYTES_PER_FRAME = 1024 * 1024;
+
 Asteroids::Asteroids(AsteroidsSimulation* asteroids, GUI* gui, bool warp)
     : mAsteroids(asteroids)
     , mGUI(gui)
@@ -189,13 +190,6 @@ Asteroids::Asteroids(AsteroidsSimulation* asteroids, GUI* gui, bool warp)
         desc.ComparisonFunc = D3D11_COMPARISON_NEVER;
         ThrowIfFailed(mDevice->CreateSamplerState(&desc, &mSamplerState));
     }
-
-    CreateMeshes();
-    InitializeTextureData();
-    CreateGUIResources();
-
-    // Load textures
-    ThrowIfFailed(CreateDDSTextureFromFile(mDevice, L"starbox_1024.dds", &mSkyboxSRV, true));
 }
 
 Asteroids::~Asteroids()
@@ -231,9 +225,12 @@ Asteroids::~Asteroids()
     SafeRelease(&mSkyboxVertexBuffer);
     SafeRelease(&mSkyboxInputLayout);
     SafeRelease(&mSkyboxSRV);
+    SafeRelease(&mSkyboxTexture);
+    if (auto skyboxSRV = mLoadedSkyboxSRV.exchange(nullptr)) skyboxSRV->Release();
 
+    mTexturePool.reset();
     for (auto& texture : mTextures) SafeRelease(&texture);
-    for (auto& srv : mTextureSRVs) SafeRelease(&srv);
+    for (UINT t = 0; t < NUM_UNIQUE_TEXTURES; ++t) SafeRelease(&mTextureSRVs[t]);
 
     if (mSwapChain != nullptr) {
         mSwapChain->Release();
@@ -337,17 +334,17 @@ void Asteroids::ResizeSwapChain(IDXGIFactory2* dxgiFactory, HWND outputWindow, u
 
 void Asteroids::CreateMeshes()
 {
-    auto asteroidMeshes = mAsteroids->Meshes();
+    auto asteroidMeshes = mAsteroids->Assets()->Meshes();
 
     // create vertex buffer
     {
         CD3D11_BUFFER_DESC desc(
-            (UINT)asteroidMeshes->vertices.size() * sizeof(asteroidMeshes->vertices[0]),
+            (UINT)asteroidMeshes.vertexCount * sizeof(Vertex),
             D3D11_BIND_VERTEX_BUFFER,
             D3D11_USAGE_DEFAULT);
 
         D3D11_SUBRESOURCE_DATA data = {};
-        data.pSysMem = asteroidMeshes->vertices.data();
+        data.pSysMem = asteroidMeshes.vertices;
 
         ThrowIfFailed(mDevice->CreateBuffer(&desc, &data, &mVertexBuffer));
     }
@@ -355,12 +352,12 @@ void Asteroids::CreateMeshes()
     // create index buffer
     {
         CD3D11_BUFFER_DESC desc(
-            (UINT)asteroidMeshes->indices.size() * sizeof(asteroidMeshes->indices[0]),
+            (UINT)asteroidMeshes.indexCount * sizeof(IndexType),
             D3D11_BIND_INDEX_BUFFER,
             D3D11_USAGE_DEFAULT);
 
         D3D11_SUBRESOURCE_DATA data = {};
-        data.pSysMem = asteroidMeshes->indices.data();
+        data.pSysMem = asteroidMeshes.indices;
 
         ThrowIfFailed(mDevice->CreateBuffer(&desc, &data, &mIndexBuffer));
     }
@@ -395,8 +392,8 @@ void Asteroids::CreateMeshes()
 void Asteroids::InitializeTextureData()
 {
     D3D11_TEXTURE2D_DESC textureDesc = {};
-    textureDesc.Width            = TEXTURE_DIM;
-    textureDesc.Height           = TEXTURE_DIM;
+    textureDesc.Width            = mAsteroids->Assets()->TextureDim();
+    textureDesc.Height           = mAsteroids->Assets()->TextureDim();
     textureDesc.ArraySize        = 3;
     textureDesc.MipLevels        = 0; // Full chain
     textureDesc.Format           = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
@@ -405,12 +402,100 @@ void Asteroids::InitializeTextureData()
     textureDesc.BindFlags        = D3D11_BIND_SHADER_RESOURCE;
 
     for (UINT t = 0; t < NUM_UNIQUE_TEXTURES; ++t) {
-        ThrowIfFailed(mDevice->CreateTexture2D(&textureDesc, mAsteroids->TextureData(t), &mTextures[t]));
+        ThrowIfFailed(mDevice->CreateTexture2D(&textureDesc, mAsteroids->Assets()->TextureData(t), &mTextures[t]));
         ThrowIfFailed(mDevice->CreateShaderResourceView(mTextures[t], nullptr, &mTextureSRVs[t]));
     }
 }
 
-void Asteroids::CreateGUIResources()
+void Asteroids::UpdateAssets(const AssetChanges& changes)
+{
+    auto assets = mAsteroids->Assets();
+
+    // Each mesh is a contiguous range of the vertex buffer; the indices are shared
+    auto meshes = assets->Meshes();
+    UINT meshBytes = assets->VertexCountPerMesh() * sizeof(Vertex);
+    for (auto m : changes.meshes) {
+        D3D11_BOX box = { m * meshBytes, 0, 0, (m + 1) * meshBytes, 1, 1 };
+        mDeviceCtxt->UpdateSubresource(mVertexBuffer, 0, &box,
+                                       meshes.vertices + m * assets->VertexCountPerMesh(), 0, 0);
+    }
+
+    // Subresources are in the same order as D3D11CalcSubresource's
+    for (auto t : changes.textures) {
+        auto data = assets->TextureData(t);
+        for (UINT s = 0; s < assets->TextureSubresourceCount(); ++s) {
+            mDeviceCtxt->UpdateSubresource(mTextures[t], s, nullptr, data[s].pSysMem, data[s].SysMemPitch, 0);
+        }
+    }
+
+    // Pooled textures regenerate as they are next requested
+    if (mTexturePool) mTexturePool->SetTextureParams(assets->Params().textures);
+}
+
+void Asteroids::EnableTexturePool(UINT virtualCount, UINT64 budgetBytes)
+{
+    // The view keeps the texture alive, so the pool only needs to hold on to that
+    auto create = [this](const PooledTexture& texture) -> IUnknown* {
+        D3D11_TEXTURE2D_DESC textureDesc = {};
+        textureDesc.Width            = texture.dim;
+        textureDesc.Height           = texture.dim;
+        textureDesc.ArraySize        = texture.arraySize;
+        textureDesc.MipLevels        = texture.mipLevels;
+        textureDesc.Format           = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+        textureDesc.SampleDesc.Count = 1;
+        textureDesc.Usage            = D3D11_USAGE_IMMUTABLE;
+        textureDesc.BindFlags        = D3D11_BIND_SHADER_RESOURCE;
+
+        ID3D11Texture2D* resource = nullptr;
+        ID3D11ShaderResourceView* srv = nullptr;
+        ThrowIfFailed(mDevice->CreateTexture2D(&textureDesc, texture.subresources.data(), &resource));
+        ThrowIfFailed(mDevice->CreateShaderResourceView(resource, nullptr, &srv));
+        resource->Release();
+        return srv;
+    };
+
+    auto bind = [this](UINT slot, IUnknown* texture) {
+        mTextureSRVs[slot] = (ID3D11ShaderResourceView*)texture;
+    };
+
+    mTexturePool.reset(new ProceduralTexturePool(virtualCount, NUM_UNIQUE_TEXTURES, NUM_TEXTURE_POOL_SLOTS,
+                                                 budgetBytes, 1, create, bind));
+    mTexturePool->SetTextureParams(mAsteroids->Assets()->Params().textures);
+}
+
+void Asteroids::CreateSkybox(const TextureMipChain& skybox)
+{
+    // Only creation happens here; uploads go through the immediate context so are done by Render
+    D3D11_TEXTURE2D_DESC textureDesc = {};
+    textureDesc.Width = skybox.width;
+    textureDesc.Height = skybox.height;
+    textureDesc.MipLevels = skybox.mipLevels;
+    textureDesc.ArraySize = skybox.arraySize;
+    textureDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.Usage = D3D11_USAGE_DEFAULT;
+    textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    textureDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+    ID3D11Texture2D* texture = nullptr;
+    ThrowIfFailed(mDevice->CreateTexture2D(&textureDesc, nullptr, &texture));
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Format = textureDesc.Format;
+    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+    srvDesc.TextureCube.MipLevels = textureDesc.MipLevels;
+
+    ID3D11ShaderResourceView* skyboxSRV = nullptr;
+    ThrowIfFailed(mDevice->CreateShaderResourceView(texture, &srvDesc, &skyboxSRV));
+    texture->Release(); // Held by the view
+
+    // Picked up by Render
+    mSkyboxMips = &skybox;
+    mSkyboxResidency.reset(new MipResidency(skybox.width, skybox.height, skybox.mipLevels));
+    mLoadedSkyboxSRV = skyboxSRV;
+}
+
+void Asteroids::CreateGUIResources(const std::map<std::string, const DDSFile*>& spriteFiles)
 {
     auto font = mGUI->Font();
     D3D11_TEXTURE2D_DESC textureDesc = CD3D11_TEXTURE2D_DESC(DXGI_FORMAT_A8_UNORM, font->BitmapWidth(), font->BitmapHeight(), 1, 1);
@@ -428,9 +513,20 @@ void Asteroids::CreateGUIResources()
     for (size_t i = 0; i < mGUI->size(); ++i) {
         auto control = (*mGUI)[i];
         if (control->TextureFile().length() > 0 && mSpriteTextures.find(control->TextureFile()) == mSpriteTextures.end()) {
-            std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;            
             ID3D11ShaderResourceView* textureSRV = nullptr;
-            ThrowIfFailed(CreateDDSTextureFromFile(mDevice, converter.from_bytes(control->TextureFile()).c_str(), &textureSRV, true));
+            if (control->TextureFile() == GUI_PALETTE_TEXTURE) {
+                textureDesc = CD3D11_TEXTURE2D_DESC(DXGI_FORMAT_B8G8R8A8_UNORM_SRGB, GUI_COLOR_COUNT, 1, 1, 1,
+                                                    D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_IMMUTABLE);
+                initialData.pSysMem = GUIPalettePixels();
+                initialData.SysMemPitch = GUI_COLOR_COUNT * sizeof(UINT);
+                ThrowIfFailed(mDevice->CreateTexture2D(&textureDesc, &initialData, &texture));
+                ThrowIfFailed(mDevice->CreateShaderResourceView(texture, nullptr, &textureSRV));
+                SafeRelease(&texture);
+            } else {
+                auto& file = *spriteFiles.at(control->TextureFile());
+                ThrowIfFailed(CreateDDSTextureFromMemory(mDevice, const_cast<DDS_HEADER*>(file.Header()),
+                    const_cast<BYTE*>(file.Bits()), file.BitSize(), &textureSRV, true));
+            }
             mSpriteTextures[control->TextureFile()] = textureSRV;
         }
     }
@@ -444,8 +540,11 @@ void Asteroids::Render(float frameTime, const OrbitCamera& camera, const Setting
 
     ProfileBeginRender();
 
+    if (mTexturePool) mTexturePool->BeginFrame();
+
     // Frame data
     ProfileBeginSimUpdate();
+    mAsteroids->BeginFrame(frameTime, settings, camera);
     mAsteroids->Update(frameTime, camera.Eye(), settings);
     auto staticAsteroidData = mAsteroids->StaticData();
     auto dynamicAsteroidData = mAsteroids->DynamicData();
@@ -482,7 +581,8 @@ void Asteroids::Render(float frameTime, const OrbitCamera& camera, const Setting
     ProfileBeginRenderSubset();
 
     auto viewProjection = camera.ViewProjection();
-    for (UINT drawIdx = 0; drawIdx < NUM_ASTEROIDS; ++drawIdx)
+    auto drawCount = std::min((UINT)NUM_ASTEROIDS, settings.drawBudget);
+    for (UINT drawIdx = 0; drawIdx < drawCount; ++drawIdx)
     {
         auto staticData = &staticAsteroidData[drawIdx];
         auto dynamicData = &dynamicAsteroidData[drawIdx];
@@ -498,15 +598,75 @@ void Asteroids::Render(float frameTime, const OrbitCamera& camera, const Setting
 
         mDeviceCtxt->Unmap(mDrawConstantBuffer, 0);
 
-        mDeviceCtxt->PSSetShaderResources(0, 1, &mTextureSRVs[staticData->textureIndex]);
+        // Only asteroids in view ask for (and so keep resident) pool textures
+        auto textureIndex = staticData->textureIndex;
+        if (mTexturePool &&
+            camera.Frustum().SphereVisible(dynamicData->world.r[3], ASTEROID_BOUNDING_SCALE * staticData->scale)) {
+            auto dim = ProceduralTexturePool::DimForLOD(dynamicData->subdiv, mAsteroids->SubdivCount(),
+                                                        mAsteroids->Assets()->TextureDim());
+            textureIndex = mTexturePool->Request(mTexturePool->VirtualIndexForAsteroid(drawIdx), dim, textureIndex);
+        }
+        mDeviceCtxt->PSSetShaderResources(0, 1, &mTextureSRVs[textureIndex]);
 
         mDeviceCtxt->DrawIndexedInstanced(dynamicData->indexCount, 1, dynamicData->indexStart, staticData->vertexStart, 0);
     }
 
     ProfileEndRenderSubset();
 
-    // Draw skybox
+    // Draw skybox (black until it has streamed in)
     {
+        if (auto skyboxSRV = mLoadedSkyboxSRV.exchange(nullptr)) {
+            assert(mSkyboxSRV == nullptr);
+            mSkyboxSRV = skyboxSRV;
+            mSkyboxSRV->GetResource(&mSkyboxTexture);
+        }
+
+        // Stream the mips coarsest first: the small tail in one frame, then each larger mip in bands of rows
+        // across faces and frames. Sampling reaches down to a mip once all of it is in.
+        UINT firstMip = 0;
+        UINT mipCount = 0;
+        if (mSkyboxSRV && mSkyboxResidency->NextStep(&firstMip, &mipCount)) {
+            auto mipLevels = mSkyboxMips->mipLevels;
+            bool complete = true;
+            if (mipCount > 1) {
+                for (UINT a = 0; a < mSkyboxMips->arraySize; ++a) {
+                    for (UINT m = firstMip; m < firstMip + mipCount; ++m) {
+                        auto data = &mSkyboxMips->subresources[a * mipLevels + m];
+                        mDeviceCtxt->UpdateSubresource(mSkyboxTexture, D3D11CalcSubresource(m, a, mipLevels), nullptr,
+                                                       data->pSysMem, data->SysMemPitch, data->SysMemSlicePitch);
+                    }
+                }
+            } else {
+                UINT width = std::max(1U, mSkyboxMips->width >> firstMip);
+                UINT height = std::max(1U, mSkyboxMips->height >> firstMip);
+                UINT bytes = 0;
+                while (bytes < SKYBOX_UPLOAD_BYTES_PER_FRAME && mSkyboxUploadSlice < mSkyboxMips->arraySize) {
+                    auto data = &mSkyboxMips->subresources[mSkyboxUploadSlice * mipLevels + firstMip];
+                    UINT rows = std::max(1U, (SKYBOX_UPLOAD_BYTES_PER_FRAME - bytes) / data->SysMemPitch);
+                    rows = std::min(rows, height - mSkyboxUploadRow);
+
+                    D3D11_BOX box = { 0, mSkyboxUploadRow, 0, width, mSkyboxUploadRow + rows, 1 };
+                    mDeviceCtxt->UpdateSubresource(mSkyboxTexture, D3D11CalcSubresource(firstMip, mSkyboxUploadSlice, mipLevels),
+                                                   &box, (const BYTE*)data->pSysMem + mSkyboxUploadRow * data->SysMemPitch,
+                                                   data->SysMemPitch, 0);
+                    bytes += rows * data->SysMemPitch;
+
+                    mSkyboxUploadRow += rows;
+                    if (mSkyboxUploadRow == height) {
+                        mSkyboxUploadRow = 0;
+                        ++mSkyboxUploadSlice;
+                    }
+                }
+                complete = mSkyboxUploadSlice == mSkyboxMips->arraySize;
+                if (complete) mSkyboxUploadSlice = 0;
+            }
+            if (complete) {
+                mSkyboxResidency->MarkResident(firstMip);
+                mDeviceCtxt->SetResourceMinLOD(mSkyboxTexture, mSkyboxResidency->MinLODClamp());
+            }
+        }
+        ID3D11ShaderResourceView* skyboxSRV = mSkyboxSRV && mSkyboxResidency->AnyResident() ? mSkyboxSRV : nullptr;
+
         D3D11_MAPPED_SUBRESOURCE mapped = {};
         ThrowIfFailed(mDeviceCtxt->Map(mSkyboxConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
         auto skyboxConstants = (SkyboxConstantBuffer*) mapped.pData;
@@ -524,7 +684,7 @@ void Asteroids::Render(float frameTime, const OrbitCamera& camera, const Setting
 
         mDeviceCtxt->PSSetShader(mSkyboxPixelShader, nullptr, 0);
         mDeviceCtxt->PSSetSamplers(0, 1, &mSamplerState);
-        mDeviceCtxt->PSSetShaderResources(0, 1, &mSkyboxSRV);
+        mDeviceCtxt->PSSetShaderResources(0, 1, &skyboxSRV);
 
         mDeviceCtxt->Draw(6*6, 0);
     }
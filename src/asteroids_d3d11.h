@@ -21,12 +21,16 @@
 #include <directxmath.h>
 #include <random>
 #include <map>
+#include <atomic>
 
 #include "camera.h"
 #include "settings.h"
 #include "simulation.h"
 #include "util.h"
 #include "gui.h"
+#include "texture.h"
+#include "mip_residency.h"
+#include "texture_pool.h"
 
 namespace AsteroidsD3D11 {
 
@@ -45,19 +49,33 @@ struct SkyboxConstantBuffer {
 
 class Asteroids {
 public:
+    // Creates the device and pipeline state only; the remaining resources are created by the calls below
     Asteroids(AsteroidsSimulation* asteroids, GUI* gui, bool warp);
     ~Asteroids();
 
+    // These only touch the (free-threaded) device, so they can run concurrently once their inputs are ready
+    void CreateMeshes();          // Requires simulation meshes
+    void InitializeTextureData(); // Requires simulation textures
+    void CreateGUIResources(const std::map<std::string, const DDSFile*>& spriteFiles);
+
+    // May be called while rendering. Render then streams in one step of mips per frame, coarsest first;
+    // the skybox renders black until the first step lands. The chain must outlive rendering.
+    void CreateSkybox(const TextureMipChain& skybox);
+
+    // Asteroids then sample textures from a pool of virtualCount procedural textures, generated on demand
+    // at a resolution matching their LOD; the unique textures remain as fallbacks until they are resident.
+    void EnableTexturePool(UINT virtualCount, UINT64 budgetBytes);
+    UINT64 TexturePoolBytes() const { return mTexturePool ? mTexturePool->ResidentBytes() : 0; }
+
+    // Re-uploads the meshes and textures the simulation's asset pool regenerated; colors are read every frame
+    void UpdateAssets(const AssetChanges& changes);
+
     void Render(float frameTime, const OrbitCamera& camera, const Settings& settings);
 
     void ReleaseSwapChain();
     void ResizeSwapChain(IDXGIFactory2* dxgiFactory, HWND outputWindow, unsigned int width, unsigned int height);
 
 private:
-    void CreateMeshes();
-    void InitializeTextureData();
-    void CreateGUIResources();
-
     AsteroidsSimulation*        mAsteroids = nullptr;
     GUI*                        mGUI = nullptr;
 
@@ -98,9 +116,16 @@ private:
     ID3D11Buffer*               mSkyboxVertexBuffer = nullptr;
     ID3D11InputLayout*          mSkyboxInputLayout = nullptr;
     ID3D11ShaderResourceView*   mSkyboxSRV = nullptr;
+    std::atomic<ID3D11ShaderResourceView*> mLoadedSkyboxSRV{ nullptr };
+    ID3D11Resource*             mSkyboxTexture = nullptr;
+    const TextureMipChain*      mSkyboxMips = nullptr;
+    std::unique_ptr<MipResidency> mSkyboxResidency;
+    UINT                        mSkyboxUploadSlice = 0; // Progress through the current single mip step
+    UINT                        mSkyboxUploadRow = 0;
 
     ID3D11Texture2D*            mTextures[NUM_UNIQUE_TEXTURES];
-    ID3D11ShaderResourceView*   mTextureSRVs[NUM_UNIQUE_TEXTURES];
+    ID3D11ShaderResourceView*   mTextureSRVs[NUM_TEXTURE_SLOTS]; // Pool slots are owned by mTexturePool
+    std::unique_ptr<ProceduralTexturePool> mTexturePool;
     ID3D11SamplerState*         mSamplerState = nullptr;
 };
 
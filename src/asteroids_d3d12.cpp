@@ -98,7 +98,7 @@ Asteroids::Asteroids(AsteroidsSimulation* asteroids, GUI *gui, UINT minCmdLsts,
     mRTVDescs = new RTVDescriptorList(mDevice, NUM_SWAP_CHAIN_BUFFERS);
     mDSVDescs = new DSVDescriptorList(mDevice, 1);
     mSMPDescs = new SMPDescriptorList(mDevice, 1);
-    mSRVDescs = new SRVDescriptorList(mDevice, NUM_UNIQUE_TEXTURES);
+    mSRVDescs = new SRVDescriptorList(mDevice, NUM_TEXTURE_SLOTS);
 
     // Filled in in Resize - just take slots for them here
     mDepthStencilView = mDSVDescs->Append();
@@ -106,37 +106,7 @@ Asteroids::Asteroids(AsteroidsSimulation* asteroids, GUI *gui, UINT minCmdLsts,
     mDSVFormat = DXGI_FORMAT_D32_FLOAT;
         
     CreatePSOs();
-    CreateMeshes();
-    
-    // Create textures
-    {
-        // TODO: Query simulation for this data? Defines good enough for now...
-        D3D12_RESOURCE_DESC textureDesc =
-            CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, TEXTURE_DIM, TEXTURE_DIM, 3, 0);
-
-        for (UINT i = 0; i < NUM_UNIQUE_TEXTURES; ++i) {
-            ThrowIfFailed(mDevice->CreateCommittedResource(
-                &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-                D3D12_HEAP_FLAG_NONE,
-                &textureDesc,
-                D3D12_RESOURCE_STATE_COMMON,
-                nullptr, // Clear value
-                IID_PPV_ARGS(&mAsteroidTextures[i])
-            ));
-            textureDesc = mAsteroidTextures[i]->GetDesc();
-
-            InitializeTexture2D(mDevice, mCommandQueue, mAsteroidTextures[i], &textureDesc, 4, mAsteroids->TextureData(i));
-
-            // Append a descriptor to the heap
-            mSRVDescs->AppendSRV(mAsteroidTextures[i]);
-        }
 
-        ThrowIfFailed(CreateTexture2DFromDDS_XXXX8(
-            mDevice, mCommandQueue, &mSkybox, "starbox_1024.dds", DXGI_FORMAT_B8G8R8A8_UNORM_SRGB));
-    }
-    
-    CreateGUIResources();
-    
     // Fill in general heaps
     { // Samplers
         D3D12_SAMPLER_DESC sampler = {};
@@ -197,19 +167,15 @@ Asteroids::Asteroids(AsteroidsSimulation* asteroids, GUI *gui, UINT minCmdLsts,
             // Skybox constants
             frame->mSkyboxConstants = dynamicUploadGPUVA + offsetof(DynamicUploadHeap, mSkyboxConstants);
                                     
-            // Skybox texture
+            // Skybox texture: null view (black) until it has streamed in, see UpdateSkyboxDescriptor
             {
-                auto textureDesc = mSkybox->GetDesc();
-
                 D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-                srvDesc.Format = textureDesc.Format;
-                srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;                
+                srvDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+                srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
                 srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
                 srvDesc.TextureCube.MipLevels = 1;
-                srvDesc.TextureCube.MostDetailedMip = 0;
-                srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
 
-                frame->mSkyboxTexture = frame->mSRVDescs->AppendSRV(mSkybox, &srvDesc);
+                frame->mSkyboxTexture = frame->mSRVDescs->AppendSRV(nullptr, &srvDesc);
             }
 
             // The rest of the heap we'll use for dynamically copy descriptors into, etc.
@@ -238,6 +204,7 @@ Asteroids::Asteroids(AsteroidsSimulation* asteroids, GUI *gui, UINT minCmdLsts,
 Asteroids::~Asteroids()
 {
     WaitForAll();
+    mTexturePool.reset();
     ReleaseSwapChain();
 
     SafeRelease(&mPreCmdLst);
@@ -255,6 +222,7 @@ Asteroids::~Asteroids()
     SafeRelease(&mFontPSO);
     SafeRelease(&mSpritePSO);
     SafeRelease(&mSkybox);
+    if (auto texture = mLoadedSkybox.exchange(nullptr)) texture->Release();
     SafeRelease(&mSkyboxPSO);
         
     for (UINT f = 0; f < NUM_FRAMES_TO_BUFFER; ++f) {
@@ -434,7 +402,7 @@ void Asteroids::CreatePSOs()
     // Asteroids root signature (tN, s0, b0)
     {
         CD3DX12_DESCRIPTOR_RANGE descRanges[2];
-        descRanges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, NUM_UNIQUE_TEXTURES, 0, 0); // t0...tN
+        descRanges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, NUM_TEXTURE_SLOTS, 0, 0); // t0...tN
         descRanges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, 1, 0); // s0
 
         CD3DX12_ROOT_PARAMETER rootParams[3];
@@ -554,7 +522,7 @@ void Asteroids::CreateSubsets(UINT numHeapsPerFrame)
 
         for (UINT subsetIdx = 0; subsetIdx < mSubsetCount; ++subsetIdx) {
             void* memory = _aligned_malloc(sizeof(SubsetD3D12), 64);
-            auto subset = new(memory) SubsetD3D12(mDevice, NUM_UNIQUE_TEXTURES, mAsteroidPSO);
+            auto subset = new(memory) SubsetD3D12(mDevice, NUM_TEXTURE_SLOTS, mAsteroidPSO);
             frame->mSubsets.push_back(subset);
         }
     }
@@ -579,13 +547,13 @@ void Asteroids::ReleaseSubsets()
 
 void Asteroids::CreateMeshes()
 {
-    auto asteroidMeshes = mAsteroids->Meshes();
+    auto asteroidMeshes = mAsteroids->Assets()->Meshes();
     std::vector<SkyboxVertex> skyboxVertices;
     CreateSkyboxMesh(&skyboxVertices);
 
     // Simple linear allocate
-    UINT64 asteroidVBSize = asteroidMeshes->vertices.size() * sizeof(asteroidMeshes->vertices[0]);
-    UINT64 asteroidIBSize = asteroidMeshes->indices.size()  * sizeof(asteroidMeshes->indices[0]);
+    UINT64 asteroidVBSize = asteroidMeshes.vertexCount * sizeof(Vertex);
+    UINT64 asteroidIBSize = asteroidMeshes.indexCount  * sizeof(IndexType);
     UINT64 skyboxVBSize = skyboxVertices.size() * sizeof(SkyboxVertex);
 
     UINT64 asteroidVBOffset = 0;
@@ -599,16 +567,16 @@ void Asteroids::CreateMeshes()
 
     // Asteroid vertices
     {
-        memcpy(bufferWO + asteroidVBOffset, asteroidMeshes->vertices.data(), asteroidVBSize);
+        memcpy(bufferWO + asteroidVBOffset, asteroidMeshes.vertices, asteroidVBSize);
 
         mAsteroidVertexBufferView.BufferLocation = gpuVA + asteroidVBOffset;
         mAsteroidVertexBufferView.SizeInBytes    = static_cast<UINT>(asteroidVBSize);
-        mAsteroidVertexBufferView.StrideInBytes  = sizeof(asteroidMeshes->vertices[0]);
+        mAsteroidVertexBufferView.StrideInBytes  = sizeof(Vertex);
     }
 
     // Asteroid indices
     {
-        memcpy(bufferWO + asteroidIBOffset, asteroidMeshes->indices.data(), asteroidIBSize);
+        memcpy(bufferWO + asteroidIBOffset, asteroidMeshes.indices, asteroidIBSize);
 
         mAsteroidIndexBufferView.BufferLocation = gpuVA + asteroidIBOffset;
         mAsteroidIndexBufferView.SizeInBytes    = static_cast<UINT>(asteroidIBSize);
@@ -626,7 +594,179 @@ void Asteroids::CreateMeshes()
 }
 
 
-void Asteroids::CreateGUIResources()
+void Asteroids::CreateTextures()
+{
+    auto textureDim = mAsteroids->Assets()->TextureDim();
+    D3D12_RESOURCE_DESC textureDesc =
+        CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, textureDim, textureDim, 3, 0);
+
+    // Descriptor i always maps to texture i, so the uploads can go in parallel
+    mSRVDescs->Resize(NUM_TEXTURE_SLOTS);
+
+    // Texture pool slots stay null views until the pool binds something to them
+    {
+        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        srvDesc.Texture2DArray.MipLevels = 1;
+        srvDesc.Texture2DArray.ArraySize = 3;
+        for (UINT i = NUM_UNIQUE_TEXTURES; i < NUM_TEXTURE_SLOTS; ++i) {
+            mDevice->CreateShaderResourceView(nullptr, &srvDesc, mSRVDescs->CPU(i));
+        }
+    }
+
+    concurrency::parallel_for(UINT(0), UINT(NUM_UNIQUE_TEXTURES), [&](UINT i) {
+        ThrowIfFailed(mDevice->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+            D3D12_HEAP_FLAG_NONE,
+            &textureDesc,
+            D3D12_RESOURCE_STATE_COMMON,
+            nullptr, // Clear value
+            IID_PPV_ARGS(&mAsteroidTextures[i])
+        ));
+        auto desc = mAsteroidTextures[i]->GetDesc();
+
+        InitializeTexture2D(mDevice, mCommandQueue, mAsteroidTextures[i], &desc, 4, mAsteroids->Assets()->TextureData(i));
+
+        mDevice->CreateShaderResourceView(mAsteroidTextures[i], nullptr, mSRVDescs->CPU(i));
+    });
+}
+
+
+void Asteroids::EnableTexturePool(UINT virtualCount, UINT64 budgetBytes)
+{
+    auto create = [this](const PooledTexture& texture) -> IUnknown* {
+        auto desc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, texture.dim, texture.dim,
+                                                 (UINT16)texture.arraySize, (UINT16)texture.mipLevels);
+        ID3D12Resource* resource = nullptr;
+        ThrowIfFailed(mDevice->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+            D3D12_HEAP_FLAG_NONE,
+            &desc,
+            D3D12_RESOURCE_STATE_COMMON,
+            nullptr,
+            IID_PPV_ARGS(&resource)
+        ));
+        InitializeTexture2D(mDevice, mCommandQueue, resource, &desc, 4, texture.subresources.data());
+        return resource;
+    };
+
+    // Slots are only rebound once no buffered frame can still be sampling them
+    auto bind = [this](UINT slot, IUnknown* texture) {
+        mDevice->CreateShaderResourceView((ID3D12Resource*)texture, nullptr, mSRVDescs->CPU(slot));
+    };
+
+    mTexturePool.reset(new ProceduralTexturePool(virtualCount, NUM_UNIQUE_TEXTURES, NUM_TEXTURE_POOL_SLOTS,
+                                                 budgetBytes, NUM_FRAMES_TO_BUFFER, create, bind));
+    mTexturePool->SetTextureParams(mAsteroids->Assets()->Params().textures);
+}
+
+
+void Asteroids::CreateSkybox(const TextureMipChain& skybox)
+{
+    auto desc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_B8G8R8A8_UNORM_SRGB,
+                                             skybox.width, skybox.height,
+                                             (UINT16)skybox.arraySize, (UINT16)skybox.mipLevels);
+
+    // Sampled from the moment it is published; the view's min LOD clamp keeps sampling off the mips still in flight
+    ID3D12Resource* texture = nullptr;
+    ThrowIfFailed(mDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &desc,
+        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+        nullptr,
+        IID_PPV_ARGS(&texture)
+    ));
+
+    mSkyboxResidency.reset(new MipResidency(skybox.width, skybox.height, skybox.mipLevels));
+    mLoadedSkybox = texture;
+
+    // Each step's upload waits for the GPU itself before it is marked resident; Render lowers a frame's
+    // clamp only once that frame's heap is idle
+    UINT firstMip = 0;
+    UINT mipCount = 0;
+    while (mSkyboxResidency->NextStep(&firstMip, &mipCount)) {
+        UploadTexture2DMips(mDevice, mCommandQueue, texture, &desc, 4, skybox.subresources.data(),
+                            firstMip, mipCount,
+                            D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        mSkyboxResidency->MarkResident(firstMip);
+    }
+}
+
+
+void Asteroids::UpdateAssets(const AssetChanges& changes)
+{
+    // The meshes are read in place from the upload heap
+    WaitForAll();
+
+    auto assets = mAsteroids->Assets();
+    auto meshes = assets->Meshes();
+    auto meshVertices = assets->VertexCountPerMesh();
+    auto bufferWO = (BYTE*)mMeshUpload->DataWO(); // Asteroid vertices are first
+    for (auto m : changes.meshes) {
+        memcpy(bufferWO + m * meshVertices * sizeof(Vertex), meshes.vertices + m * meshVertices,
+               meshVertices * sizeof(Vertex));
+    }
+
+    for (auto t : changes.textures) {
+        auto desc = mAsteroidTextures[t]->GetDesc();
+        UploadTexture2DMips(mDevice, mCommandQueue, mAsteroidTextures[t], &desc, 4, assets->TextureData(t),
+                            0, desc.MipLevels,
+                            D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    }
+
+    // Pooled textures regenerate as they are next requested
+    if (mTexturePool) mTexturePool->SetTextureParams(assets->Params().textures);
+}
+
+
+void Asteroids::UpdateStaticData()
+{
+    WaitForAll();
+
+    // As set up in the constructor
+    auto staticData = mAsteroids->StaticData();
+    for (UINT f = 0; f < NUM_FRAMES_TO_BUFFER; f++) {
+        auto dynamicUploadWO = mFrame[f].mDynamicUpload->DataWO();
+        for (int j = 0; j < NUM_ASTEROIDS; ++j) {
+            auto constants = &dynamicUploadWO->mDrawConstantBuffers[j];
+            constants->mSurfaceColor = staticData[j].surfaceColor;
+            constants->mDeepColor = staticData[j].deepColor;
+        }
+    }
+}
+
+
+void Asteroids::UpdateSkyboxDescriptor(Frame* frame)
+{
+    if (auto texture = mLoadedSkybox.exchange(nullptr)) {
+        assert(mSkybox == nullptr);
+        mSkybox = texture;
+    }
+    if (mSkybox == nullptr || !mSkyboxResidency->AnyResident()) return;
+
+    auto minLODClamp = mSkyboxResidency->MinLODClamp();
+    if (minLODClamp == frame->mSkyboxMinLODClamp) return;
+
+    auto textureDesc = mSkybox->GetDesc();
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Format = textureDesc.Format;
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+    srvDesc.TextureCube.MipLevels = textureDesc.MipLevels;
+    srvDesc.TextureCube.MostDetailedMip = 0;
+    srvDesc.TextureCube.ResourceMinLODClamp = minLODClamp;
+
+    // Slot reserved by the constructor
+    mDevice->CreateShaderResourceView(mSkybox, &srvDesc, frame->mSRVDescs->CPU(0));
+    frame->mSkyboxMinLODClamp = minLODClamp;
+}
+
+
+void Asteroids::CreateGUIResources(const std::map<std::string, const DDSFile*>& spriteFiles)
 {
     auto font = mGUI->Font();
     auto textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(
@@ -652,8 +792,26 @@ void Asteroids::CreateGUIResources()
         auto control = (*mGUI)[i];
         if (control->TextureFile().length() > 0 && mSpriteTextures.find(control->TextureFile()) == mSpriteTextures.end()) {
             ID3D12Resource* texture = nullptr;
-            ThrowIfFailed(CreateTexture2DFromDDS_XXXX8(
-                mDevice, mCommandQueue, &texture, control->TextureFile().c_str(), DXGI_FORMAT_B8G8R8A8_UNORM_SRGB));
+            if (control->TextureFile() == GUI_PALETTE_TEXTURE) {
+                auto paletteDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_B8G8R8A8_UNORM_SRGB, GUI_COLOR_COUNT, 1, 1, 1);
+                ThrowIfFailed(mDevice->CreateCommittedResource(
+                    &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+                    D3D12_HEAP_FLAG_NONE,
+                    &paletteDesc,
+                    D3D12_RESOURCE_STATE_COMMON,
+                    nullptr,
+                    IID_PPV_ARGS(&texture)
+                ));
+
+                D3D11_SUBRESOURCE_DATA paletteData = {};
+                paletteData.pSysMem = GUIPalettePixels();
+                paletteData.SysMemPitch = GUI_COLOR_COUNT * sizeof(UINT);
+
+                InitializeTexture2D(mDevice, mCommandQueue, texture, &paletteDesc, 1, &paletteData);
+            } else {
+                ThrowIfFailed(CreateTexture2DFromDDS_XXXX8(
+                    mDevice, mCommandQueue, &texture, *spriteFiles.at(control->TextureFile()), DXGI_FORMAT_B8G8R8A8_UNORM_SRGB));
+            }
             mSpriteTextures[control->TextureFile()] = texture;
         }
     }
@@ -720,18 +878,24 @@ void Asteroids::RenderSubset(
     // Set textures (all as a single descriptor table) and samplers
     cmdLst->SetGraphicsRootDescriptorTable(RP_TEX_SRV, mSRVDescs->GPU(0));
     cmdLst->SetGraphicsRootDescriptorTable(RP_SMP, mSampler);
+
+    // Everything is simulated, but only draws within the budget are issued
+    UINT drawLimit = std::max(drawStart, std::min(drawEnd, settings.drawBudget));
         
     if (!settings.executeIndirect)
     {
         // Standard draw path
         auto constantsPointer = frame->mDrawConstantBuffersGPUVA + sizeof(DrawConstantBuffer) * drawStart;
-        for (UINT drawIdx = drawStart; drawIdx < drawEnd; ++drawIdx)
+        for (UINT drawIdx = drawStart; drawIdx < drawLimit; ++drawIdx)
         {
             auto staticData = &staticAsteroidData[drawIdx];
             auto dynamicData = &dynamicAsteroidData[drawIdx];
 
             XMStoreFloat4x4(&drawConstantBuffers[drawIdx].mWorld, dynamicData->world);
             XMStoreFloat4x4(&drawConstantBuffers[drawIdx].mViewProjection, viewProjection);
+            if (mTexturePool) {
+                drawConstantBuffers[drawIdx].mTextureIndex = PoolTextureSlot(drawIdx, *staticData, *dynamicData);
+            }
 
             // Set root cbuffer
             cmdLst->SetGraphicsRootConstantBufferView(RP_DRAW_CBV, constantsPointer);
@@ -743,22 +907,28 @@ void Asteroids::RenderSubset(
     else
     {
         // ExecuteIndirect path
-        for (UINT drawIdx = drawStart; drawIdx < drawEnd; ++drawIdx)
+        for (UINT drawIdx = drawStart; drawIdx < drawLimit; ++drawIdx)
         {
             auto dynamicData = &dynamicAsteroidData[drawIdx];
 
             XMStoreFloat4x4(&drawConstantBuffers[drawIdx].mWorld, dynamicData->world);
             XMStoreFloat4x4(&drawConstantBuffers[drawIdx].mViewProjection, viewProjection);
+            if (mTexturePool) {
+                drawConstantBuffers[drawIdx].mTextureIndex =
+                    PoolTextureSlot(drawIdx, staticAsteroidData[drawIdx], *dynamicData);
+            }
 
             auto drawIndexed = &indirectArgs[drawIdx].mDrawIndexed;
             drawIndexed->IndexCountPerInstance = dynamicData->indexCount;
             drawIndexed->StartIndexLocation = dynamicData->indexStart;
         }
 
-        UINT64 offset = (BYTE*)(&indirectArgs[drawStart]) - (BYTE*)frame->mDynamicUpload->DataWO();
-        cmdLst->ExecuteIndirect(mCommandSignature, drawEnd - drawStart,
-                                frame->mDynamicUpload->Heap(), offset,
-                                nullptr, 0);
+        if (drawLimit > drawStart) {
+            UINT64 offset = (BYTE*)(&indirectArgs[drawStart]) - (BYTE*)frame->mDynamicUpload->DataWO();
+            cmdLst->ExecuteIndirect(mCommandSignature, drawLimit - drawStart,
+                                    frame->mDynamicUpload->Heap(), offset,
+                                    nullptr, 0);
+        }
     }
 
     subset->End();
@@ -766,6 +936,18 @@ void Asteroids::RenderSubset(
     ProfileEndRenderSubset();
 }
 
+UINT Asteroids::PoolTextureSlot(UINT drawIdx, const AsteroidStatic& staticData, const AsteroidDynamic& dynamicData)
+{
+    // Only asteroids in view ask for (and so keep resident) pool textures
+    if (!mFrustum.SphereVisible(dynamicData.world.r[3], ASTEROID_BOUNDING_SCALE * staticData.scale)) {
+        return staticData.textureIndex;
+    }
+
+    auto dim = ProceduralTexturePool::DimForLOD(dynamicData.subdiv, mAsteroids->SubdivCount(),
+                                                mAsteroids->Assets()->TextureDim());
+    return mTexturePool->Request(mTexturePool->VirtualIndexForAsteroid(drawIdx), dim, staticData.textureIndex);
+}
+
 void Asteroids::Render(float frameTime, const OrbitCamera& camera, const Settings& settings)
 {
     // Pick the right swap chain buffer based on where DXGI says we are...
@@ -777,6 +959,13 @@ void Asteroids::Render(float frameTime, const OrbitCamera& camera, const Setting
     assert(mCurrentFrameIndex < NUM_FRAMES_TO_BUFFER);
     auto frame = &mFrame[mCurrentFrameIndex];
 
+    // This frame's heap is no longer in use by the GPU (see WaitForReadyToRender)
+    UpdateSkyboxDescriptor(frame);
+    if (mTexturePool) mTexturePool->BeginFrame();
+    mFrustum = camera.Frustum();
+    // Before the subsets update their ranges in parallel
+    mAsteroids->BeginFrame(frameTime, settings, camera);
+
     ProfileBeginFrame(mCurrentFrameIndex);
 
     ProfileBeginRender();
@@ -23,6 +23,7 @@
 #include <deque>
 #include <random>
 #include <map>
+#include <atomic>
 
 #include "camera.h"
 #include "settings.h"
@@ -32,6 +33,9 @@
 #include "upload_heap.h"
 #include "util.h"
 #include "gui.h"
+#include "texture.h"
+#include "mip_residency.h"
+#include "texture_pool.h"
 
 namespace AsteroidsD3D12 {
 
@@ -63,9 +67,31 @@ struct DynamicUploadHeap {
 
 class Asteroids {
 public:
+    // Creates the device, pipeline state and per-frame resources only; the remaining resources are
+    // created by the calls below
     Asteroids(AsteroidsSimulation* asteroids, GUI *gui, UINT minCmdLsts, IDXGIAdapter* adapter);
     ~Asteroids();
 
+    // These only touch the device and command queue (each upload waits on its own), so they can run
+    // concurrently once their inputs are ready
+    void CreateMeshes();   // Requires simulation meshes
+    void CreateTextures(); // Requires simulation textures
+    void CreateGUIResources(const std::map<std::string, const DDSFile*>& spriteFiles);
+
+    // May be called while rendering and returns once every mip has streamed in, coarsest first.
+    // The skybox renders black until the first step lands; the chain must outlive the call.
+    void CreateSkybox(const TextureMipChain& skybox);
+
+    // Asteroids then sample textures from a pool of virtualCount procedural textures, generated on demand
+    // at a resolution matching their LOD; the unique textures remain as fallbacks until they are resident.
+    void EnableTexturePool(UINT virtualCount, UINT64 budgetBytes);
+    UINT64 TexturePoolBytes() const { return mTexturePool ? mTexturePool->ResidentBytes() : 0; }
+
+    // Between frames: re-upload what the simulation's asset pool regenerated, or the asteroid colors after
+    // AsteroidsSimulation::SetColorSchemes. Both wait for the GPU to go idle first.
+    void UpdateAssets(const AssetChanges& changes);
+    void UpdateStaticData();
+
     void WaitForReadyToRender();
     void Render(float frameTime, const OrbitCamera& camera, const Settings& settings);
 
@@ -82,14 +108,14 @@ private:
         DirectX::XMVECTOR cameraEye, DirectX::XMMATRIX viewProjection,
         const Settings& settings);
 
+    // Thread-safe; the asteroid's unique texture until its pooled texture is resident
+    UINT PoolTextureSlot(UINT drawIdx, const AsteroidStatic& staticData, const AsteroidDynamic& dynamicData);
+
     void CreatePSOs();
 
     void CreateSubsets(UINT numHeapsPerFrame);
     void ReleaseSubsets();
 
-    void CreateMeshes();
-    void CreateGUIResources();
-
     struct Frame {
         std::vector<SubsetD3D12*>   mSubsets;
         ID3D12CommandAllocator*     mCmdAlloc = nullptr;
@@ -102,11 +128,14 @@ private:
         SRVDescriptorList*          mSRVDescs = nullptr;
         D3D12_GPU_VIRTUAL_ADDRESS   mSkyboxConstants;
         D3D12_GPU_DESCRIPTOR_HANDLE mSkyboxTexture;
+        float                       mSkyboxMinLODClamp = -1.0f; // < 0 => view not yet written
         UINT                        mSRVDescsDynamicStart = 0;
 
         UINT64                      mFrameCompleteFence = 0;
     } mFrame[NUM_FRAMES_TO_BUFFER];
 
+    void UpdateSkyboxDescriptor(Frame* frame);
+
     // Swap chain resources
     struct SwapChainBuffer {
         ID3D12Resource*             mRenderTarget = nullptr;
@@ -162,6 +191,11 @@ private:
     
     ID3D12PipelineState*        mSkyboxPSO = nullptr;
     ID3D12Resource*             mSkybox = nullptr;
+    std::atomic<ID3D12Resource*> mLoadedSkybox{ nullptr };
+    std::unique_ptr<MipResidency> mSkyboxResidency;
+
+    std::unique_ptr<ProceduralTexturePool> mTexturePool;
+    ViewFrustum mFrustum; // This frame's, for the pool requests of the subsets
 
     ID3D12PipelineState*        mFontPSO = nullptr;
     ID3D12Resource*             mFontTexture = nullptr;
@@ -0,0 +1,528 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "benchmark_results.h"
+#include "json.h"
+
+#include <intrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <utility>
+
+namespace {
+
+enum { BOOTSTRAP_RESAMPLES = 1000 };
+const double CONFIDENCE = 0.95;
+const double SIGNIFICANCE = 0.01;
+const double MIN_MEDIAN_MS = 0.001; // Relative changes of (nearly) idle stages are meaningless
+
+std::string CPUBrand()
+{
+    int regs[12] = {};
+    __cpuid(regs, 0x80000000);
+    if ((unsigned int)regs[0] < 0x80000004) return "unknown";
+    for (int i = 0; i < 3; ++i) {
+        __cpuid(regs + 4 * i, 0x80000002 + i);
+    }
+    std::string brand((const char*)regs, sizeof(regs));
+    brand = brand.c_str(); // Drop the padding
+    brand.erase(0, brand.find_first_not_of(' '));
+    return brand;
+}
+
+// Changes whenever the executable is relinked, unless the build injects an id of its own (e.g. a commit hash)
+std::string BuildId()
+{
+#if defined(ASTEROIDS_BUILD_ID)
+    return ASTEROIDS_BUILD_ID;
+#else
+    auto base = (const BYTE*)GetModuleHandle(NULL);
+    auto ntHeaders = (const IMAGE_NT_HEADERS*)(base + ((const IMAGE_DOS_HEADER*)base)->e_lfanew);
+    std::ostringstream id;
+    id << std::hex << std::setw(8) << std::setfill('0') << ntHeaders->FileHeader.TimeDateStamp;
+    return id.str();
+#endif
+}
+
+void WriteDistribution(std::ofstream& file, const char* name, const std::vector<float>& samples, bool last)
+{
+    std::vector<float> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&](double p) {
+        return sorted.empty() ? 0.0f : sorted[std::min(sorted.size() - 1, size_t(p * sorted.size()))];
+    };
+    double sum = 0.0;
+    for (auto s : samples) sum += s;
+
+    file << "    \"" << name << "\": { \"mean_ms\": " << (samples.empty() ? 0.0 : sum / samples.size())
+         << ", \"p50_ms\": " << percentile(0.5) << ", \"p90_ms\": " << percentile(0.9)
+         << ", \"p99_ms\": " << percentile(0.99) << ", \"max_ms\": " << (sorted.empty() ? 0.0f : sorted.back())
+         << "," << std::endl << "      \"samples_ms\": [";
+    for (size_t i = 0; i < samples.size(); ++i) {
+        file << (i ? "," : "") << (i % 16 ? " " : "\n        ") << samples[i];
+    }
+    file << " ] }" << (last ? "" : ",") << std::endl;
+}
+
+
+// Just enough JSON to read back what BenchmarkRecorder writes
+struct JsonValue
+{
+    enum Type { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+    Type type = JSON_NULL;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    const JsonValue* Find(const char* key) const
+    {
+        for (auto& member : object) {
+            if (member.first == key) return &member.second;
+        }
+        return nullptr;
+    }
+
+    // Scalars as text, for comparing fingerprints and settings
+    std::string Text() const
+    {
+        if (type == JSON_STRING) return string;
+        if (type == JSON_BOOL) return number != 0.0 ? "true" : "false";
+        std::ostringstream text;
+        text << number;
+        return text.str();
+    }
+};
+
+class JsonParser
+{
+public:
+    JsonParser(const std::string& text) : mCur(text.c_str()), mEnd(text.c_str() + text.size()) {}
+
+    bool Parse(JsonValue* outValue)
+    {
+        return ParseValue(outValue) && (SkipSpace(), mCur == mEnd);
+    }
+
+private:
+    void SkipSpace()
+    {
+        while (mCur < mEnd && (*mCur == ' ' || *mCur == '\t' || *mCur == '\r' || *mCur == '\n')) ++mCur;
+    }
+
+    bool Match(const char* token)
+    {
+        auto length = strlen(token);
+        if ((size_t)(mEnd - mCur) < length || strncmp(mCur, token, length) != 0) return false;
+        mCur += length;
+        return true;
+    }
+
+    bool ParseString(std::string* outString)
+    {
+        if (*mCur++ != '"') return false;
+        while (mCur < mEnd && *mCur != '"') {
+            // Only the escapes JsonEscape produces
+            if (*mCur == '\\') {
+                if (++mCur == mEnd) return false;
+                if (*mCur == 'u') {
+                    if (mEnd - mCur < 5) return false;
+                    std::string hex(mCur + 1, 4);
+                    char* hexEnd = nullptr;
+                    auto code = strtoul(hex.c_str(), &hexEnd, 16);
+                    if (hexEnd != hex.c_str() + 4 || code > 0xff) return false;
+                    *outString += (char)code;
+                    mCur += 5;
+                    continue;
+                }
+            }
+            *outString += *mCur++;
+        }
+        return mCur++ < mEnd;
+    }
+
+    bool ParseValue(JsonValue* outValue)
+    {
+        SkipSpace();
+        if (mCur == mEnd) return false;
+
+        if (*mCur == '{') {
+            outValue->type = JsonValue::JSON_OBJECT;
+            ++mCur;
+            SkipSpace();
+            if (mCur < mEnd && *mCur == '}') return ++mCur, true;
+            for (;;) {
+                std::pair<std::string, JsonValue> member;
+                SkipSpace();
+                if (mCur == mEnd || !ParseString(&member.first)) return false;
+                SkipSpace();
+                if (!Match(":") || !ParseValue(&member.second)) return false;
+                outValue->object.push_back(std::move(member));
+                SkipSpace();
+                if (Match("}")) return true;
+                if (!Match(",")) return false;
+            }
+        } else if (*mCur == '[') {
+            outValue->type = JsonValue::JSON_ARRAY;
+            ++mCur;
+            SkipSpace();
+            if (mCur < mEnd && *mCur == ']') return ++mCur, true;
+            for (;;) {
+                outValue->array.emplace_back();
+                if (!ParseValue(&outValue->array.back())) return false;
+                SkipSpace();
+                if (Match("]")) return true;
+                if (!Match(",")) return false;
+            }
+        } else if (*mCur == '"') {
+            outValue->type = JsonValue::JSON_STRING;
+            return ParseString(&outValue->string);
+        } else if (Match("true")) {
+            outValue->type = JsonValue::JSON_BOOL;
+            outValue->number = 1.0;
+            return true;
+        } else if (Match("false")) {
+            outValue->type = JsonValue::JSON_BOOL;
+            return true;
+        } else if (Match("null")) {
+            return true;
+        }
+
+        char* end = nullptr;
+        outValue->type = JsonValue::JSON_NUMBER;
+        outValue->number = strtod(mCur, &end);
+        if (end == mCur || end > mEnd) return false;
+        mCur = end;
+        return true;
+    }
+
+    const char* mCur;
+    const char* mEnd;
+};
+
+bool LoadResults(const std::string& fileName, JsonValue* outResults)
+{
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file) {
+        fprintf(stderr, "error: failed to open '%s'\n", fileName.c_str());
+        return false;
+    }
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    JsonParser parser(text);
+    if (!parser.Parse(outResults) || outResults->type != JsonValue::JSON_OBJECT ||
+        !outResults->Find("distributions")) {
+        fprintf(stderr, "error: '%s' is not a benchmark results file\n", fileName.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::vector<double> Samples(const JsonValue& distribution)
+{
+    std::vector<double> samples;
+    auto array = distribution.Find("samples_ms");
+    if (array) {
+        for (auto& s : array->array) samples.push_back(s.number);
+    }
+    return samples;
+}
+
+// Reorders samples
+double Median(std::vector<double>& samples)
+{
+    auto middle = samples.begin() + samples.size() / 2;
+    std::nth_element(samples.begin(), middle, samples.end());
+    return *middle;
+}
+
+// Two-sided p-value, normal approximation with tie and continuity corrections
+double MannWhitneyP(const std::vector<double>& a, const std::vector<double>& b)
+{
+    std::vector<std::pair<double, int>> all;
+    all.reserve(a.size() + b.size());
+    for (auto s : a) all.emplace_back(s, 0);
+    for (auto s : b) all.emplace_back(s, 1);
+    std::sort(all.begin(), all.end());
+
+    double n1 = double(a.size());
+    double n2 = double(b.size());
+    double n = n1 + n2;
+    double rankSumA = 0.0;
+    double tieTerm = 0.0;
+    for (size_t i = 0; i < all.size();) {
+        size_t j = i;
+        while (j < all.size() && all[j].first == all[i].first) ++j;
+        double rank = 0.5 * double(i + j + 1); // Average of the 1-based ranks i+1 .. j
+        for (size_t k = i; k < j; ++k) {
+            if (all[k].second == 0) rankSumA += rank;
+        }
+        double t = double(j - i);
+        tieTerm += t * t * t - t;
+        i = j;
+    }
+
+    double u = rankSumA - 0.5 * n1 * (n1 + 1.0);
+    double variance = n1 * n2 / 12.0 * ((n + 1.0) - tieTerm / (n * (n - 1.0)));
+    if (variance <= 0.0) return 1.0; // All equal
+    double z = std::max(0.0, std::abs(u - 0.5 * n1 * n2) - 0.5) / std::sqrt(variance);
+    return std::erfc(z / std::sqrt(2.0));
+}
+
+// Percentile interval of the relative change of the median, (candidate / baseline - 1)
+void BootstrapMedianChange(const std::vector<double>& baseline, const std::vector<double>& candidate,
+                           double* outLow, double* outHigh)
+{
+    std::mt19937 rng(1337); // Deterministic, so reruns of a comparison agree
+    std::vector<double> changes;
+    std::vector<double> resample;
+    for (int r = 0; r < BOOTSTRAP_RESAMPLES; ++r) {
+        double medians[2];
+        const std::vector<double>* sets[2] = { &baseline, &candidate };
+        for (int s = 0; s < 2; ++s) {
+            std::uniform_int_distribution<size_t> pick(0, sets[s]->size() - 1);
+            resample.resize(sets[s]->size());
+            for (auto& x : resample) x = (*sets[s])[pick(rng)];
+            medians[s] = Median(resample);
+        }
+        if (medians[0] > 0.0) changes.push_back(medians[1] / medians[0] - 1.0);
+    }
+    if (changes.empty()) {
+        *outLow = *outHigh = 0.0;
+        return;
+    }
+
+    std::sort(changes.begin(), changes.end());
+    double tail = 0.5 * (1.0 - CONFIDENCE);
+    *outLow = changes[size_t(tail * (changes.size() - 1))];
+    *outHigh = changes[size_t((1.0 - tail) * (changes.size() - 1))];
+}
+
+// Warns about each scalar member of the given section that differs between the runs
+void CompareSection(const JsonValue& baseline, const JsonValue& candidate, const char* section)
+{
+    auto a = baseline.Find(section);
+    auto b = candidate.Find(section);
+    if (!a || !b) return;
+    for (auto& member : a->object) {
+        auto other = b->Find(member.first.c_str());
+        auto text = member.second.Text();
+        auto otherText = other ? other->Text() : std::string("(missing)");
+        if (text != otherText) {
+            fprintf(stderr, "warning: %s.%s differs: '%s' vs '%s'\n", section, member.first.c_str(),
+                    text.c_str(), otherText.c_str());
+        }
+    }
+}
+
+} // namespace
+
+
+BenchmarkRecorder::BenchmarkRecorder()
+{
+    ProfileStageTotals(mLastStageTotals);
+}
+
+
+void BenchmarkRecorder::AddFrame(double frameTime)
+{
+    double stageTotals[PROFILE_STAGE_COUNT];
+    ProfileStageTotals(stageTotals);
+
+    if (++mFrameCount > WARMUP_FRAMES) {
+        mFrameTimes.push_back(float(1000.0 * frameTime));
+        for (int s = 0; s < PROFILE_STAGE_COUNT; ++s) {
+            mStageTimes[s].push_back(float(1000.0 * (stageTotals[s] - mLastStageTotals[s])));
+        }
+    }
+    std::copy(stageTotals, stageTotals + PROFILE_STAGE_COUNT, mLastStageTotals);
+}
+
+
+HRESULT BenchmarkRecorder::Write(const std::string& fileName, const Settings& settings,
+                                 const std::string& adapterName) const
+{
+    SYSTEM_INFO systemInfo = {};
+    GetSystemInfo(&systemInfo);
+    MEMORYSTATUSEX memoryStatus = {};
+    memoryStatus.dwLength = sizeof(memoryStatus);
+    GlobalMemoryStatusEx(&memoryStatus);
+
+    std::ofstream file(fileName);
+    if (!file) return E_FAIL;
+
+    file << "{" << std::endl;
+    file << "  \"format\": \"asteroids_benchmark\"," << std::endl;
+    file << "  \"version\": 1," << std::endl;
+    file << "  \"machine\": {" << std::endl;
+    file << "    \"cpu\": \"" << JsonEscape(CPUBrand()) << "\"," << std::endl;
+    file << "    \"logical_processors\": " << systemInfo.dwNumberOfProcessors << "," << std::endl;
+    file << "    \"memory_mb\": " << (memoryStatus.ullTotalPhys >> 20) << "," << std::endl;
+    file << "    \"adapter\": \"" << JsonEscape(adapterName) << "\"" << std::endl;
+    file << "  }," << std::endl;
+    file << "  \"build\": {" << std::endl;
+    file << "    \"id\": \"" << JsonEscape(BuildId()) << "\"," << std::endl;
+#if defined(_DEBUG)
+    file << "    \"configuration\": \"Debug\"," << std::endl;
+#else
+    file << "    \"configuration\": \"Release\"," << std::endl;
+#endif
+    file << "    \"compiler\": " << _MSC_FULL_VER << std::endl;
+    file << "  }," << std::endl;
+    file << "  \"settings\": {" << std::endl;
+    file << "    \"api\": \"" << (settings.d3d12 ? "d3d12" : "d3d11") << "\"," << std::endl;
+    file << "    \"warp\": " << (settings.warp ? "true" : "false") << "," << std::endl;
+    file << "    \"seconds\": " << settings.closeAfterSeconds << "," << std::endl;
+    file << "    \"render_width\": " << settings.renderWidth << "," << std::endl;
+    file << "    \"render_height\": " << settings.renderHeight << "," << std::endl;
+    file << "    \"vsync\": " << (settings.vsync ? "true" : "false") << "," << std::endl;
+    file << "    \"locked_fps\": " << (settings.lockFrameRate ? settings.lockedFrameRate : 0) << "," << std::endl;
+    file << "    \"target_fps\": " << settings.targetFrameRate << "," << std::endl;
+    file << "    \"asteroids\": " << NUM_ASTEROIDS << "," << std::endl;
+    file << "    \"multithreaded_rendering\": " << (settings.multithreadedRendering ? "true" : "false") << "," << std::endl;
+    file << "    \"execute_indirect\": " << (settings.executeIndirect ? "true" : "false") << "," << std::endl;
+    file << "    \"triangle_budget\": " << settings.triangleBudget << "," << std::endl;
+    file << "    \"incremental_lod\": " << (settings.incrementalLOD ? "true" : "false") << "," << std::endl;
+    file << "    \"mesh_baked_noise_tolerance\": " << settings.meshBakedNoiseTolerance << "," << std::endl;
+    file << "    \"texture_pool\": " << settings.texturePoolSize << std::endl;
+    file << "  }," << std::endl;
+    file << "  \"warmup_frames\": " << WARMUP_FRAMES << "," << std::endl;
+    file << "  \"distributions\": {" << std::endl;
+    file << std::fixed << std::setprecision(4);
+    WriteDistribution(file, "FrameTime", mFrameTimes, false);
+    for (int s = 0; s < PROFILE_STAGE_COUNT; ++s) {
+        WriteDistribution(file, ProfileStageName((ProfileStage)s), mStageTimes[s], s + 1 == PROFILE_STAGE_COUNT);
+    }
+    file << "  }" << std::endl;
+    file << "}" << std::endl;
+
+    return file ? S_OK : E_FAIL;
+}
+
+
+std::string BenchmarkAdapterName(IDXGIFactory1* factory, IDXGIAdapter1* adapter)
+{
+    if (adapter) {
+        adapter->AddRef();
+    } else if (FAILED(factory->EnumAdapters1(0, &adapter))) {
+        return "unknown";
+    }
+
+    DXGI_ADAPTER_DESC1 desc = {};
+    char name[sizeof(desc.Description)] = "unknown";
+    if (SUCCEEDED(adapter->GetDesc1(&desc))) {
+        WideCharToMultiByte(CP_UTF8, 0, desc.Description, -1, name, sizeof(name), NULL, NULL);
+    }
+    adapter->Release();
+    return name;
+}
+
+
+int RunBenchmarkComparison(const std::string& baselineFileName, const std::string& candidateFileName,
+                           double thresholdPercent)
+{
+    JsonValue baseline, candidate;
+    if (!LoadResults(baselineFileName, &baseline) || !LoadResults(candidateFileName, &candidate)) {
+        return -1;
+    }
+
+    // Comparable only on the same machine and settings; still compare, but say so
+    CompareSection(baseline, candidate, "machine");
+    CompareSection(baseline, candidate, "settings");
+    auto baselineBuild = baseline.Find("build");
+    auto candidateBuild = candidate.Find("build");
+    auto buildId = [](const JsonValue* build) {
+        auto id = build ? build->Find("id") : nullptr;
+        return id ? id->Text() : std::string("unknown");
+    };
+
+    std::cout << "Baseline:  " << baselineFileName << " (build " << buildId(baselineBuild) << ")" << std::endl;
+    std::cout << "Candidate: " << candidateFileName << " (build " << buildId(candidateBuild) << ")" << std::endl;
+    std::cout << "Regression: median change " << int(100.0 * CONFIDENCE) << "% CI above +" << thresholdPercent
+              << "% and Mann-Whitney p < " << SIGNIFICANCE << std::endl << std::endl;
+    std::cout << std::left << std::setw(16) << "Distribution" << std::right
+              << std::setw(12) << "Base p50" << std::setw(12) << "Cand p50" << std::setw(10) << "Change"
+              << std::setw(22) << "CI" << std::setw(11) << "p" << "  Verdict" << std::endl;
+
+    int regressions = 0;
+    int compared = 0;
+    for (auto& distribution : baseline.Find("distributions")->object) {
+        auto other = candidate.Find("distributions")->Find(distribution.first.c_str());
+        if (!other) {
+            fprintf(stderr, "warning: '%s' is missing from the candidate\n", distribution.first.c_str());
+            continue;
+        }
+
+        auto a = Samples(distribution.second);
+        auto b = Samples(*other);
+        if (a.size() < 2 || b.size() < 2) {
+            fprintf(stderr, "warning: too few samples of '%s'\n", distribution.first.c_str());
+            continue;
+        }
+
+        double p = MannWhitneyP(a, b);
+        double low, high;
+        BootstrapMedianChange(a, b, &low, &high);
+        double baseMedian = Median(a);
+        double candidateMedian = Median(b);
+
+        const char* verdict = "";
+        bool negligible = baseMedian < MIN_MEDIAN_MS;
+        if (negligible) {
+            verdict = "negligible";
+        } else if (p < SIGNIFICANCE && 100.0 * low > thresholdPercent) {
+            verdict = "REGRESSION";
+            ++regressions;
+        } else if (p < SIGNIFICANCE && 100.0 * high < -thresholdPercent) {
+            verdict = "improvement";
+        }
+        ++compared;
+
+        std::ostringstream change, interval;
+        change << std::fixed << std::setprecision(1) << std::showpos;
+        interval << std::fixed << std::setprecision(1) << std::showpos;
+        if (negligible) {
+            change << "-";
+            interval << "-";
+        } else {
+            change << 100.0 * (candidateMedian / baseMedian - 1.0) << "%";
+            interval << "[" << 100.0 * low << "%, " << 100.0 * high << "%]";
+        }
+
+        std::ostringstream row;
+        row << std::left << std::setw(16) << distribution.first << std::right << std::fixed
+            << std::setprecision(3) << std::setw(10) << baseMedian << "ms" << std::setw(10) << candidateMedian
+            << "ms" << std::setw(10) << change.str() << std::setw(22) << interval.str()
+            << std::scientific << std::setprecision(1) << std::setw(11) << p << "  " << verdict;
+        std::cout << row.str() << std::endl;
+    }
+
+    if (compared == 0) {
+        fprintf(stderr, "error: no distributions in common\n");
+        return -1;
+    }
+    std::cout << std::endl << regressions << " regression(s)" << std::endl;
+    return regressions > 0 ? 1 : 0;
+}
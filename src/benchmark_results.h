@@ -0,0 +1,56 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <windows.h>
+#include <dxgi.h>
+
+#include <string>
+#include <vector>
+
+#include "profile.h"
+#include "settings.h"
+
+// Results of a -close_after benchmark run, as JSON: machine fingerprint, build id, settings and the per-frame
+// distributions (after warm-up) of the frame time and of each profile stage (CPU time summed over threads).
+class BenchmarkRecorder
+{
+public:
+    enum { WARMUP_FRAMES = 100 }; // As for the summary CSV
+
+    BenchmarkRecorder();
+
+    // Once per frame, after it has been submitted
+    void AddFrame(double frameTime);
+
+    HRESULT Write(const std::string& fileName, const Settings& settings, const std::string& adapterName) const;
+
+private:
+    UINT64 mFrameCount = 0;
+    double mLastStageTotals[PROFILE_STAGE_COUNT];
+    std::vector<float> mFrameTimes;                      // ms
+    std::vector<float> mStageTimes[PROFILE_STAGE_COUNT]; // ms
+};
+
+// Description of the given adapter, or of the factory's default one if null
+std::string BenchmarkAdapterName(IDXGIFactory1* factory, IDXGIAdapter1* adapter);
+
+// Compares each distribution of two result files. One regresses when the bootstrap confidence interval of the
+// relative change in its median lies entirely above thresholdPercent and a Mann-Whitney U test rejects equal
+// distributions. Returns 1 if anything regressed, 0 if not and -1 if the files can't be compared.
+int RunBenchmarkComparison(const std::string& baselineFileName, const std::string& candidateFileName,
+                           double thresholdPercent);
@@ -22,6 +22,31 @@
 using namespace DirectX;
 
 
+void XM_CALLCONV ViewFrustum::Set(FXMMATRIX viewProjection)
+{
+    // Row vectors, so clip = p * M: each clip coordinate is a dot product with a column of M.
+    // -w <= x, y <= w and w >= 0; depth is reversed, so the near/far planes are left out.
+    auto columns = XMMatrixTranspose(viewProjection);
+    planes[0] = XMVectorAdd(columns.r[3], columns.r[0]);
+    planes[1] = XMVectorSubtract(columns.r[3], columns.r[0]);
+    planes[2] = XMVectorAdd(columns.r[3], columns.r[1]);
+    planes[3] = XMVectorSubtract(columns.r[3], columns.r[1]);
+    planes[4] = columns.r[3];
+    for (auto& plane : planes) {
+        plane = XMPlaneNormalize(plane);
+    }
+}
+
+
+bool XM_CALLCONV ViewFrustum::SphereVisible(FXMVECTOR center, float radius) const
+{
+    for (auto& plane : planes) {
+        if (XMVectorGetX(XMPlaneDotCoord(plane, center)) < -radius) return false;
+    }
+    return true;
+}
+
+
 OrbitCamera::OrbitCamera()
 {
     // Defaults
@@ -96,6 +121,7 @@ void OrbitCamera::UpdateData()
 
     mView = XMMatrixLookAtRH(mEye, mCenter, mUp);
     mViewProjection = XMMatrixMultiply(mView, mProjection);
+    mFrustum.Set(mViewProjection);
 }
 
 
@@ -19,6 +19,16 @@
 #include <DirectXMath.h>
 #include <interactioncontext.h>
 
+// Side planes of a view frustum plus the plane through the eye, for conservative sphere tests.
+// Planes are normalized with inward normals: dot(xyz, p) + w >= 0 inside.
+struct ViewFrustum
+{
+    DirectX::XMVECTOR planes[5];
+
+    void XM_CALLCONV Set(DirectX::FXMMATRIX viewProjection);
+    bool XM_CALLCONV SphereVisible(DirectX::FXMVECTOR center, float radius) const;
+};
+
 class OrbitCamera
 {
 public:
@@ -34,6 +44,9 @@ public:
 
     DirectX::XMVECTOR const& Eye() const { return mEye; }
     DirectX::XMMATRIX const& ViewProjection() const { return mViewProjection; }
+    ViewFrustum const& Frustum() const { return mFrustum; }
+    // cot(fovY / 2)
+    float ProjectionScaleY() const { return DirectX::XMVectorGetY(mProjection.r[1]); }
 
     void AddPointer(UINT pointerId);
     void ProcessPointerFrames(UINT pointerId, const POINTER_INFO* pointerInfo);
@@ -63,6 +76,7 @@ private:
     DirectX::XMMATRIX mView;
     DirectX::XMMATRIX mProjection;
     DirectX::XMMATRIX mViewProjection;
+    ViewFrustum mFrustum;
 
     HINTERACTIONCONTEXT mInteractionContext;
 };
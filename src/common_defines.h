@@ -19,4 +19,9 @@
 
 #define NUM_UNIQUE_TEXTURES 10
 
+// Shader texture slots after the unique textures, backed by the procedural texture pool (see texture_pool.h).
+// Total is kept within the 128 SRVs resource binding tier 1 allows in a table.
+#define NUM_TEXTURE_POOL_SLOTS 118
+#define NUM_TEXTURE_SLOTS (NUM_UNIQUE_TEXTURES + NUM_TEXTURE_POOL_SLOTS)
+
 #endif
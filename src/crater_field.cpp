@@ -0,0 +1,232 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "crater_field.h"
+#include "mesh.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <ppl.h>
+
+using namespace DirectX;
+
+namespace {
+
+// Profile in units of the crater radius: the bowl rises to the rim height at the radius, then the rim falls
+// off to nothing at RIM_REACH radii
+const float RIM_HEIGHT = 0.2f; // Relative to the depth
+const float RIM_REACH = 1.6f;
+
+// Bounding cap of each grid cell: center direction and angular radius
+struct BucketCap
+{
+    float x, y, z;
+    float radius, cosRadius, sinRadius;
+};
+
+void FaceDirection(unsigned int face, float u, float v, float* outDirection)
+{
+    // Major axis +x, -x, +y, -y, +z, -z; (u, v) in [-1, 1] on the face
+    float d[3];
+    auto axis = face / 2;
+    d[axis] = face & 1 ? -1.0f : 1.0f;
+    d[(axis + 1) % 3] = u;
+    d[(axis + 2) % 3] = v;
+    auto length = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    for (int i = 0; i < 3; ++i) outDirection[i] = d[i] / length;
+}
+
+const std::vector<BucketCap>& BucketCaps()
+{
+    static const std::vector<BucketCap> caps = []() {
+        std::vector<BucketCap> caps(CraterField::BUCKET_COUNT);
+        for (unsigned int face = 0; face < 6; ++face) {
+            for (unsigned int j = 0; j < CraterField::GRID; ++j) {
+                for (unsigned int i = 0; i < CraterField::GRID; ++i) {
+                    auto cell = 2.0f / CraterField::GRID;
+                    auto u0 = -1.0f + i * cell;
+                    auto v0 = -1.0f + j * cell;
+                    auto& cap = caps[(face * CraterField::GRID + j) * CraterField::GRID + i];
+
+                    float center[3];
+                    FaceDirection(face, u0 + 0.5f * cell, v0 + 0.5f * cell, center);
+                    cap.x = center[0];
+                    cap.y = center[1];
+                    cap.z = center[2];
+
+                    // Cell edges are great circle arcs, so the farthest point is a corner
+                    cap.cosRadius = 1.0f;
+                    for (int c = 0; c < 4; ++c) {
+                        float corner[3];
+                        FaceDirection(face, u0 + (c & 1) * cell, v0 + (c >> 1) * cell, corner);
+                        cap.cosRadius = std::min(cap.cosRadius,
+                                                 corner[0] * cap.x + corner[1] * cap.y + corner[2] * cap.z);
+                    }
+                    cap.cosRadius = std::max(-1.0f, cap.cosRadius - 1e-4f); // Conservative
+                    cap.radius = std::acos(cap.cosRadius);
+                    cap.sinRadius = std::sqrt(1.0f - cap.cosRadius * cap.cosRadius);
+                }
+            }
+        }
+        return caps;
+    }();
+    return caps;
+}
+
+} // namespace
+
+
+CraterField::CraterField(unsigned int count, float minRadius, float maxRadius, float depth, unsigned int seed)
+    : mCount(count)
+{
+    assert(minRadius > 0.0f && minRadius <= maxRadius);
+
+    struct Crater
+    {
+        float x, y, z;
+        float radius;
+        float reach, cosReach, sinReach;
+    };
+    std::vector<Crater> craters(count);
+
+    // Mixed with a tag so the draws don't correlate with other generators given the same seed
+    std::seed_seq seeds = { seed, 0x43524154U };
+    std::mt19937 rng(seeds);
+    std::normal_distribution<float> directionDist;
+    std::uniform_real_distribution<float> uniformDist(0.0f, 1.0f);
+    auto minOverMax2 = (minRadius / maxRadius) * (minRadius / maxRadius);
+    for (auto& crater : craters) {
+        float x, y, z, length;
+        do {
+            x = directionDist(rng);
+            y = directionDist(rng);
+            z = directionDist(rng);
+            length = std::sqrt(x * x + y * y + z * z);
+        } while (length < 1e-6f);
+        crater.x = x / length;
+        crater.y = y / length;
+        crater.z = z / length;
+
+        // Cumulative count of craters larger than r ~ r^-2
+        crater.radius = minRadius / std::sqrt(1.0f - uniformDist(rng) * (1.0f - minOverMax2));
+        crater.reach = std::min(RIM_REACH * crater.radius, XM_PI);
+        crater.cosReach = std::cos(crater.reach);
+        crater.sinReach = std::sin(crater.reach);
+    }
+
+    // Bucket: a crater goes into every cell whose cap overlaps its reach, i.e. whose center is within the
+    // sum of the two angles; cos(a + b) = cos a cos b - sin a sin b
+    auto& caps = BucketCaps();
+    mBucketStart.resize(BUCKET_COUNT + 1);
+    for (unsigned int b = 0; b < BUCKET_COUNT; ++b) {
+        mBucketStart[b] = (unsigned int)mX.size();
+        auto& cap = caps[b];
+        for (auto& crater : craters) {
+            auto cosAngle = crater.x * cap.x + crater.y * cap.y + crater.z * cap.z;
+            auto cosSum = crater.cosReach * cap.cosRadius - crater.sinReach * cap.sinRadius;
+            if (crater.reach + cap.radius >= XM_PI || cosAngle >= cosSum) {
+                mX.push_back(crater.x);
+                mY.push_back(crater.y);
+                mZ.push_back(crater.z);
+                mCosReach.push_back(crater.cosReach);
+                mInvOneMinusCos.push_back(1.0f / (1.0f - std::cos(crater.radius)));
+                mDepth.push_back(depth * crater.radius);
+            }
+        }
+        while (mX.size() & 3) {
+            mX.push_back(0.0f);
+            mY.push_back(0.0f);
+            mZ.push_back(0.0f);
+            mCosReach.push_back(2.0f); // Never reached
+            mInvOneMinusCos.push_back(0.0f);
+            mDepth.push_back(0.0f);
+        }
+    }
+    mBucketStart[BUCKET_COUNT] = (unsigned int)mX.size();
+}
+
+
+unsigned int CraterField::Bucket(float x, float y, float z)
+{
+    // As FaceDirection: the major axis picks the face, the other two (in order) the cell
+    float d[3] = { x, y, z };
+    float a[3] = { std::abs(x), std::abs(y), std::abs(z) };
+    unsigned int axis = a[0] >= a[1] ? (a[0] >= a[2] ? 0 : 2) : (a[1] >= a[2] ? 1 : 2);
+    unsigned int face = 2 * axis + (d[axis] < 0.0f ? 1 : 0);
+    auto u = d[(axis + 1) % 3] / a[axis];
+    auto v = d[(axis + 2) % 3] / a[axis];
+    auto i = std::min((unsigned int)((u + 1.0f) * (0.5f * GRID)), (unsigned int)GRID - 1);
+    auto j = std::min((unsigned int)((v + 1.0f) * (0.5f * GRID)), (unsigned int)GRID - 1);
+    return (face * GRID + j) * GRID + i;
+}
+
+
+float CraterField::Height(float x, float y, float z) const
+{
+    auto b = Bucket(x, y, z);
+
+    XMVECTOR vx = XMVectorReplicate(x);
+    XMVECTOR vy = XMVectorReplicate(y);
+    XMVECTOR vz = XMVectorReplicate(z);
+    XMVECTOR one = XMVectorReplicate(1.0f);
+    XMVECTOR rimHeight = XMVectorReplicate(RIM_HEIGHT);
+    XMVECTOR rimReach = XMVectorReplicate(RIM_REACH);
+    XMVECTOR invRimWidth = XMVectorReplicate(1.0f / (RIM_REACH - 1.0f));
+
+    XMVECTOR height = XMVectorZero();
+    for (auto c = mBucketStart[b]; c < mBucketStart[b + 1]; c += 4) {
+        XMVECTOR cosAngle = XMVectorMultiply(vx, XMLoadFloat4((const XMFLOAT4*)&mX[c]));
+        cosAngle = XMVectorMultiplyAdd(vy, XMLoadFloat4((const XMFLOAT4*)&mY[c]), cosAngle);
+        cosAngle = XMVectorMultiplyAdd(vz, XMLoadFloat4((const XMFLOAT4*)&mZ[c]), cosAngle);
+        XMVECTOR reached = XMVectorGreater(cosAngle, XMLoadFloat4((const XMFLOAT4*)&mCosReach[c]));
+        if (XMVector4EqualInt(reached, XMVectorFalseInt())) continue;
+
+        XMVECTOR t2 = XMVectorMultiply(XMVectorSubtract(one, cosAngle),
+                                       XMLoadFloat4((const XMFLOAT4*)&mInvOneMinusCos[c]));
+        XMVECTOR depth = XMLoadFloat4((const XMFLOAT4*)&mDepth[c]);
+
+        // Bowl: depth * (t^2 - 1 + RIM_HEIGHT); rim: RIM_HEIGHT * depth * s^2, s falling from 1 to 0 over the rim
+        XMVECTOR bowl = XMVectorMultiply(depth, XMVectorAdd(XMVectorSubtract(t2, one), rimHeight));
+        XMVECTOR s = XMVectorSaturate(XMVectorMultiply(XMVectorSubtract(rimReach, XMVectorSqrt(t2)), invRimWidth));
+        XMVECTOR rim = XMVectorMultiply(XMVectorMultiply(depth, rimHeight), XMVectorMultiply(s, s));
+
+        XMVECTOR profile = XMVectorSelect(rim, bowl, XMVectorLess(t2, one));
+        height = XMVectorAdd(height, XMVectorAndInt(profile, reached));
+    }
+
+    XMFLOAT4A lanes;
+    XMStoreFloat4A(&lanes, height);
+    return lanes.x + lanes.y + lanes.z + lanes.w;
+}
+
+
+void CraterField::Stamp(Vertex* vertices, const Vertex* directions, size_t count) const
+{
+    auto blockCount = (count + VERTEX_BLOCK - 1) / VERTEX_BLOCK;
+    concurrency::parallel_for(size_t(0), blockCount, [&](size_t block) {
+        auto end = std::min(count, (block + 1) * VERTEX_BLOCK);
+        for (auto i = block * VERTEX_BLOCK; i < end; ++i) {
+            auto& d = directions[i];
+            auto invLength = 1.0f / std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+            auto scale = 1.0f + Height(d.x * invLength, d.y * invLength, d.z * invLength);
+            vertices[i].x *= scale;
+            vertices[i].y *= scale;
+            vertices[i].z *= scale;
+        }
+    });
+}
@@ -0,0 +1,60 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <windows.h>
+#include <DirectXMath.h>
+#include <vector>
+
+struct Vertex;
+
+// Impact craters on the unit sphere: a bowl with a raised rim, stamped as a radial height offset. Craters are
+// bucketed on a cube map grid over the sphere (each one into every cell its rim reaches), so a vertex only
+// tests the craters of its own cell, four at a time.
+class CraterField
+{
+public:
+    enum { GRID = 8 };           // Cells per cube face edge
+    enum { BUCKET_COUNT = 6 * GRID * GRID };
+    enum { VERTEX_BLOCK = 256 }; // Vertices per parallel task in Stamp
+
+    // Radii are angles (radians); sizes follow a power law between the two, so small craters dominate.
+    // depth is the bowl depth relative to the radius.
+    CraterField(unsigned int count, float minRadius, float maxRadius, float depth, unsigned int seed);
+
+    // Relative height offset at a unit direction; 0 away from any crater
+    float Height(float x, float y, float z) const;
+
+    // Scales each vertex by 1 + Height in the direction of the matching entry of directions (e.g. the
+    // undisplaced geosphere; needn't be unit length). Parallel over blocks of vertices.
+    void Stamp(Vertex* vertices, const Vertex* directions, size_t count) const;
+
+    size_t CraterCount() const { return mCount; }
+
+private:
+    static unsigned int Bucket(float x, float y, float z);
+
+    size_t mCount;
+
+    // Per bucket, craters [mBucketStart[b], mBucketStart[b + 1]), padded to multiples of 4 with craters no
+    // direction reaches; structure of arrays
+    std::vector<unsigned int> mBucketStart;
+    std::vector<float> mX, mY, mZ;
+    std::vector<float> mCosReach;         // Of the rim's outer edge
+    std::vector<float> mInvOneMinusCos;   // 1 / (1 - cos radius): (1 - cos angle) * this ~ (angle / radius)^2
+    std::vector<float> mDepth;
+};
@@ -26,19 +26,20 @@
 class BitmapFont
 {
 public:
-    SpriteVertex* DrawString(const char* str, float x, float y, float viewportWidth, float viewportHeight, SpriteVertex* outVertex) const
+    SpriteVertex* DrawString(const char* str, float x, float y, float viewportWidth, float viewportHeight, SpriteVertex* outVertex,
+                             float scale = 1.0f) const
     {
         for (; *str; ++str) {
             auto codePoint = *str - STB_SOMEFONT_FIRST_CHAR;
             assert(codePoint >= 0 && codePoint < mFontData.size());
             const stb_fontchar* cd = &mFontData[codePoint];
 
-            outVertex[0] = {x + cd->x0, y + cd->y0, cd->s0, cd->t0};
-            outVertex[1] = {x + cd->x1, y + cd->y0, cd->s1, cd->t0};
-            outVertex[2] = {x + cd->x1, y + cd->y1, cd->s1, cd->t1};
+            outVertex[0] = {x + scale * cd->x0, y + scale * cd->y0, cd->s0, cd->t0};
+            outVertex[1] = {x + scale * cd->x1, y + scale * cd->y0, cd->s1, cd->t0};
+            outVertex[2] = {x + scale * cd->x1, y + scale * cd->y1, cd->s1, cd->t1};
             outVertex[3] = outVertex[0];
             outVertex[4] = outVertex[2];
-            outVertex[5] = {x + cd->x0, y + cd->y1, cd->s0, cd->t1};
+            outVertex[5] = {x + scale * cd->x0, y + scale * cd->y1, cd->s0, cd->t1};
 
             for (int i = 0; i < 6; ++i) {
                 outVertex[i].x =  (outVertex[i].x / viewportWidth  * 2.0f - 1.0f);
@@ -46,13 +47,13 @@ public:
             }
 
             outVertex += 6;
-            x += cd->advance_int;
+            x += scale * cd->advance_int;
         }
 
         return outVertex;
     }
 
-    void GetDimensions(const char* str, int* width, int* height) const
+    void GetDimensions(const char* str, int* width, int* height, float scale = 1.0f) const
     {
         UINT w = 0;
         for (; *str; ++str) {
@@ -62,8 +63,8 @@ public:
             w += cd->advance_int;
         }
 
-        *width = w;
-        *height = FontHeight();
+        *width = int(scale * w);
+        *height = int(scale * FontHeight());
     }
 
     int BitmapWidth() const { return mBitmapWidth; }
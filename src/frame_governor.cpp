@@ -0,0 +1,104 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "frame_governor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Fractions of the quality range below which each knob starts being traded away (highest first)
+const double LOD_BIAS_QUALITY = 1.0;
+const double DRAW_BUDGET_QUALITY = 2.0 / 3.0;
+const double RENDER_SCALE_QUALITY = 1.0 / 3.0;
+const double QUALITY_SPAN = 1.0 / 3.0;
+
+// 1 => knob at full quality, 0 => fully traded away
+double KnobLevel(double quality, double start)
+{
+    return std::min(1.0, std::max(0.0, (quality - (start - QUALITY_SPAN)) / QUALITY_SPAN));
+}
+
+// Steps are counted from the full quality value. Only moves once the target is a whole step away, and then
+// only by whole steps towards it, so noise in the quality level around a step boundary doesn't flip it back
+// and forth.
+double Quantize(double current, double target, double step, double fullQuality)
+{
+    double steps = std::floor(std::abs(target - current) / step);
+    if (steps < 1.0) return current;
+    double next = current + std::copysign(steps * step, target - current);
+    return fullQuality - std::round((fullQuality - next) / step) * step;
+}
+
+} // namespace
+
+
+FrameGovernor::FrameGovernor(const Config& config)
+    : mConfig(config)
+{
+    mDecision.renderScale = mConfig.maxRenderScale;
+    mDecision.lodBias = 0.0f;
+    mDecision.drawBudget = mConfig.maxDrawBudget;
+}
+
+
+bool FrameGovernor::Update(double frameTime)
+{
+    if (frameTime <= 0.0) return false;
+    mTime += frameTime;
+
+    mSmoothedFrameTime = mSmoothedFrameTime == 0.0 ? frameTime :
+        mConfig.smoothing * frameTime + (1.0 - mConfig.smoothing) * mSmoothedFrameTime;
+
+    double error = (mSmoothedFrameTime - mConfig.targetFrameTime) / mConfig.targetFrameTime;
+    if (std::abs(error) < mConfig.deadBand) {
+        error = 0.0;
+    } else {
+        error -= std::copysign(mConfig.deadBand, error);
+    }
+
+    // Clamping the integral to what the output can use avoids windup while pinned at either end
+    mIntegral = std::min(std::max(mIntegral + error * frameTime, 0.0), 1.0 / mConfig.ki);
+    double derivative = (error - mLastError) / frameTime;
+    mLastError = error;
+
+    double output = mConfig.kp * error + mConfig.ki * mIntegral + mConfig.kd * derivative;
+    mQuality = std::min(1.0, std::max(0.0, 1.0 - output));
+
+    Decision d = mDecision;
+
+    double lodLevel = KnobLevel(mQuality, LOD_BIAS_QUALITY);
+    d.lodBias = (float)Quantize(d.lodBias, (1.0 - lodLevel) * mConfig.maxLODBias, mConfig.lodBiasStep, 0.0);
+
+    double drawLevel = KnobLevel(mQuality, DRAW_BUDGET_QUALITY);
+    double drawBudget = mConfig.minDrawBudget + drawLevel * (mConfig.maxDrawBudget - mConfig.minDrawBudget);
+    d.drawBudget = (unsigned int)Quantize(d.drawBudget, drawBudget, mConfig.drawBudgetStep, mConfig.maxDrawBudget);
+    d.drawBudget = std::min(std::max(d.drawBudget, mConfig.minDrawBudget), mConfig.maxDrawBudget);
+
+    if (mTime - mLastResizeTime >= mConfig.minResizeInterval) {
+        double scaleLevel = KnobLevel(mQuality, RENDER_SCALE_QUALITY);
+        double scale = mConfig.minRenderScale + scaleLevel * (mConfig.maxRenderScale - mConfig.minRenderScale);
+        d.renderScale = Quantize(d.renderScale, scale, mConfig.renderScaleStep, mConfig.maxRenderScale);
+        d.renderScale = std::min(std::max(d.renderScale, mConfig.minRenderScale), mConfig.maxRenderScale);
+        if (d.renderScale != mDecision.renderScale) mLastResizeTime = mTime;
+    }
+
+    bool changed = d.renderScale != mDecision.renderScale || d.lodBias != mDecision.lodBias ||
+                   d.drawBudget != mDecision.drawBudget;
+    mDecision = d;
+    return changed;
+}
@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// Closed-loop frame time governor. A PID controller turns the (smoothed) frame time error against a target into a
+// single quality level, which is then spent in order on mesh LOD bias, the number of asteroids drawn and finally
+// render resolution. A dead band around the target and per-knob hysteresis keep it from oscillating.
+class FrameGovernor
+{
+public:
+    struct Config
+    {
+        double targetFrameTime = 1.0 / 60.0;
+        double deadBand = 0.05;           // Relative frame time error treated as on target
+        double smoothing = 0.1;           // Exponential moving average weight of each new frame time
+        double kp = 0.2;                  // Gains act on relative error and produce quality [0, 1]; ki per second
+        double ki = 0.5;
+        double kd = 0.005;
+
+        double maxRenderScale = 1.0;      // Starting render scale
+        double minRenderScale = 0.5;
+        double renderScaleStep = 0.05;    // Resizes the swap chain, so coarse...
+        double minResizeInterval = 1.0;   // ...and rate limited (seconds)
+
+        float maxLODBias = 2.0f;          // Subdivision levels
+        float lodBiasStep = 0.25f;
+
+        unsigned int maxDrawBudget = 0;
+        unsigned int minDrawBudget = 0;
+        unsigned int drawBudgetStep = 1000;
+    };
+
+    struct Decision
+    {
+        double renderScale;
+        float lodBias;
+        unsigned int drawBudget;
+    };
+
+    explicit FrameGovernor(const Config& config);
+
+    // Once per frame with the last frame's time. Returns true if the decision changed.
+    bool Update(double frameTime);
+
+    const Decision& Current() const { return mDecision; }
+    double Quality() const { return mQuality; }
+    double SmoothedFrameTime() const { return mSmoothedFrameTime; }
+
+private:
+    Config mConfig;
+    Decision mDecision;
+
+    double mSmoothedFrameTime = 0.0;
+    double mIntegral = 0.0;
+    double mLastError = 0.0;
+    double mQuality = 1.0;
+    double mTime = 0.0;
+    double mLastResizeTime = 0.0;
+};
@@ -0,0 +1,131 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "frame_pacer.h"
+#include "waitable_timer.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+const size_t MAX_ERROR_SAMPLES = 1 << 20;
+}
+
+FramePacer::FramePacer(double frameRate)
+{
+    QueryPerformanceFrequency((LARGE_INTEGER*)&mPerfCounterFreq);
+
+    mTimer = CreateWaitableTimerWithFallback(&mHighResolutionTimer);
+
+    mMinSpinMarginCount = mPerfCounterFreq / 20000; // 50us
+    mErrors.reserve(4096);
+    SetFrameRate(frameRate);
+}
+
+
+void FramePacer::SetFrameRate(double frameRate)
+{
+    mFrameRate = frameRate;
+    mPeriodCount = (UINT64)(mPerfCounterFreq / std::max(frameRate, 1.0));
+    mNextDeadline = 0;
+
+    // Starting margin; adapted to the observed wake-up latency
+    mSpinMarginCount = mPerfCounterFreq / (mHighResolutionTimer ? 1000 : 500);
+    mErrors.clear();
+}
+
+
+FramePacer::~FramePacer()
+{
+    if (mTimer) CloseHandle(mTimer);
+}
+
+
+UINT64 FramePacer::Now() const
+{
+    UINT64 count;
+    QueryPerformanceCounter((LARGE_INTEGER*)&count);
+    return count;
+}
+
+
+void FramePacer::Wait()
+{
+    auto now = Now();
+    if (mNextDeadline == 0 || now > mNextDeadline + mPeriodCount) {
+        mNextDeadline = now + mPeriodCount;
+    }
+
+    // Coarse wait
+    if (mTimer && now + mSpinMarginCount < mNextDeadline) {
+        auto wakeCount = mNextDeadline - mSpinMarginCount;
+        LARGE_INTEGER dueTime;
+        dueTime.QuadPart = -(LONGLONG)((wakeCount - now) * 10000000 / mPerfCounterFreq); // Relative, 100ns units
+        if (dueTime.QuadPart < 0 && SetWaitableTimer(mTimer, &dueTime, 0, NULL, NULL, FALSE)) {
+            WaitForSingleObject(mTimer, INFINITE);
+
+            // Track the wake-up latency: jump up to any late wake, decay slowly otherwise
+            auto woke = Now();
+            auto late = woke > wakeCount ? woke - wakeCount : 0;
+            if (late > mSpinMarginCount) {
+                mSpinMarginCount = std::min(late + late / 4, mPeriodCount / 2);
+            } else {
+                mSpinMarginCount -= (mSpinMarginCount - late) / 64;
+            }
+            mSpinMarginCount = std::max(mSpinMarginCount, mMinSpinMarginCount);
+        }
+    }
+
+    // Fine wait
+    do {
+        now = Now();
+        YieldProcessor();
+    } while (now < mNextDeadline);
+
+    if (mErrors.size() < MAX_ERROR_SAMPLES) {
+        mErrors.push_back(float(double(now - mNextDeadline) / mPerfCounterFreq));
+    }
+    mNextDeadline += mPeriodCount;
+}
+
+
+double FramePacer::ErrorPercentile(double p) const
+{
+    if (mErrors.empty()) return 0.0;
+
+    auto sorted = mErrors;
+    auto n = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+    std::nth_element(sorted.begin(), sorted.begin() + n, sorted.end());
+    return sorted[n];
+}
+
+
+void FramePacer::PrintSummary() const
+{
+    // Formatted apart, so std::cout's own format is left alone
+    std::ostringstream summary;
+    summary << "Frame pacing (" << mErrors.size() << " frames, "
+            << (mHighResolutionTimer ? "high resolution timer" : "system timer") << "): error "
+            << std::fixed << std::setprecision(1)
+            << "p50 " << 1e6 * ErrorPercentile(0.5) << " us, "
+            << "p90 " << 1e6 * ErrorPercentile(0.9) << " us, "
+            << "p99 " << 1e6 * ErrorPercentile(0.99) << " us, "
+            << "max " << 1e6 * ErrorPercentile(1.0) << " us; spin margin "
+            << 1e6 * SpinMargin() << " us";
+    std::cout << summary.str() << std::endl;
+}
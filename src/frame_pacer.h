@@ -0,0 +1,60 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <windows.h>
+#include <vector>
+
+// Paces frames to a fixed rate from absolute deadlines, so time spent anywhere in the frame (render, present,
+// fence waits) is accounted for. Waits on a high resolution waitable timer up to a calibrated margin before
+// the deadline and spins for the remainder. Records how late each frame is released.
+class FramePacer
+{
+public:
+    explicit FramePacer(double frameRate);
+    ~FramePacer();
+
+    // Restarts the schedule at the new rate, with the starting spin margin and no recorded errors
+    void SetFrameRate(double frameRate);
+    double FrameRate() const { return mFrameRate; }
+
+    // Blocks until the next deadline. If a deadline has been missed by more than a whole period (or pacing was
+    // off for a while) the schedule restarts from now rather than releasing a burst of frames.
+    void Wait();
+
+    // Pacing error (release time - deadline) in seconds, p in [0, 1]
+    double ErrorPercentile(double p) const;
+    double SpinMargin() const { return double(mSpinMarginCount) / mPerfCounterFreq; }
+    size_t FrameCount() const { return mErrors.size(); }
+
+    void PrintSummary() const;
+
+private:
+    UINT64 Now() const;
+
+    HANDLE mTimer = NULL;
+    bool mHighResolutionTimer = false;
+
+    UINT64 mPerfCounterFreq = 0;
+    double mFrameRate = 0.0;
+    UINT64 mPeriodCount = 0;
+    UINT64 mNextDeadline = 0;
+    UINT64 mSpinMarginCount = 0;
+    UINT64 mMinSpinMarginCount = 0;
+
+    std::vector<float> mErrors;
+};
@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "mesh.h"
+
+// Icosahedron subdivision topology, generated at compile time. No vertex positions are needed to build it:
+// every vertex a subdivision adds is the midpoint of two vertices of the previous level (its parents).
+//
+// Layout matches CreateGeospheres: the vertices of each level back to back (a level repeats the previous
+// level's vertices, then appends its midpoints) and the indices of each level with its vertex offset baked in.
+
+constexpr unsigned int GeosphereLevelVertexCount(unsigned int level) { return 10 * (1U << (2 * level)) + 2; }
+constexpr unsigned int GeosphereLevelIndexCount(unsigned int level) { return 60 * (1U << (2 * level)); }
+
+constexpr unsigned int GeosphereIndexCount(unsigned int subdivLevelCount)
+{
+    return GeosphereLevelIndexCount(subdivLevelCount) + (subdivLevelCount ? GeosphereIndexCount(subdivLevelCount - 1) : 0);
+}
+
+static constexpr IndexType ICOSAHEDRON_INDICES[60] =
+{
+     0,  5, 11,
+     0,  1,  5,
+     0,  7,  1,
+     0, 10,  7,
+     0, 11, 10,
+     1,  9,  5,
+     5,  4, 11,
+    11,  2, 10,
+    10,  6,  7,
+     7,  8,  1,
+     3,  4,  9,
+     3,  2,  4,
+     3,  6,  2,
+     3,  8,  6,
+     3,  9,  8,
+     4,  5,  9,
+     2, 11,  4,
+     6, 10,  2,
+     8,  7,  6,
+     9,  1,  8,
+};
+
+template <unsigned int SubdivLevelCount>
+struct GeosphereTopology
+{
+    static constexpr unsigned int INDEX_COUNT = GeosphereIndexCount(SubdivLevelCount);
+    static constexpr unsigned int MIDPOINT_COUNT = GeosphereLevelVertexCount(SubdivLevelCount) - 12;
+
+    IndexType indices[INDEX_COUNT];
+    IndexType midpointParents[MIDPOINT_COUNT][2]; // Level by level, indexing that level's vertices
+    unsigned int subdivIndexOffsets[SubdivLevelCount + 2];
+};
+
+// Midpoint of each edge seen so far in one subdivision pass, keyed by its lower vertex (which has at
+// most 6 neighbours). Midpoints are numbered in order of first use, same as SubdivideInPlace.
+template <unsigned int VertexCount>
+struct GeosphereEdgeMidpoints
+{
+    IndexType other[VertexCount][6];
+    IndexType midpoint[VertexCount][6];
+    unsigned int count[VertexCount];
+    IndexType nextVertex;
+
+    constexpr IndexType Midpoint(IndexType a, IndexType b, IndexType (*parents)[2], unsigned int* parentCount)
+    {
+        if (a > b) {
+            IndexType t = a; a = b; b = t;
+        }
+        for (unsigned int i = 0; i < count[a]; ++i) {
+            if (other[a][i] == b) return midpoint[a][i];
+        }
+        other[a][count[a]] = b;
+        midpoint[a][count[a]] = nextVertex;
+        ++count[a];
+        parents[*parentCount][0] = a;
+        parents[*parentCount][1] = b;
+        ++*parentCount;
+        return nextVertex++;
+    }
+};
+
+template <unsigned int SubdivLevelCount>
+constexpr GeosphereTopology<SubdivLevelCount> MakeGeosphereTopology()
+{
+    GeosphereTopology<SubdivLevelCount> topology = {};
+
+    // Triangles of the current level, indexing its own vertices
+    IndexType current[GeosphereLevelIndexCount(SubdivLevelCount)] = {};
+    IndexType next[GeosphereLevelIndexCount(SubdivLevelCount)] = {};
+    for (unsigned int i = 0; i < 60; ++i) current[i] = ICOSAHEDRON_INDICES[i];
+
+    unsigned int indexCount = 0;
+    unsigned int vertexOffset = 0;
+    unsigned int parentCount = 0;
+    for (unsigned int level = 0; ; ++level) {
+        topology.subdivIndexOffsets[level] = indexCount;
+        for (unsigned int i = 0; i < GeosphereLevelIndexCount(level); ++i) {
+            topology.indices[indexCount++] = (IndexType)(current[i] + vertexOffset);
+        }
+        vertexOffset += GeosphereLevelVertexCount(level);
+        if (level == SubdivLevelCount) break;
+
+        // 1 face -> 4 faces
+        GeosphereEdgeMidpoints<GeosphereLevelVertexCount(SubdivLevelCount)> edges = {};
+        edges.nextVertex = (IndexType)GeosphereLevelVertexCount(level);
+        for (unsigned int t = 0; t < GeosphereLevelIndexCount(level) / 3; ++t) {
+            IndexType t0 = current[t*3+0];
+            IndexType t1 = current[t*3+1];
+            IndexType t2 = current[t*3+2];
+
+            IndexType m0 = edges.Midpoint(t0, t1, topology.midpointParents, &parentCount);
+            IndexType m1 = edges.Midpoint(t1, t2, topology.midpointParents, &parentCount);
+            IndexType m2 = edges.Midpoint(t2, t0, topology.midpointParents, &parentCount);
+
+            IndexType* n = next + t * 12;
+            n[ 0] = t0; n[ 1] = m0; n[ 2] = m2;
+            n[ 3] = m0; n[ 4] = t1; n[ 5] = m1;
+            n[ 6] = m0; n[ 7] = m1; n[ 8] = m2;
+            n[ 9] = m2; n[10] = m1; n[11] = t2;
+        }
+        for (unsigned int i = 0; i < GeosphereLevelIndexCount(level + 1); ++i) current[i] = next[i];
+    }
+    topology.subdivIndexOffsets[SubdivLevelCount + 1] = indexCount;
+
+    return topology;
+}
@@ -22,6 +22,58 @@
 #include <string>
 
 
+// Generated rather than loaded: one texel per GUIColor, so solid rectangles can be drawn with the sprite pipeline
+#define GUI_PALETTE_TEXTURE "*palette"
+
+inline bool IsGeneratedGUITexture(const std::string& textureFile)
+{
+    return textureFile.length() > 0 && textureFile[0] == '*';
+}
+
+enum GUIColor {
+    GUI_COLOR_PANEL,
+    GUI_COLOR_WHITE,
+    GUI_COLOR_RED,
+    GUI_COLOR_ORANGE,
+    GUI_COLOR_YELLOW,
+    GUI_COLOR_GREEN,
+    GUI_COLOR_CYAN,
+    GUI_COLOR_BLUE,
+    GUI_COLOR_MAGENTA,
+    GUI_COLOR_COUNT
+};
+
+// Premultiplied alpha, B8G8R8A8 (sRGB), GUI_COLOR_COUNT x 1
+inline const unsigned int* GUIPalettePixels()
+{
+    static const unsigned int pixels[GUI_COLOR_COUNT] = {
+        0xB0000000, // Panel
+        0xFFFFFFFF,
+        0xFFE84040,
+        0xFFF09030,
+        0xFFF0E040,
+        0xFF50D050,
+        0xFF40D0E0,
+        0xFF5070F0,
+        0xFFD050D0,
+    };
+    return pixels;
+}
+
+inline SpriteVertex* DrawSolidRect(float x, float y, float width, float height, GUIColor color,
+                                   float viewportWidth, float viewportHeight, SpriteVertex* outVertex)
+{
+    auto end = DrawSprite(x, y, width, height, viewportWidth, viewportHeight, outVertex);
+    // Constant texel center, so filtering doesn't matter
+    float u = (float(color) + 0.5f) / float(GUI_COLOR_COUNT);
+    for (auto v = outVertex; v != end; ++v) {
+        v->u = u;
+        v->v = 0.5f;
+    }
+    return end;
+}
+
+
 class GUIControl
 {
 protected:
@@ -56,16 +108,17 @@ class GUIText : public GUIControl
 private:
     std::string mText;
     const BitmapFont* mFont;
+    float mScale;
 
     void ComputeDimensions()
     {
-        mFont->GetDimensions(mText.c_str(), &mWidth, &mHeight);
+        mFont->GetDimensions(mText.c_str(), &mWidth, &mHeight, mScale);
     }
 
 public:
     // Font lifetime managed by caller
-    GUIText(int x, int y, const BitmapFont* font, const std::string& text)
-        : mFont(font), mText(text)
+    GUIText(int x, int y, const BitmapFont* font, const std::string& text, float scale = 1.0f)
+        : mFont(font), mText(text), mScale(scale)
     {
         mX = x;
         mY = y;
@@ -80,7 +133,7 @@ public:
 
     virtual SpriteVertex* Draw(float viewportWidth, float viewportHeight, SpriteVertex* outVertex) const override
     {
-        return mFont->DrawString(mText.c_str(), float(mX), float(mY), viewportWidth, viewportHeight, outVertex);
+        return mFont->DrawString(mText.c_str(), float(mX), float(mY), viewportWidth, viewportHeight, outVertex, mScale);
     }
 };
 
@@ -127,9 +180,9 @@ public:
     
     const BitmapFont* Font() const { return &mFont; }
 
-    GUIText* AddText(int x, int y, const std::string& text = "")
+    GUIText* AddText(int x, int y, const std::string& text = "", float scale = 1.0f)
     {
-        auto control = new GUIText(x, y, &mFont, text);
+        auto control = new GUIText(x, y, &mFont, text, scale);
         mControls.push_back(control);
         return control;
     }
@@ -141,6 +194,14 @@ public:
         return control;
     }
 
+    // Takes ownership
+    template <typename T>
+    T* AddControl(T* control)
+    {
+        mControls.push_back(control);
+        return control;
+    }
+
     // NOTE: Caller needs to preadjust x/y for any stretching/scaling going on
     GUIControl* HitTest(int x, int y) const
     {
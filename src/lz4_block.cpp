@@ -0,0 +1,194 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "lz4_block.h"
+
+#include <string.h>
+#include <memory>
+
+namespace {
+
+const int MIN_MATCH = 4;
+const int LAST_LITERALS = 5; // Last 5 bytes are always literals
+const int MF_LIMIT = 12;     // Last match must start at least 12 bytes before the end
+const int HASH_LOG = 16;
+const int MAX_OFFSET = 65535;
+
+inline UINT32 Read32(const BYTE* p)
+{
+    UINT32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline UINT32 Hash(UINT32 sequence)
+{
+    return (sequence * 2654435761U) >> (32 - HASH_LOG);
+}
+
+inline BYTE* WriteLength(BYTE* op, size_t length)
+{
+    for (; length >= 255; length -= 255) *op++ = 255;
+    *op++ = (BYTE)length;
+    return op;
+}
+
+// Token + length bytes + literals + offset + match length bytes
+inline size_t SequenceBound(size_t literalLength, size_t matchLength)
+{
+    return 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1;
+}
+
+} // namespace
+
+
+int LZ4BlockCompress(const BYTE* src, int srcSize, BYTE* dst, int dstCapacity)
+{
+    std::unique_ptr<int[]> table(new int[1 << HASH_LOG]);
+    for (int i = 0; i < (1 << HASH_LOG); ++i) table[i] = -1;
+
+    const BYTE* ip = src;
+    const BYTE* anchor = src;
+    const BYTE* iend = src + srcSize;
+    const BYTE* mflimit = iend - MF_LIMIT;
+    const BYTE* matchlimit = iend - LAST_LITERALS;
+    BYTE* op = dst;
+    BYTE* oend = dst + dstCapacity;
+
+    if (srcSize > MF_LIMIT) {
+        while (ip < mflimit) {
+            auto sequence = Read32(ip);
+            auto h = Hash(sequence);
+            int ref = table[h];
+            table[h] = (int)(ip - src);
+
+            if (ref < 0 || (ip - src) - ref > MAX_OFFSET || Read32(src + ref) != sequence) {
+                ++ip;
+                continue;
+            }
+
+            // Extend the match in both directions
+            const BYTE* match = src + ref;
+            while (ip > anchor && match > src && ip[-1] == match[-1]) {
+                --ip;
+                --match;
+            }
+            const BYTE* end = ip + MIN_MATCH;
+            const BYTE* matchEnd = match + MIN_MATCH;
+            while (end < matchlimit && *end == *matchEnd) {
+                ++end;
+                ++matchEnd;
+            }
+
+            size_t literalLength = ip - anchor;
+            size_t matchLength = end - ip - MIN_MATCH;
+            if ((size_t)(oend - op) < SequenceBound(literalLength, matchLength)) {
+                return 0;
+            }
+
+            BYTE* token = op++;
+            *token = (BYTE)((literalLength < 15 ? literalLength : 15) << 4);
+            if (literalLength >= 15) op = WriteLength(op, literalLength - 15);
+            memcpy(op, anchor, literalLength);
+            op += literalLength;
+
+            auto offset = (UINT)(ip - match);
+            *op++ = (BYTE)(offset & 0xFF);
+            *op++ = (BYTE)(offset >> 8);
+
+            *token |= (BYTE)(matchLength < 15 ? matchLength : 15);
+            if (matchLength >= 15) op = WriteLength(op, matchLength - 15);
+
+            ip = end;
+            anchor = ip;
+
+            // Cheap extra insertion improves the ratio on runs
+            table[Hash(Read32(ip - 2))] = (int)(ip - 2 - src);
+        }
+    }
+
+    // Trailing literals
+    size_t literalLength = iend - anchor;
+    if ((size_t)(oend - op) < 1 + literalLength / 255 + 1 + literalLength) {
+        return 0;
+    }
+    BYTE* token = op++;
+    *token = (BYTE)((literalLength < 15 ? literalLength : 15) << 4);
+    if (literalLength >= 15) op = WriteLength(op, literalLength - 15);
+    memcpy(op, anchor, literalLength);
+    op += literalLength;
+
+    return (int)(op - dst);
+}
+
+
+int LZ4BlockDecompress(const BYTE* src, int srcSize, BYTE* dst, int dstCapacity)
+{
+    const BYTE* ip = src;
+    const BYTE* iend = src + srcSize;
+    BYTE* op = dst;
+    BYTE* oend = dst + dstCapacity;
+
+    for (;;) {
+        if (ip >= iend) return -1;
+        UINT token = *ip++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15) {
+            BYTE b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                literalLength += b;
+            } while (b == 255);
+        }
+        if ((size_t)(iend - ip) < literalLength || (size_t)(oend - op) < literalLength) return -1;
+        memcpy(op, ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        // Last sequence has no match
+        if (ip == iend) break;
+
+        if (iend - ip < 2) return -1;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) return -1;
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15) {
+            BYTE b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                matchLength += b;
+            } while (b == 255);
+        }
+        matchLength += MIN_MATCH;
+        if ((size_t)(oend - op) < matchLength) return -1;
+
+        // Overlapping matches replicate the last offset bytes, so they have to be copied forwards bytewise
+        const BYTE* match = op - offset;
+        if (offset >= matchLength) {
+            memcpy(op, match, matchLength);
+            op += matchLength;
+        } else {
+            for (size_t i = 0; i < matchLength; ++i) *op++ = *match++;
+        }
+    }
+
+    return (int)(op - dst);
+}
@@ -0,0 +1,33 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <windows.h>
+
+// Minimal codec for the LZ4 block format (lz4/doc/lz4_Block_format.md). Output is readable by the
+// reference LZ4_decompress_safe and vice versa. The compressor is the simple greedy single-probe variant;
+// it is only run offline when packing assets, decompression is what we care about.
+
+// Worst case compressed size
+inline int LZ4BlockCompressBound(int size) { return size + size / 255 + 16; }
+
+// Returns the compressed size, or 0 if it doesn't fit in dstCapacity
+int LZ4BlockCompress(const BYTE* src, int srcSize, BYTE* dst, int dstCapacity);
+
+// Returns the decompressed size, or -1 if the input is malformed or doesn't fit in dstCapacity.
+// Never reads or writes out of bounds, whatever the input.
+int LZ4BlockDecompress(const BYTE* src, int srcSize, BYTE* dst, int dstCapacity);
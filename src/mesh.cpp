@@ -15,9 +15,16 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "mesh.h"
+#include "crater_field.h"
+#include "geosphere_topology.h"
 #include "noise.h"
+#include "noise_volume.h"
+#include "settings.h"
+#include <algorithm>
+#include <iterator>
 #include <map>
 #include <random>
+#include <ppl.h>
 
 using namespace DirectX;
 
@@ -43,34 +50,10 @@ void CreateIcosahedron(Mesh *outMesh)
         {-a,  0,  b},
     };
 
-    static const size_t num_triangles = 20;
-    static const IndexType indices[num_triangles*3] =
-    {
-         0,  5, 11,
-         0,  1,  5,
-         0,  7,  1,
-         0, 10,  7,
-         0, 11, 10,
-         1,  9,  5,
-         5,  4, 11,
-        11,  2, 10,
-        10,  6,  7,
-         7,  8,  1,
-         3,  4,  9,
-         3,  2,  4,
-         3,  6,  2,
-         3,  8,  6,
-         3,  9,  8,
-         4,  5,  9,
-         2, 11,  4,
-         6, 10,  2,
-         8,  7,  6,
-         9,  1,  8,
-    };
 
     outMesh->clear();
     outMesh->vertices.insert(outMesh->vertices.end(), vertices, vertices + num_vertices);
-    outMesh->indices.insert(outMesh->indices.end(), indices, indices + num_triangles*3);
+    outMesh->indices.insert(outMesh->indices.end(), std::begin(ICOSAHEDRON_INDICES), std::end(ICOSAHEDRON_INDICES));
 }
 
 
@@ -160,121 +143,268 @@ void SpherifyInPlace(Mesh *outMesh, float radius)
 
 void ComputeAvgNormalsInPlace(Mesh *outMesh)
 {
-    for (auto &v : outMesh->vertices) {
-        v.nx = 0.0f;
-        v.ny = 0.0f;
-        v.nz = 0.0f;
-    }
+    ComputeAvgNormalsInPlace(outMesh->vertices.data(), outMesh->vertices.size(),
+                             outMesh->indices.data(), outMesh->indices.size());
+}
 
-    assert(outMesh->indices.size() % 3 == 0); // trilist
-    size_t triangles = outMesh->indices.size() / 3;
-    for (size_t t = 0; t < triangles; ++t)
-    {
-        auto v1 = &outMesh->vertices[outMesh->indices[t*3+0]];
-        auto v2 = &outMesh->vertices[outMesh->indices[t*3+1]];
-        auto v3 = &outMesh->vertices[outMesh->indices[t*3+2]];
-
-        // Two edge vectors u,v
-        auto ux = v2->x - v1->x;
-        auto uy = v2->y - v1->y;
-        auto uz = v2->z - v1->z;
-        auto vx = v3->x - v1->x;
-        auto vy = v3->y - v1->y;
-        auto vz = v3->z - v1->z;
-
-        // cross(u,v)
-        float nx = uy*vz - uz*vy;
-        float ny = uz*vx - ux*vz;
-        float nz = ux*vy - uy*vx;
-
-        // Do not normalize... weight average by contributing face area
-        v1->nx += nx; v1->ny += ny; v1->nz += nz;
-        v2->nx += nx; v2->ny += ny; v2->nz += nz;
-        v3->nx += nx; v3->ny += ny; v3->nz += nz;
+
+void BuildVertexTriangleAdjacency(const IndexType *indices, size_t indexCount, size_t vertexCount,
+                                  VertexTriangleAdjacency *outAdjacency)
+{
+    assert(indexCount % 3 == 0); // trilist
+    auto& offsets = outAdjacency->offsets;
+    auto& triangles = outAdjacency->triangles;
+
+    // Count, prefix sum, then fill in triangle order so each vertex's list comes out ascending
+    offsets.assign(vertexCount + 1, 0);
+    for (size_t i = 0; i < indexCount; ++i) {
+        ++offsets[indices[i] + 1];
+    }
+    for (size_t v = 0; v < vertexCount; ++v) {
+        offsets[v + 1] += offsets[v];
     }
 
-    // Normalize
-    for (auto &v : outMesh->vertices) {
-        float n = 1.0f / std::sqrt(v.nx*v.nx + v.ny*v.ny + v.nz*v.nz);
-        v.nx *= n;
-        v.ny *= n;
-        v.nz *= n;
+    triangles.resize(indexCount);
+    std::vector<unsigned int> cursor(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indexCount; ++i) {
+        triangles[cursor[indices[i]]++] = (unsigned int)(i / 3);
     }
 }
 
 
+void ComputeAvgNormalsInPlace(Vertex *vertices, size_t vertexCount, const IndexType *indices, size_t indexCount)
+{
+    VertexTriangleAdjacency adjacency;
+    BuildVertexTriangleAdjacency(indices, indexCount, vertexCount, &adjacency);
+    ComputeAvgNormalsInPlace(vertices, vertexCount, indices, adjacency);
+}
+
+
+void ComputeAvgNormalsInPlace(Vertex *vertices, size_t vertexCount, const IndexType *indices,
+                              const VertexTriangleAdjacency& adjacency)
+{
+    static const size_t BLOCK = 1024;
+    assert(adjacency.offsets.size() == vertexCount + 1);
+
+    // Face normals first, so the gather below reads each one from a compact array
+    size_t triangles = adjacency.triangles.size() / 3;
+    std::vector<XMFLOAT3> faceNormals(triangles);
+    concurrency::parallel_for(size_t(0), (triangles + BLOCK - 1) / BLOCK, [&](size_t block) {
+        auto end = std::min(triangles, (block + 1) * BLOCK);
+        for (size_t t = block * BLOCK; t < end; ++t) {
+            auto v1 = &vertices[indices[t*3+0]];
+            auto v2 = &vertices[indices[t*3+1]];
+            auto v3 = &vertices[indices[t*3+2]];
+
+            // Two edge vectors u,v
+            auto ux = v2->x - v1->x;
+            auto uy = v2->y - v1->y;
+            auto uz = v2->z - v1->z;
+            auto vx = v3->x - v1->x;
+            auto vy = v3->y - v1->y;
+            auto vz = v3->z - v1->z;
+
+            // cross(u,v); do not normalize... weight average by contributing face area
+            faceNormals[t].x = uy*vz - uz*vy;
+            faceNormals[t].y = uz*vx - ux*vz;
+            faceNormals[t].z = ux*vy - uy*vx;
+        }
+    });
+
+    // Gather and normalize; no two blocks write the same vertex
+    concurrency::parallel_for(size_t(0), (vertexCount + BLOCK - 1) / BLOCK, [&](size_t block) {
+        auto end = std::min(vertexCount, (block + 1) * BLOCK);
+        for (size_t i = block * BLOCK; i < end; ++i) {
+            XMVECTOR sum = XMVectorZero();
+            for (auto k = adjacency.offsets[i]; k < adjacency.offsets[i + 1]; ++k) {
+                sum = XMVectorAdd(sum, XMLoadFloat3(&faceNormals[adjacency.triangles[k]]));
+            }
+            XMFLOAT3 normal;
+            XMStoreFloat3(&normal, sum);
+
+            auto &v = vertices[i];
+            float n = 1.0f / std::sqrt(normal.x*normal.x + normal.y*normal.y + normal.z*normal.z);
+            v.nx = normal.x * n;
+            v.ny = normal.y * n;
+            v.nz = normal.z * n;
+        }
+    });
+}
+
+
+// Coarser geospheres are a prefix of this one
+static constexpr auto GEOSPHERE_TOPOLOGY = MakeGeosphereTopology<MESH_MAX_SUBDIV_LEVELS>();
+
+
 void CreateGeospheres(Mesh *outMesh, unsigned int subdivLevelCount, unsigned int* outSubdivIndexOffsets)
 {
-    CreateIcosahedron(outMesh);
-    outSubdivIndexOffsets[0] = 0;
+    assert(subdivLevelCount <= MESH_MAX_SUBDIV_LEVELS);
 
-    std::vector<Vertex> vertices(outMesh->vertices);
-    std::vector<IndexType> indices(outMesh->indices);
+    // Only the vertex positions are left to do at runtime: each level repeats the previous one's vertices
+    // and appends the midpoints of its edges (unprojected, as subdivision always produced them)
+    std::vector<Vertex> vertices;
+    vertices.reserve(GeosphereVertexCount(subdivLevelCount));
+    {
+        Mesh icosahedron;
+        CreateIcosahedron(&icosahedron);
+        vertices = icosahedron.vertices;
+    }
 
+    auto parents = GEOSPHERE_TOPOLOGY.midpointParents;
     for (unsigned int i = 0; i < subdivLevelCount; ++i) {
-        outSubdivIndexOffsets[i+1] = (unsigned int)indices.size();
-        SubdivideInPlace(outMesh);
+        size_t previous = vertices.size() - GeosphereLevelVertexCount(i);
+        for (unsigned int v = 0; v < GeosphereLevelVertexCount(i); ++v) {
+            vertices.push_back(vertices[previous + v]);
+        }
+        for (unsigned int v = GeosphereLevelVertexCount(i); v < GeosphereLevelVertexCount(i+1); ++v, ++parents) {
+            auto a = vertices[previous + (*parents)[0]];
+            auto b = vertices[previous + (*parents)[1]];
+
+            Vertex m = {};
+            m.x = (a.x + b.x) * 0.5f;
+            m.y = (a.y + b.y) * 0.5f;
+            m.z = (a.z + b.z) * 0.5f;
+            vertices.push_back(m);
+        }
+    }
+
+    auto indexCount = GEOSPHERE_TOPOLOGY.subdivIndexOffsets[subdivLevelCount+1];
+    std::copy(GEOSPHERE_TOPOLOGY.subdivIndexOffsets, GEOSPHERE_TOPOLOGY.subdivIndexOffsets + subdivLevelCount + 2,
+              outSubdivIndexOffsets);
+
+    outMesh->indices.assign(GEOSPHERE_TOPOLOGY.indices, GEOSPHERE_TOPOLOGY.indices + indexCount);
+    std::swap(outMesh->vertices, vertices);
+}
 
-        // Ensure we add the proper offset to the indices from this subdiv level for the combined mesh
-        // This avoids also needing to track a base vertex index for each subdiv level
-        IndexType vertexOffset = (IndexType)vertices.size();
-        vertices.insert(vertices.end(), outMesh->vertices.begin(), outMesh->vertices.end());
 
-        for (auto newIndex : outMesh->indices) {
-            indices.push_back(newIndex + vertexOffset);
+// Same octave weights as the snoise4 path, but each octave is a lookup at its own random offset in the tileable
+// volume. The result is a different noise, not an approximation of that path.
+// Four vertices at a time; the tail repeats the last vertex.
+static void DisplaceFromNoiseVolume(Vertex *vertices, size_t count, const NoiseVolume& volume, const NoiseOctaves<4>& octaves,
+                                    float noiseScale, float radiusScale, float radiusBias, unsigned int offsetSeed)
+{
+    static const size_t OCTAVES = 4;
+
+    std::minstd_rand rng(offsetSeed);
+    std::uniform_real_distribution<float> offsetDist(0.0f, float(NoiseVolume::PERIOD));
+
+    XMVECTOR offsetX[OCTAVES], offsetY[OCTAVES], offsetZ[OCTAVES], frequency[OCTAVES], weight[OCTAVES];
+    for (size_t i = 0; i < OCTAVES; ++i) {
+        offsetX[i] = XMVectorReplicate(offsetDist(rng));
+        offsetY[i] = XMVectorReplicate(offsetDist(rng));
+        offsetZ[i] = XMVectorReplicate(offsetDist(rng));
+        frequency[i] = XMVectorReplicate(noiseScale * float(1 << i));
+        weight[i] = XMVectorReplicate(octaves.Weight(i));
+    }
+
+    for (size_t v = 0; v < count; v += 4) {
+        const Vertex* lane[4];
+        for (size_t l = 0; l < 4; ++l) {
+            lane[l] = &vertices[std::min(v + l, count - 1)];
+        }
+        XMVECTOR x = XMVectorSet(lane[0]->x, lane[1]->x, lane[2]->x, lane[3]->x);
+        XMVECTOR y = XMVectorSet(lane[0]->y, lane[1]->y, lane[2]->y, lane[3]->y);
+        XMVECTOR z = XMVectorSet(lane[0]->z, lane[1]->z, lane[2]->z, lane[3]->z);
+
+        XMVECTOR sum = XMVectorZero();
+        for (size_t i = 0; i < OCTAVES; ++i) {
+            XMVECTOR n = volume.Sample4(XMVectorMultiplyAdd(x, frequency[i], offsetX[i]),
+                                        XMVectorMultiplyAdd(y, frequency[i], offsetY[i]),
+                                        XMVectorMultiplyAdd(z, frequency[i], offsetZ[i]));
+            sum = XMVectorMultiplyAdd(weight[i], n, sum);
+        }
+
+        XMFLOAT4A noise;
+        XMStoreFloat4A(&noise, sum);
+        const float* noiseLanes = &noise.x;
+        for (size_t l = 0; l < 4 && v + l < count; ++l) {
+            float radius = (noiseLanes[l] * octaves.WeightNorm() + 0.5f) * radiusScale + radiusBias;
+            vertices[v + l].x *= radius;
+            vertices[v + l].y *= radius;
+            vertices[v + l].z *= radius;
         }
     }
-    outSubdivIndexOffsets[subdivLevelCount+1] = (unsigned int)indices.size();
+}
 
-    SpherifyInPlace(outMesh);
 
-    // Put the union of vertices/indices back into the mesh object
-    std::swap(outMesh->indices, indices);
-    std::swap(outMesh->vertices, vertices);
+void DrawAsteroidShapes(unsigned int rngSeed, unsigned int count, const AsteroidShapeParams& params,
+                        AsteroidShape* outShapes)
+{
+    std::mt19937 rng(rngSeed);
+    auto randomNoise = std::uniform_real_distribution<float>(0.0f, 10000.0f);
+    auto randomPersistence = std::normal_distribution<float>(params.persistenceMean, params.persistenceStdDev);
+    for (unsigned int m = 0; m < count; ++m) {
+        outShapes[m].persistence = randomPersistence(rng);
+        outShapes[m].noiseOffset = randomNoise(rng);
+    }
+}
+
+
+void ShapeAsteroid(Vertex* outVertices, const Mesh& geosphere, const VertexTriangleAdjacency& adjacency,
+                   const AsteroidShape& shape, const AsteroidShapeParams& params, unsigned int displacementSeed,
+                   const NoiseVolume* noiseVolume)
+{
+    auto vertexCount = geosphere.vertices.size();
+    std::copy(geosphere.vertices.begin(), geosphere.vertices.end(), outVertices);
+    NoiseOctaves<4> textureNoise(shape.persistence);
+
+    if (noiseVolume) {
+        DisplaceFromNoiseVolume(outVertices, vertexCount, *noiseVolume, textureNoise,
+                                params.noiseScale, params.radiusScale, params.radiusBias, displacementSeed);
+    } else {
+        for (size_t i = 0; i < vertexCount; ++i) {
+            auto &v = outVertices[i];
+            float radius = textureNoise(v.x*params.noiseScale, v.y*params.noiseScale, v.z*params.noiseScale,
+                                        shape.noiseOffset);
+            radius = radius * params.radiusScale + params.radiusBias;
+            v.x *= radius;
+            v.y *= radius;
+            v.z *= radius;
+        }
+    }
+
+    if (params.craterCount > 0) {
+        CraterField craters(params.craterCount, params.craterRadiusMin, params.craterRadiusMax, params.craterDepth,
+                            displacementSeed);
+        craters.Stamp(outVertices, geosphere.vertices.data(), vertexCount);
+    }
+
+    ComputeAvgNormalsInPlace(outVertices, vertexCount, geosphere.indices.data(), adjacency);
 }
 
 
 void CreateAsteroidsFromGeospheres(Mesh *outMesh,
                                    unsigned int subdivLevelCount, unsigned int meshInstanceCount,
                                    unsigned int rngSeed,
-                                   unsigned int* outSubdivIndexOffsets, unsigned int* vertexCountPerMesh)
+                                   unsigned int* outSubdivIndexOffsets, unsigned int* vertexCountPerMesh,
+                                   const NoiseVolume* noiseVolume)
 {
     assert(subdivLevelCount <= meshInstanceCount);
 
-    std::mt19937 rng(rngSeed);
-
     Mesh baseMesh;
     CreateGeospheres(&baseMesh, subdivLevelCount, outSubdivIndexOffsets);
 
+    // All meshes (and their subdiv levels) share the base topology
+    VertexTriangleAdjacency adjacency;
+    BuildVertexTriangleAdjacency(baseMesh.indices.data(), baseMesh.indices.size(), baseMesh.vertices.size(),
+                                 &adjacency);
+
     // Per unique mesh
-    *vertexCountPerMesh = (unsigned int)baseMesh.vertices.size();
-    std::vector<Vertex> vertices;
-    vertices.reserve(meshInstanceCount * baseMesh.vertices.size());
+    auto vertexCount = baseMesh.vertices.size();
+    *vertexCountPerMesh = (unsigned int)vertexCount;
+    std::vector<Vertex> vertices(meshInstanceCount * vertexCount);
     // Reuse indices for the different unique meshes
 
-    auto randomNoise = std::uniform_real_distribution<float>(0.0f, 10000.0f);
-    auto randomPersistence = std::normal_distribution<float>(0.95f, 0.04f);
-    float noiseScale = 0.5f;
-    float radiusScale = 0.9f;
-    float radiusBias = 0.3f;
-
-    // Create and randomize unique vertices for each mesh instance
-    for (unsigned int m = 0; m < meshInstanceCount; ++m) {
-        Mesh newMesh(baseMesh);
-        NoiseOctaves<4> textureNoise(randomPersistence(rng));
-        float noise = randomNoise(rng);
-
-        for (auto &v : newMesh.vertices) {
-            float radius = textureNoise(v.x*noiseScale, v.y*noiseScale, v.z*noiseScale, noise);
-            radius = radius * radiusScale + radiusBias;
-            v.x *= radius;
-            v.y *= radius;
-            v.z *= radius;
-        }
-        ComputeAvgNormalsInPlace(&newMesh);
+    // Draw the per-mesh parameters up front (same order as always) so the meshes can be built in parallel
+    AsteroidShapeParams params;
+    std::vector<AsteroidShape> shapes(meshInstanceCount);
+    DrawAsteroidShapes(rngSeed, meshInstanceCount, params, shapes.data());
 
-        vertices.insert(vertices.end(), newMesh.vertices.begin(), newMesh.vertices.end());
-    }
+    // Create and randomize unique vertices for each mesh instance; they all share the base indices
+    concurrency::parallel_for(0U, meshInstanceCount, [&](unsigned int m) {
+        ShapeAsteroid(vertices.data() + m * vertexCount, baseMesh, adjacency, shapes[m], params, rngSeed + m,
+                      noiseVolume);
+    });
 
     // Copy to output
     std::swap(outMesh->indices, baseMesh.indices);
@@ -19,6 +19,8 @@
 #include <vector>
 #include <directxmath.h>
 
+class NoiseVolume;
+
 typedef unsigned short IndexType;
 
 // NOTE: This data could be compressed, but it's not really the bottleneck at the moment
@@ -44,6 +46,15 @@ struct Mesh
     std::vector<IndexType> indices;
 };
 
+// Mesh data that may live elsewhere, e.g. in shared memory
+struct MeshView
+{
+    const Vertex* vertices;
+    size_t vertexCount;
+    const IndexType* indices;
+    size_t indexCount;
+};
+
 void CreateIcosahedron(Mesh *outMesh);
 
 // 1 face -> 4 faces
@@ -51,19 +62,84 @@ void SubdivideInPlace(Mesh *outMesh);
 
 void SpherifyInPlace(Mesh *outMesh, float radius = 1.0f);
 
+// Vertex -> incident triangle adjacency of a triangle list, in CSR form. Depends only on the indices, so is
+// built once per topology and shared by every mesh using it.
+struct VertexTriangleAdjacency
+{
+    std::vector<unsigned int> offsets;   // [vertexCount + 1]
+    std::vector<unsigned int> triangles; // Of vertex v: [offsets[v], offsets[v + 1]), ascending
+};
+
+void BuildVertexTriangleAdjacency(const IndexType *indices, size_t indexCount, size_t vertexCount,
+                                  VertexTriangleAdjacency *outAdjacency);
+
+// Area weighted; each vertex gathers its incident face normals (in triangle order, so the sums match
+// scattering the faces in order), in parallel over blocks of vertices
 void ComputeAvgNormalsInPlace(Mesh *outMesh);
+void ComputeAvgNormalsInPlace(Vertex *vertices, size_t vertexCount, const IndexType *indices, size_t indexCount);
+void ComputeAvgNormalsInPlace(Vertex *vertices, size_t vertexCount, const IndexType *indices,
+                              const VertexTriangleAdjacency& adjacency);
+
+// Total vertex count of the combined geosphere (all subdiv levels) produced by CreateGeospheres
+// Level k of a subdivided icosahedron has 10*4^k + 2 vertices
+constexpr unsigned int GeosphereVertexCount(unsigned int subdivLevelCount)
+{
+    unsigned int count = 0;
+    for (unsigned int k = 0; k <= subdivLevelCount; ++k) {
+        count += 10 * (1U << (2 * k)) + 2;
+    }
+    return count;
+}
 
-// subdivIndexOffset array should be [subdivLevels+2] in size
+// subdivIndexOffset array should be [subdivLevels+2] in size; subdivLevels <= MESH_MAX_SUBDIV_LEVELS.
+// The topology is generated at compile time (see geosphere_topology.h).
 void CreateGeospheres(Mesh *outMesh, unsigned int subdivLevelCount, unsigned int* outSubdivIndexOffsets);
 
+// Shared by all the unique asteroid meshes (see CreateAsteroidsFromGeospheres)
+struct AsteroidShapeParams
+{
+    float noiseScale = 0.5f;
+    float radiusScale = 0.9f;
+    float radiusBias = 0.3f;
+    float persistenceMean = 0.95f;
+    float persistenceStdDev = 0.04f;
+
+    // Impact craters stamped onto each mesh after the noise (see CraterField); radii are angles in radians
+    unsigned int craterCount = 0;
+    float craterRadiusMin = 0.05f;
+    float craterRadiusMax = 0.35f;
+    float craterDepth = 0.3f; // Relative to the crater radius
+};
+
+// Drawn per unique mesh
+struct AsteroidShape
+{
+    float persistence;
+    float noiseOffset;
+};
+
+// count shapes drawn in sequence from rngSeed
+void DrawAsteroidShapes(unsigned int rngSeed, unsigned int count, const AsteroidShapeParams& params,
+                        AsteroidShape* outShapes);
+
+// Writes a copy of the geosphere's vertices to outVertices, displaced into the given shape, with normals.
+// adjacency is the geosphere's. displacementSeed picks the noise volume offset, if there is a noise volume,
+// and the craters.
+void ShapeAsteroid(Vertex* outVertices, const Mesh& geosphere, const VertexTriangleAdjacency& adjacency,
+                   const AsteroidShape& shape, const AsteroidShapeParams& params, unsigned int displacementSeed,
+                   const NoiseVolume* noiseVolume);
+
 // Returns a combined "mesh" that includes:
 // - A set of indices for each subdiv level (outSubdivIndexOffsets for offsets/counts)
 // - A set of vertices for each mesh instance (base vertices per mesh computed from vertexCountPerMesh)
 // - Indices already have the vertex offsets for the correct subdiv level "baked-in", so only need the mesh offset
+// If noiseVolume is given, vertices are displaced by lookups into it (each mesh at its own offset) rather than
+// by evaluating 4D simplex noise. That is a different noise, so the shapes differ from the default ones.
 void CreateAsteroidsFromGeospheres(Mesh *outMesh,
                                    unsigned int subdivLevelCount, unsigned int meshInstanceCount,
                                    unsigned int rngSeed,
-                                   unsigned int* outSubdivIndexOffsets, unsigned int* vertexCountPerMesh);
+                                   unsigned int* outSubdivIndexOffsets, unsigned int* vertexCountPerMesh,
+                                   const NoiseVolume* noiseVolume = nullptr);
 
 
 struct SkyboxVertex
@@ -0,0 +1,166 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "metrics_shm.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+const UINT32 METRICS_MAGIC = 0x4d545341; // "ASTM"
+const UINT32 METRICS_VERSION = 1;
+
+std::string MappingName(const std::string& name)
+{
+    return "Local\\" + name;
+}
+
+} // namespace
+
+// Shared with other processes: layout changes must bump METRICS_VERSION
+struct MetricsBlock
+{
+    UINT32 magic;
+    UINT32 version;
+    std::atomic<UINT64> sequence; // Odd while being written
+    MetricsSnapshot snapshot;
+};
+
+static_assert(sizeof(std::atomic<UINT64>) == sizeof(UINT64), "Sequence must be lock-free to be shared");
+
+
+MetricsPublisher::MetricsPublisher()
+{
+}
+
+
+MetricsPublisher::~MetricsPublisher()
+{
+    if (mBlock) UnmapViewOfFile(mBlock);
+    if (mMapping) CloseHandle(mMapping);
+}
+
+
+HRESULT MetricsPublisher::Open(const std::string& name)
+{
+    mMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(MetricsBlock),
+                                  MappingName(name).c_str());
+    if (!mMapping) return HRESULT_FROM_WIN32(GetLastError());
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(mMapping);
+        mMapping = NULL;
+        return HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS);
+    }
+
+    mBlock = (MetricsBlock*)MapViewOfFile(mMapping, FILE_MAP_WRITE, 0, 0, sizeof(MetricsBlock));
+    if (!mBlock) return HRESULT_FROM_WIN32(GetLastError());
+
+    // Mapping is zero filled; readers treat a zero sequence as nothing published yet
+    mBlock->version = METRICS_VERSION;
+    mBlock->magic = METRICS_MAGIC;
+    return S_OK;
+}
+
+
+void MetricsPublisher::Publish(double frameTime, MetricsSnapshot snapshot)
+{
+    if (!mBlock) return;
+
+    mFrameTimes[mFrameCount % FRAME_WINDOW] = float(1000.0 * frameTime);
+    ++mFrameCount;
+
+    if (mFrameCount % PERCENTILE_INTERVAL == 0) {
+        float sorted[FRAME_WINDOW];
+        auto count = std::min(mFrameCount, (unsigned int)FRAME_WINDOW);
+        std::copy(mFrameTimes, mFrameTimes + count, sorted);
+        std::sort(sorted, sorted + count);
+        mPercentiles[0] = sorted[count / 2];
+        mPercentiles[1] = sorted[count * 9 / 10];
+        mPercentiles[2] = sorted[count * 99 / 100];
+        mPercentiles[3] = sorted[count - 1];
+    }
+
+    snapshot.frameTimeMs = float(1000.0 * frameTime);
+    snapshot.frameTimeP50Ms = mPercentiles[0];
+    snapshot.frameTimeP90Ms = mPercentiles[1];
+    snapshot.frameTimeP99Ms = mPercentiles[2];
+    snapshot.frameTimeMaxMs = mPercentiles[3];
+
+    auto sequence = mBlock->sequence.load(std::memory_order_relaxed);
+    mBlock->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&mBlock->snapshot, &snapshot, sizeof(snapshot));
+    mBlock->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+
+int RunMetricsReader(const std::string& name)
+{
+    auto mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, MappingName(name).c_str());
+    if (!mapping) {
+        fprintf(stderr, "error: no metrics published as '%s'\n", name.c_str());
+        return -1;
+    }
+
+    auto block = (const MetricsBlock*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!block || block->magic != METRICS_MAGIC || block->version != METRICS_VERSION) {
+        fprintf(stderr, "error: '%s' is not a compatible metrics block\n", name.c_str());
+        if (block) UnmapViewOfFile(block);
+        CloseHandle(mapping);
+        return -1;
+    }
+
+    UINT64 lastFrameIndex = 0;
+    int idleSeconds = 0;
+    for (;;) {
+        MetricsSnapshot s;
+        UINT64 before, after;
+        do {
+            before = block->sequence.load(std::memory_order_acquire);
+            memcpy(&s, (const void*)&block->snapshot, sizeof(s));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = block->sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        if (before != 0 && s.frameIndex != lastFrameIndex) {
+            idleSeconds = 0;
+            lastFrameIndex = s.frameIndex;
+
+            // One line per sample, key=value, for scraping
+            std::cout << "pid=" << s.processId << " api=d3d1" << (s.d3d12 ? 2 : 1)
+                      << " frame=" << s.frameIndex << " elapsed_s=" << s.elapsedSeconds
+                      << " frame_ms=" << s.frameTimeMs << " p50_ms=" << s.frameTimeP50Ms
+                      << " p90_ms=" << s.frameTimeP90Ms << " p99_ms=" << s.frameTimeP99Ms
+                      << " max_ms=" << s.frameTimeMaxMs
+                      << " draws=" << s.workload.draws << " culled=" << s.workload.culled
+                      << " indices=" << s.workload.indices << " pixels=" << s.workload.estimatedPixels;
+            for (int l = 0; l <= MESH_MAX_SUBDIV_LEVELS; ++l) std::cout << " lod" << l << "=" << s.workload.lodCounts[l];
+            std::cout << " mesh_bytes=" << s.meshBytes << " texture_bytes=" << s.textureBytes
+                      << " texture_pool_bytes=" << s.texturePoolBytes << std::endl;
+        } else if (++idleSeconds >= 5) {
+            break; // Exited, or hung
+        }
+
+        Sleep(1000);
+    }
+
+    UnmapViewOfFile(block);
+    CloseHandle(mapping);
+    return 0;
+}
@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <windows.h>
+
+#include <atomic>
+#include <string>
+
+#include "simulation.h"
+
+// Live metrics published once per frame into a named file mapping ("Local\<name>"), for monitoring tools
+// to read without attaching to the process. A sequence lock protects the block: the writer never waits and
+// readers retry if the block changed while they copied it.
+
+#define DEFAULT_METRICS_NAME "AsteroidsMetrics"
+
+struct MetricsSnapshot
+{
+    UINT64 frameIndex;
+    double elapsedSeconds;
+    UINT32 processId;
+    UINT32 d3d12;
+
+    // Over the last MetricsPublisher::FRAME_WINDOW frames (refreshed every few frames)
+    float frameTimeMs;
+    float frameTimeP50Ms;
+    float frameTimeP90Ms;
+    float frameTimeP99Ms;
+    float frameTimeMaxMs;
+
+    WorkloadCounters workload;
+
+    UINT64 meshBytes;
+    UINT64 textureBytes;
+    UINT64 texturePoolBytes;
+};
+
+struct MetricsBlock;
+
+class MetricsPublisher
+{
+public:
+    enum { FRAME_WINDOW = 256, PERCENTILE_INTERVAL = 16 };
+
+    MetricsPublisher();
+    ~MetricsPublisher();
+
+    HRESULT Open(const std::string& name);
+
+    // Fills in the frame time fields from frameTime; the rest is published as given
+    void Publish(double frameTime, MetricsSnapshot snapshot);
+
+private:
+    HANDLE mMapping = NULL;
+    MetricsBlock* mBlock = nullptr;
+
+    float mFrameTimes[FRAME_WINDOW];
+    unsigned int mFrameCount = 0;
+    float mPercentiles[4] = {};
+};
+
+// Prints the metrics of a running instance once a second until it exits (or stops publishing)
+int RunMetricsReader(const std::string& name);
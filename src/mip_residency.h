@@ -0,0 +1,75 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+// Tracks which mips of a progressively streamed texture are resident. The resident set is always a contiguous
+// tail of the chain ([MostDetailedResident(), mipLevels)), so samplers can be clamped with a single min LOD.
+// The streaming thread asks for the next step and marks it resident once the upload has completed; the render
+// thread only reads the clamp.
+class MipResidency
+{
+public:
+    // Mips no larger than this are uploaded together as the first step
+    static const uint32_t TAIL_DIM = 64;
+
+    MipResidency(uint32_t width, uint32_t height, uint32_t mipLevels)
+        : mMipLevels(mipLevels), mMostDetailedResident(mipLevels)
+    {
+        mTailFirstMip = mipLevels - 1;
+        while (mTailFirstMip > 0 && std::max(width >> (mTailFirstMip - 1), height >> (mTailFirstMip - 1)) <= TAIL_DIM) {
+            --mTailFirstMip;
+        }
+    }
+
+    // Next range of mips to upload, coarsest first: the whole tail, then one mip at a time.
+    // Returns false once the chain is complete.
+    bool NextStep(uint32_t* firstMip, uint32_t* mipCount) const
+    {
+        uint32_t resident = mMostDetailedResident;
+        if (resident == 0) return false;
+
+        if (resident == mMipLevels) {
+            *firstMip = mTailFirstMip;
+            *mipCount = mMipLevels - mTailFirstMip;
+        } else {
+            *firstMip = resident - 1;
+            *mipCount = 1;
+        }
+        return true;
+    }
+
+    void MarkResident(uint32_t firstMip)
+    {
+        mMostDetailedResident = std::min(mMostDetailedResident.load(), firstMip);
+    }
+
+    uint32_t MostDetailedResident() const { return mMostDetailedResident; }
+    bool AnyResident() const { return mMostDetailedResident < mMipLevels; }
+    bool FullyResident() const { return mMostDetailedResident == 0; }
+
+    // Suitable for ResourceMinLODClamp/SetResourceMinLOD; only meaningful if AnyResident()
+    float MinLODClamp() const { return (float)mMostDetailedResident; }
+
+private:
+    uint32_t mMipLevels;
+    uint32_t mTailFirstMip;
+    std::atomic<uint32_t> mMostDetailedResident;
+};
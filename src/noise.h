@@ -39,6 +39,10 @@ public:
         mWeightNorm = 0.5f / weightSum; // Will normalize to [-0.5, 0.5]
     }
 
+    // For summing the same octaves from another noise source: sum(Weight(i) * noise(2^i * p)) * WeightNorm() + 0.5
+    float Weight(size_t octave) const { return mWeights[octave]; }
+    float WeightNorm() const { return mWeightNorm; }
+
     // Returns [0, 1]
     float operator()(float x, float y, float z) const
     {
@@ -0,0 +1,189 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "noise_volume.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <ppl.h>
+
+using namespace DirectX;
+
+namespace {
+
+const UINT ERROR_PROBE_COUNT = 1 << 16;
+
+// Improved Perlin noise fade and gradient selection
+inline float Fade(float t)
+{
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+inline float Grad(UINT hash, float x, float y, float z)
+{
+    UINT h = hash & 15;
+    float u = h < 8 ? x : y;
+    float v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
+    return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+}
+
+inline float Lerp(float t, float a, float b)
+{
+    return a + t * (b - a);
+}
+
+} // namespace
+
+
+NoiseVolume::NoiseVolume(float maxError, unsigned int seed)
+{
+    static_assert((PERIOD & (PERIOD - 1)) == 0, "Lattice wrapping assumes a pow2 period");
+
+    for (UINT i = 0; i < 256; ++i) mPerm[i] = (BYTE)i;
+    std::shuffle(mPerm, mPerm + 256, std::mt19937(seed));
+    std::copy(mPerm, mPerm + 256, mPerm + 256);
+
+    for (UINT r = 2; ; r *= 2) {
+        Bake(r);
+        mMeasuredError = MeasureError();
+        if (mMeasuredError <= maxError || r >= MAX_CELL_RESOLUTION) break;
+    }
+}
+
+
+float NoiseVolume::Evaluate(float x, float y, float z) const
+{
+    float fx = std::floor(x), fy = std::floor(y), fz = std::floor(z);
+    x -= fx; y -= fy; z -= fz;
+
+    const UINT mask = PERIOD - 1;
+    UINT X0 = (UINT)(int)fx & mask, Y0 = (UINT)(int)fy & mask, Z0 = (UINT)(int)fz & mask;
+    UINT X1 = (X0 + 1) & mask, Y1 = (Y0 + 1) & mask, Z1 = (Z0 + 1) & mask;
+
+    // Lattice points are wrapped before hashing, so the noise tiles
+    auto hash = [&](UINT i, UINT j, UINT k) {
+        return (UINT)mPerm[mPerm[mPerm[i] + j] + k];
+    };
+
+    float u = Fade(x), v = Fade(y), w = Fade(z);
+    return Lerp(w, Lerp(v, Lerp(u, Grad(hash(X0, Y0, Z0), x,        y,        z),
+                                   Grad(hash(X1, Y0, Z0), x - 1.0f, y,        z)),
+                           Lerp(u, Grad(hash(X0, Y1, Z0), x,        y - 1.0f, z),
+                                   Grad(hash(X1, Y1, Z0), x - 1.0f, y - 1.0f, z))),
+                   Lerp(v, Lerp(u, Grad(hash(X0, Y0, Z1), x,        y,        z - 1.0f),
+                                   Grad(hash(X1, Y0, Z1), x - 1.0f, y,        z - 1.0f)),
+                           Lerp(u, Grad(hash(X0, Y1, Z1), x,        y - 1.0f, z - 1.0f),
+                                   Grad(hash(X1, Y1, Z1), x - 1.0f, y - 1.0f, z - 1.0f))));
+}
+
+
+void NoiseVolume::Bake(UINT cellResolution)
+{
+    mCellResolution = cellResolution;
+    mDim = PERIOD * cellResolution;
+    mMask = mDim - 1;
+    mSamples.resize((size_t)mDim * mDim * mDim);
+
+    float step = 1.0f / float(cellResolution);
+    concurrency::parallel_for(UINT(0), mDim, [&](UINT z) {
+        float* row = mSamples.data() + (size_t)z * mDim * mDim;
+        for (UINT y = 0; y < mDim; ++y) {
+            for (UINT x = 0; x < mDim; ++x) {
+                *row++ = Evaluate(x * step, y * step, z * step);
+            }
+        }
+    });
+}
+
+
+float NoiseVolume::MeasureError() const
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> coord(0.0f, float(PERIOD));
+
+    float maxError = 0.0f;
+    for (UINT i = 0; i < ERROR_PROBE_COUNT; ++i) {
+        float x = coord(rng), y = coord(rng), z = coord(rng);
+        maxError = std::max(maxError, std::abs(Sample(x, y, z) - Evaluate(x, y, z)));
+    }
+    return maxError;
+}
+
+
+float NoiseVolume::Sample(float x, float y, float z) const
+{
+    x *= mCellResolution; y *= mCellResolution; z *= mCellResolution;
+    float fx = std::floor(x), fy = std::floor(y), fz = std::floor(z);
+    x -= fx; y -= fy; z -= fz;
+
+    // Volume dim is pow2, so masking also wraps negative coordinates
+    UINT X0 = (UINT)(int)fx & mMask, Y0 = (UINT)(int)fy & mMask, Z0 = (UINT)(int)fz & mMask;
+    UINT X1 = (X0 + 1) & mMask, Y1 = (Y0 + 1) & mMask, Z1 = (Z0 + 1) & mMask;
+
+    return Lerp(z, Lerp(y, Lerp(x, At(X0, Y0, Z0), At(X1, Y0, Z0)),
+                           Lerp(x, At(X0, Y1, Z0), At(X1, Y1, Z0))),
+                   Lerp(y, Lerp(x, At(X0, Y0, Z1), At(X1, Y0, Z1)),
+                           Lerp(x, At(X0, Y1, Z1), At(X1, Y1, Z1))));
+}
+
+
+XMVECTOR XM_CALLCONV NoiseVolume::Sample4(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z) const
+{
+    XMVECTOR scale = XMVectorReplicate(float(mCellResolution));
+    XMVECTOR px = XMVectorMultiply(x, scale);
+    XMVECTOR py = XMVectorMultiply(y, scale);
+    XMVECTOR pz = XMVectorMultiply(z, scale);
+    XMVECTOR fx = XMVectorFloor(px);
+    XMVECTOR fy = XMVectorFloor(py);
+    XMVECTOR fz = XMVectorFloor(pz);
+    XMVECTOR tx = XMVectorSubtract(px, fx);
+    XMVECTOR ty = XMVectorSubtract(py, fy);
+    XMVECTOR tz = XMVectorSubtract(pz, fz);
+
+    XMINT4 ix, iy, iz;
+    XMStoreSInt4(&ix, XMConvertVectorFloatToInt(fx, 0));
+    XMStoreSInt4(&iy, XMConvertVectorFloatToInt(fy, 0));
+    XMStoreSInt4(&iz, XMConvertVectorFloatToInt(fz, 0));
+
+    // Gather the 8 corners of each lane's cell; the blend is done across lanes
+    XMFLOAT4A c[8];
+    const int* lx = &ix.x;
+    const int* ly = &iy.x;
+    const int* lz = &iz.x;
+    float* corners = &c[0].x;
+    for (UINT lane = 0; lane < 4; ++lane) {
+        UINT X0 = (UINT)lx[lane] & mMask, Y0 = (UINT)ly[lane] & mMask, Z0 = (UINT)lz[lane] & mMask;
+        UINT X1 = (X0 + 1) & mMask, Y1 = (Y0 + 1) & mMask, Z1 = (Z0 + 1) & mMask;
+        corners[0 * 4 + lane] = At(X0, Y0, Z0);
+        corners[1 * 4 + lane] = At(X1, Y0, Z0);
+        corners[2 * 4 + lane] = At(X0, Y1, Z0);
+        corners[3 * 4 + lane] = At(X1, Y1, Z0);
+        corners[4 * 4 + lane] = At(X0, Y0, Z1);
+        corners[5 * 4 + lane] = At(X1, Y0, Z1);
+        corners[6 * 4 + lane] = At(X0, Y1, Z1);
+        corners[7 * 4 + lane] = At(X1, Y1, Z1);
+    }
+
+    XMVECTOR x00 = XMVectorLerpV(XMLoadFloat4A(&c[0]), XMLoadFloat4A(&c[1]), tx);
+    XMVECTOR x10 = XMVectorLerpV(XMLoadFloat4A(&c[2]), XMLoadFloat4A(&c[3]), tx);
+    XMVECTOR x01 = XMVectorLerpV(XMLoadFloat4A(&c[4]), XMLoadFloat4A(&c[5]), tx);
+    XMVECTOR x11 = XMVectorLerpV(XMLoadFloat4A(&c[6]), XMLoadFloat4A(&c[7]), tx);
+    XMVECTOR y0 = XMVectorLerpV(x00, x10, ty);
+    XMVECTOR y1 = XMVectorLerpV(x01, x11, ty);
+    return XMVectorLerpV(y0, y1, tz);
+}
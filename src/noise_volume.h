@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <windows.h>
+#include <DirectXMath.h>
+#include <vector>
+
+// Tileable 3D gradient noise baked into a volume, so mesh displacement can do trilinear lookups instead of
+// evaluating noise per vertex. The noise repeats every PERIOD lattice units along each axis.
+// This is its own (Perlin) noise, not a sample of snoise4: the default mesh path varies each mesh along snoise4's
+// 4th coordinate, which a 3D volume can't reproduce, so meshes displaced from it have different shapes and the
+// error is only measured against Evaluate.
+class NoiseVolume
+{
+public:
+    enum { PERIOD = 8 };
+    enum { MAX_CELL_RESOLUTION = 16 }; // Samples per lattice unit; 128^3 floats at most
+
+    // Bakes (in parallel) at the lowest resolution whose measured trilinear error against Evaluate is
+    // within maxError, or at MAX_CELL_RESOLUTION if none is
+    explicit NoiseVolume(float maxError, unsigned int seed = 0);
+
+    // Exact noise, roughly [-1, 1]. Coordinates are in lattice units.
+    float Evaluate(float x, float y, float z) const;
+
+    // Trilinear lookups of the baked volume
+    float Sample(float x, float y, float z) const;
+    DirectX::XMVECTOR XM_CALLCONV Sample4(DirectX::FXMVECTOR x, DirectX::FXMVECTOR y, DirectX::FXMVECTOR z) const;
+
+    UINT CellResolution() const { return mCellResolution; }
+    float MeasuredError() const { return mMeasuredError; }
+    size_t SizeInBytes() const { return mSamples.size() * sizeof(float); }
+
+private:
+    void Bake(UINT cellResolution);
+    float MeasureError() const;
+
+    float At(UINT x, UINT y, UINT z) const { return mSamples[(z * mDim + y) * mDim + x]; }
+
+    BYTE mPerm[512]; // 256 entry permutation, repeated so hashes need no wrapping
+    UINT mCellResolution = 0;
+    UINT mDim = 0;  // PERIOD * mCellResolution; pow2
+    UINT mMask = 0;
+    float mMeasuredError = 0.0f;
+    std::vector<float> mSamples; // [z][y][x]
+};
@@ -0,0 +1,256 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "perf_overlay.h"
+
+#include <windows.h>
+#include <algorithm>
+#include <stdio.h>
+
+namespace {
+
+const int PANEL_WIDTH = 560;
+const int PADDING = 4;
+const int LINE_HEIGHT = 20;
+const float TEXT_SCALE = 0.4f; // 50px font
+const int GRAPH_TOP = PADDING + LINE_HEIGHT + 4;
+const int GRAPH_HEIGHT = 100;
+const int STAGE_TOP = GRAPH_TOP + GRAPH_HEIGHT + 6;
+const int COUNTER_TOP = STAGE_TOP + PerfOverlay::STAGE_COUNT * LINE_HEIGHT;
+const int PANEL_HEIGHT = COUNTER_TOP + 3 * LINE_HEIGHT + PADDING;
+
+const double REFRESH_INTERVAL = 0.25;
+
+const char* STAGE_NAMES[PerfOverlay::STAGE_COUNT] = {
+    "sim update",
+    "record (CPU)",
+    "submit",
+    "present",
+    "fence wait",
+    "frame lock",
+};
+
+const GUIColor STAGE_COLORS[PerfOverlay::STAGE_COUNT] = {
+    GUI_COLOR_BLUE,
+    GUI_COLOR_CYAN,
+    GUI_COLOR_GREEN,
+    GUI_COLOR_YELLOW,
+    GUI_COLOR_ORANGE,
+    GUI_COLOR_MAGENTA,
+};
+
+double Seconds(UINT64 count)
+{
+    static double countToSeconds = []() {
+        UINT64 freq;
+        QueryPerformanceFrequency((LARGE_INTEGER*)&freq);
+        return 1.0 / double(freq);
+    }();
+    return double(count) * countToSeconds;
+}
+
+UINT64 Now()
+{
+    UINT64 count;
+    QueryPerformanceCounter((LARGE_INTEGER*)&count);
+    return count;
+}
+
+} // namespace
+
+
+// Panel, graph and stage legend; drawn before (under) the text controls
+class PerfOverlay::Graph : public GUIControl
+{
+public:
+    Graph(const PerfOverlay* overlay, int x, int y)
+        : mOverlay(overlay)
+    {
+        mX = x;
+        mY = y;
+        mWidth = PANEL_WIDTH;
+        mHeight = PANEL_HEIGHT;
+        mTextureFile = GUI_PALETTE_TEXTURE;
+        mVisible = false;
+    }
+
+    virtual SpriteVertex* Draw(float viewportWidth, float viewportHeight, SpriteVertex* outVertex) const override
+    {
+        auto begin = Now();
+        auto o = mOverlay;
+        auto v = outVertex;
+
+        float x = float(mX);
+        float y = float(mY);
+        v = DrawSolidRect(x, y, float(mWidth), float(mHeight), GUI_COLOR_PANEL, viewportWidth, viewportHeight, v);
+
+        // Twice the target frame time fills the graph
+        float graphX = x + PADDING;
+        float graphBottom = y + GRAPH_TOP + GRAPH_HEIGHT;
+        float graphWidth = float(PANEL_WIDTH - 2 * PADDING);
+        float pixelsPerSecond = float(GRAPH_HEIGHT / (2.0 * o->mTargetFrameTime));
+        float barWidth = graphWidth / HISTORY_FRAMES;
+
+        // Newest on the right
+        for (unsigned int i = 0; i < o->mHistoryCount; ++i) {
+            auto frame = (o->mHistoryEnd + HISTORY_FRAMES - o->mHistoryCount + i) % HISTORY_FRAMES;
+            float barX = graphX + (HISTORY_FRAMES - o->mHistoryCount + i) * barWidth;
+
+            float top = graphBottom;
+            for (int s = 0; s < STAGE_COUNT; ++s) {
+                float height = std::min(o->mStageHistory[frame][s] * pixelsPerSecond, top - (graphBottom - GRAPH_HEIGHT));
+                if (height < 0.5f) continue;
+                top -= height;
+                v = DrawSolidRect(barX, top, barWidth, height, STAGE_COLORS[s], viewportWidth, viewportHeight, v);
+            }
+
+            float frameHeight = std::min(o->mFrameHistory[frame] * pixelsPerSecond, float(GRAPH_HEIGHT));
+            v = DrawSolidRect(barX, graphBottom - frameHeight, barWidth, 2.0f, GUI_COLOR_WHITE, viewportWidth, viewportHeight, v);
+        }
+
+        v = DrawSolidRect(graphX, graphBottom - GRAPH_HEIGHT / 2, graphWidth, 1.0f, GUI_COLOR_RED, viewportWidth, viewportHeight, v);
+
+        for (int s = 0; s < STAGE_COUNT; ++s) {
+            float swatchY = y + STAGE_TOP + s * LINE_HEIGHT + 4;
+            v = DrawSolidRect(x + PADDING, swatchY, 12.0f, 12.0f, STAGE_COLORS[s], viewportWidth, viewportHeight, v);
+        }
+
+        mDrawCount = Now() - begin;
+        return v;
+    }
+
+    UINT64 DrawCount() const { return mDrawCount; }
+
+private:
+    const PerfOverlay* mOverlay;
+    mutable UINT64 mDrawCount = 0;
+};
+
+
+PerfOverlay::PerfOverlay(GUI* gui, int x, int y, double targetFrameTime)
+    : mTargetFrameTime(targetFrameTime)
+{
+    mGraph = gui->AddControl(new Graph(this, x, y));
+
+    mFrameText = gui->AddText(x + PADDING, y + PADDING, "", TEXT_SCALE);
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        mStageText[s] = gui->AddText(x + PADDING + 18, y + STAGE_TOP + s * LINE_HEIGHT, "", TEXT_SCALE);
+    }
+    for (int i = 0; i < 3; ++i) {
+        mCounterText[i] = gui->AddText(x + PADDING, y + COUNTER_TOP + i * LINE_HEIGHT, "", TEXT_SCALE);
+    }
+
+    Visible(false);
+}
+
+
+void PerfOverlay::Visible(bool visible)
+{
+    mVisible = visible;
+
+    mGraph->Visible(visible);
+    mFrameText->Visible(visible);
+    for (auto t : mStageText) t->Visible(visible);
+    for (auto t : mCounterText) t->Visible(visible);
+
+    // Start over rather than attributing the hidden time to one frame
+    mPrimed = false;
+    mHistoryCount = 0;
+    mTimeSinceRefresh = REFRESH_INTERVAL;
+}
+
+
+void PerfOverlay::Update(double frameTime, const std::function<void(Counters*)>& gatherCounters)
+{
+    if (!mVisible) return;
+
+    auto begin = Now();
+
+    double totals[PROFILE_STAGE_COUNT];
+    ProfileStageTotals(totals);
+
+    if (mPrimed) {
+        auto delta = [&](ProfileStage stage) { return float(totals[stage] - mLastTotals[stage]); };
+
+        auto stages = mStageHistory[mHistoryEnd];
+        stages[STAGE_SIM_UPDATE]      = delta(PROFILE_STAGE_SIM_UPDATE);
+        stages[STAGE_RECORD]          = delta(PROFILE_STAGE_FRAME) + delta(PROFILE_STAGE_RENDER) +
+                                        delta(PROFILE_STAGE_RENDER_SUBSET);
+        stages[STAGE_SUBMIT]          = delta(PROFILE_STAGE_RENDER_SUBMIT);
+        stages[STAGE_PRESENT]         = delta(PROFILE_STAGE_PRESENT);
+        stages[STAGE_FENCE_WAIT]      = delta(PROFILE_STAGE_FENCE_WAIT);
+        stages[STAGE_FRAME_LOCK_WAIT] = delta(PROFILE_STAGE_FRAME_LOCK_WAIT);
+        mFrameHistory[mHistoryEnd] = float(frameTime);
+
+        mHistoryEnd = (mHistoryEnd + 1) % HISTORY_FRAMES;
+        mHistoryCount = std::min(mHistoryCount + 1, (unsigned int)HISTORY_FRAMES);
+    }
+    std::copy(totals, totals + PROFILE_STAGE_COUNT, mLastTotals);
+    mPrimed = true;
+
+    mTimeSinceRefresh += frameTime;
+    if (mTimeSinceRefresh >= REFRESH_INTERVAL && mHistoryCount > 0) {
+        mTimeSinceRefresh = 0.0;
+        RefreshText(gatherCounters);
+    }
+
+    double alpha = 0.05;
+    mUpdateTime = alpha * Seconds(Now() - begin) + (1.0 - alpha) * mUpdateTime;
+    mDrawTime = alpha * Seconds(mGraph->DrawCount()) + (1.0 - alpha) * mDrawTime;
+}
+
+
+void PerfOverlay::RefreshText(const std::function<void(Counters*)>& gatherCounters)
+{
+    double frameSum = 0.0;
+    double frameMax = 0.0;
+    double stageSums[STAGE_COUNT] = {};
+    for (unsigned int i = 0; i < mHistoryCount; ++i) {
+        auto frame = (mHistoryEnd + HISTORY_FRAMES - mHistoryCount + i) % HISTORY_FRAMES;
+        frameSum += mFrameHistory[frame];
+        frameMax = std::max(frameMax, (double)mFrameHistory[frame]);
+        for (int s = 0; s < STAGE_COUNT; ++s) stageSums[s] += mStageHistory[frame][s];
+    }
+
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "frame ms: %.2f avg, %.2f max  overlay %.3f ms",
+             1000.0 * frameSum / mHistoryCount, 1000.0 * frameMax, 1000.0 * (mUpdateTime + mDrawTime));
+    mFrameText->Text(buffer);
+
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        snprintf(buffer, sizeof(buffer), "%-14s %6.2f ms", STAGE_NAMES[s], 1000.0 * stageSums[s] / mHistoryCount);
+        mStageText[s]->Text(buffer);
+    }
+
+    Counters counters;
+    gatherCounters(&counters);
+
+    auto& workload = counters.workload;
+    snprintf(buffer, sizeof(buffer), "draws %u, culled %u, triangles %.2fM, pixels %.2fM",
+             workload.draws, workload.culled, workload.indices / 3.0e6, workload.estimatedPixels / 1.0e6);
+    mCounterText[0]->Text(buffer);
+
+    int length = snprintf(buffer, sizeof(buffer), "drawn per LOD:");
+    for (int l = 0; l <= MESH_MAX_SUBDIV_LEVELS; ++l) {
+        length += snprintf(buffer + length, sizeof(buffer) - length, " %u", workload.lodCounts[l]);
+    }
+    mCounterText[1]->Text(buffer);
+
+    snprintf(buffer, sizeof(buffer), "memory MB: meshes %.1f, textures %.1f, pool %.1f",
+             counters.meshBytes / (1024.0 * 1024.0), counters.textureBytes / (1024.0 * 1024.0),
+             counters.texturePoolBytes / (1024.0 * 1024.0));
+    mCounterText[2]->Text(buffer);
+}
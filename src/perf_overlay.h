@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "gui.h"
+#include "profile.h"
+#include "simulation.h"
+
+#include <functional>
+
+// Rolling frame time graph with a per-stage breakdown, drawn with the GUI. Stage times come from the profiler's
+// per-thread totals (see ProfileStageTotals), so work spread over threads shows up as CPU time, not wall time.
+class PerfOverlay
+{
+public:
+    enum { HISTORY_FRAMES = 128 };
+
+    enum Stage {
+        STAGE_SIM_UPDATE,
+        STAGE_RECORD,
+        STAGE_SUBMIT,
+        STAGE_PRESENT,
+        STAGE_FENCE_WAIT,
+        STAGE_FRAME_LOCK_WAIT,
+        STAGE_COUNT
+    };
+
+    // Only gathered when the text is refreshed (a few times a second)
+    struct Counters
+    {
+        WorkloadCounters workload = {};
+        size_t meshBytes = 0;
+        size_t textureBytes = 0;
+        size_t texturePoolBytes = 0;
+    };
+
+    // Controls are added to (and owned by) the GUI; starts hidden
+    PerfOverlay(GUI* gui, int x, int y, double targetFrameTime);
+
+    void Visible(bool visible);
+    bool Visible() const { return mVisible; }
+
+    // Once per frame, after rendering. Does nothing while hidden.
+    void Update(double frameTime, const std::function<void(Counters*)>& gatherCounters);
+
+private:
+    class Graph;
+
+    void RefreshText(const std::function<void(Counters*)>& gatherCounters);
+
+    Graph* mGraph;
+    GUIText* mFrameText;
+    GUIText* mStageText[STAGE_COUNT];
+    GUIText* mCounterText[3];
+
+    bool mVisible = false;
+    double mTargetFrameTime;
+
+    // Ring buffer, seconds
+    float mFrameHistory[HISTORY_FRAMES];
+    float mStageHistory[HISTORY_FRAMES][STAGE_COUNT];
+    unsigned int mHistoryEnd = 0;
+    unsigned int mHistoryCount = 0;
+
+    bool mPrimed = false;
+    double mLastTotals[PROFILE_STAGE_COUNT];
+    double mTimeSinceRefresh = 0.0;
+
+    // Own cost, seconds per frame (smoothed)
+    double mUpdateTime = 0.0;
+    double mDrawTime = 0.0;
+};
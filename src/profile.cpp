@@ -16,6 +16,9 @@
 
 #include "profile.h"
 #include "settings.h"
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
 #include <sstream>
 #include <assert.h>
 
@@ -38,6 +41,165 @@ static __itt_string_handle* gSimUpdate = __itt_string_handle_create("RenderSimUp
 static __itt_string_handle* gRenderSubmit = __itt_string_handle_create("RenderSubmit");
 static __itt_string_handle* gFrameLockWait = __itt_string_handle_create("FrameLockWait");
 
+namespace {
+
+enum { MAX_PROFILE_THREADS = 64, MAX_STAGE_DEPTH = PROFILE_MAX_STAGE_DEPTH };
+
+// Per thread; only written by the owning thread
+struct ThreadStageState
+{
+    std::atomic<UINT64> counts[PROFILE_STAGE_COUNT];
+
+    // Stack of open stages. The sampling profiler reads it while the thread is suspended.
+    ProfileStage stages[MAX_STAGE_DEPTH];
+    std::atomic<int> depth;
+    UINT64 lastCount;
+
+    std::atomic<HANDLE> thread;   // Set once registered; cleared as the thread exits
+    std::atomic<int> handleUsers; // Acquired uses of thread
+};
+
+// Zero initialized (static storage); slots are never reused
+ThreadStageState gThreadStates[MAX_PROFILE_THREADS];
+std::atomic<unsigned int> gThreadStatesUsed;
+
+// Closes the thread's handle as it exits
+struct ThreadRegistration
+{
+    ThreadStageState* state = nullptr; // Null once the slots run out
+    bool registered = false;
+
+    ~ThreadRegistration()
+    {
+        if (!state) return;
+        // Later acquires see no handle; earlier ones are waited for
+        auto thread = state->thread.exchange(NULL);
+        while (state->handleUsers.load() != 0) YieldProcessor();
+        if (thread) CloseHandle(thread);
+    }
+};
+
+thread_local ThreadRegistration tRegistration;
+
+ThreadStageState* CurrentThreadState()
+{
+    auto& r = tRegistration;
+    if (!r.registered) {
+        r.registered = true;
+        auto slot = gThreadStatesUsed++;
+        if (slot < MAX_PROFILE_THREADS) {
+            r.state = &gThreadStates[slot];
+            r.state->thread = OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_INFORMATION,
+                                         FALSE, GetCurrentThreadId());
+        }
+    }
+    return r.state;
+}
+
+// Charges the time since the last transition to the innermost open stage
+void ChargeStage(ThreadStageState* s, int depth, UINT64 now)
+{
+    if (depth > 0 && depth <= MAX_STAGE_DEPTH) {
+        auto& total = s->counts[s->stages[depth - 1]];
+        total.store(total.load(std::memory_order_relaxed) + (now - s->lastCount), std::memory_order_relaxed);
+    }
+    s->lastCount = now;
+}
+
+void BeginStage(ProfileStage stage)
+{
+    auto s = CurrentThreadState();
+    if (!s) return;
+
+    UINT64 now;
+    QueryPerformanceCounter((LARGE_INTEGER*)&now);
+    int depth = s->depth.load(std::memory_order_relaxed);
+    ChargeStage(s, depth, now);
+    if (depth < MAX_STAGE_DEPTH) s->stages[depth] = stage;
+    s->depth.store(depth + 1, std::memory_order_release);
+}
+
+void EndStage()
+{
+    auto s = tRegistration.state;
+    if (!s) return;
+    int depth = s->depth.load(std::memory_order_relaxed);
+    if (depth == 0) return;
+
+    UINT64 now;
+    QueryPerformanceCounter((LARGE_INTEGER*)&now);
+    ChargeStage(s, depth, now);
+    s->depth.store(depth - 1, std::memory_order_release);
+}
+
+const char* STAGE_NAMES[PROFILE_STAGE_COUNT] = {
+    "Frame",
+    "Render",
+    "RenderSubset",
+    "SimUpdate",
+    "RenderSubmit",
+    "Present",
+    "FenceWait",
+    "FrameLockWait",
+};
+
+} // namespace
+
+const char* ProfileStageName(ProfileStage stage)
+{
+    return STAGE_NAMES[stage];
+}
+
+unsigned int ProfileThreadCount()
+{
+    return std::min((unsigned int)MAX_PROFILE_THREADS, gThreadStatesUsed.load());
+}
+
+void* ProfileAcquireThreadHandle(unsigned int thread)
+{
+    auto& s = gThreadStates[thread];
+    ++s.handleUsers;
+    auto handle = s.thread.load();
+    if (!handle) --s.handleUsers;
+    return handle;
+}
+
+void ProfileReleaseThreadHandle(unsigned int thread)
+{
+    --gThreadStates[thread].handleUsers;
+}
+
+int ProfileThreadStageDepth(unsigned int thread)
+{
+    return gThreadStates[thread].depth.load(std::memory_order_relaxed);
+}
+
+int ProfileThreadStageStack(unsigned int thread, ProfileStage* outStages)
+{
+    auto& s = gThreadStates[thread];
+    int depth = std::min(s.depth.load(std::memory_order_acquire), (int)MAX_STAGE_DEPTH);
+    std::copy(s.stages, s.stages + depth, outStages);
+    return depth;
+}
+
+void ProfileStageTotals(double outSeconds[PROFILE_STAGE_COUNT])
+{
+    static double countToSeconds = []() {
+        UINT64 freq;
+        QueryPerformanceFrequency((LARGE_INTEGER*)&freq);
+        return 1.0 / double(freq);
+    }();
+
+    unsigned int used = ProfileThreadCount();
+    for (int stage = 0; stage < PROFILE_STAGE_COUNT; ++stage) {
+        UINT64 total = 0;
+        for (unsigned int t = 0; t < used; ++t) {
+            total += gThreadStates[t].counts[stage].load(std::memory_order_relaxed);
+        }
+        outSeconds[stage] = double(total) * countToSeconds;
+    }
+}
+
 void ProfileBeginFrame(size_t frameIndex)
 {
     // Lazy init is fine here (low freq)
@@ -47,14 +209,15 @@ void ProfileBeginFrame(size_t frameIndex)
         gFrameHandles[frameIndex] = __itt_string_handle_create(oss.str().c_str());
     }
     __itt_task_begin(gDomain, __itt_null, __itt_null, gFrameHandles[frameIndex]);
+    BeginStage(PROFILE_STAGE_FRAME);
 }
-void ProfileEndFrame()           { __itt_task_end(gDomain); }
+void ProfileEndFrame()           { EndStage(); __itt_task_end(gDomain); }
 
-void ProfileBeginRender()        { __itt_task_begin(gDomain, __itt_null, __itt_null, gRender); }
-void ProfileEndRender()          { __itt_task_end(gDomain); }
+void ProfileBeginRender()        { __itt_task_begin(gDomain, __itt_null, __itt_null, gRender); BeginStage(PROFILE_STAGE_RENDER); }
+void ProfileEndRender()          { EndStage(); __itt_task_end(gDomain); }
 
-void ProfileBeginFenceWait()     { __itt_task_begin(gDomain, __itt_null, __itt_null, gFenceWait); }
-void ProfileEndFenceWait()       { __itt_task_end(gDomain); }
+void ProfileBeginFenceWait()     { __itt_task_begin(gDomain, __itt_null, __itt_null, gFenceWait); BeginStage(PROFILE_STAGE_FENCE_WAIT); }
+void ProfileEndFenceWait()       { EndStage(); __itt_task_end(gDomain); }
 
 void ProfileBeginPresent(size_t backBufferIndex)
 {
@@ -65,17 +228,18 @@ void ProfileBeginPresent(size_t backBufferIndex)
 		gPresentHandles[backBufferIndex] = __itt_string_handle_create(oss.str().c_str());
 	}
 	__itt_task_begin(gDomain, __itt_null, __itt_null, gPresentHandles[backBufferIndex]);
+	BeginStage(PROFILE_STAGE_PRESENT);
 }
-void ProfileEndPresent()         { __itt_task_end(gDomain); }
+void ProfileEndPresent()         { EndStage(); __itt_task_end(gDomain); }
 
-void ProfileBeginRenderSubset()  { __itt_task_begin(gDomain, __itt_null, __itt_null, gRenderSubset); }
-void ProfileEndRenderSubset()    { __itt_task_end(gDomain); }
+void ProfileBeginRenderSubset()  { __itt_task_begin(gDomain, __itt_null, __itt_null, gRenderSubset); BeginStage(PROFILE_STAGE_RENDER_SUBSET); }
+void ProfileEndRenderSubset()    { EndStage(); __itt_task_end(gDomain); }
 
-void ProfileBeginSimUpdate()     { __itt_task_begin(gDomain, __itt_null, __itt_null, gSimUpdate); }
-void ProfileEndSimUpdate()       { __itt_task_end(gDomain); }
+void ProfileBeginSimUpdate()     { __itt_task_begin(gDomain, __itt_null, __itt_null, gSimUpdate); BeginStage(PROFILE_STAGE_SIM_UPDATE); }
+void ProfileEndSimUpdate()       { EndStage(); __itt_task_end(gDomain); }
 
-void ProfileBeginRenderSubmit()  { __itt_task_begin(gDomain, __itt_null, __itt_null, gRenderSubmit); }
-void ProfileEndRenderSubmit()    { __itt_task_end(gDomain); }
+void ProfileBeginRenderSubmit()  { __itt_task_begin(gDomain, __itt_null, __itt_null, gRenderSubmit); BeginStage(PROFILE_STAGE_RENDER_SUBMIT); }
+void ProfileEndRenderSubmit()    { EndStage(); __itt_task_end(gDomain); }
 
-void ProfileBeginFrameLockWait() { __itt_task_begin(gDomain, __itt_null, __itt_null, gFrameLockWait); }
-void ProfileEndFrameLockWait()   { __itt_task_end(gDomain); }
+void ProfileBeginFrameLockWait() { __itt_task_begin(gDomain, __itt_null, __itt_null, gFrameLockWait); BeginStage(PROFILE_STAGE_FRAME_LOCK_WAIT); }
+void ProfileEndFrameLockWait()   { EndStage(); __itt_task_end(gDomain); }
@@ -39,3 +39,32 @@ void ProfileEndSimUpdate();
 
 void ProfileBeginFrameLockWait();
 void ProfileEndFrameLockWait();
+
+// Besides the VTune markup, each thread accumulates the CPU time spent in each of these (exclusive of nested
+// ones) into its own slot; readers sum the slots without any locking.
+enum ProfileStage {
+    PROFILE_STAGE_FRAME,
+    PROFILE_STAGE_RENDER,
+    PROFILE_STAGE_RENDER_SUBSET,
+    PROFILE_STAGE_SIM_UPDATE,
+    PROFILE_STAGE_RENDER_SUBMIT,
+    PROFILE_STAGE_PRESENT,
+    PROFILE_STAGE_FENCE_WAIT,
+    PROFILE_STAGE_FRAME_LOCK_WAIT,
+    PROFILE_STAGE_COUNT
+};
+
+// Totals since startup, summed over threads (seconds)
+void ProfileStageTotals(double outSeconds[PROFILE_STAGE_COUNT]);
+
+const char* ProfileStageName(ProfileStage stage);
+
+// Threads that have entered a stage, for the sampling profiler (see sampling_profiler.h).
+// The stack is only consistent while the thread is suspended; the depth may be polled to skip idle threads.
+// A thread closes its handle as it exits, waiting for any acquired use of it to be released first.
+enum { PROFILE_MAX_STAGE_DEPTH = 8 };
+unsigned int ProfileThreadCount();
+void* ProfileAcquireThreadHandle(unsigned int thread); // Null until registered and once exited
+void ProfileReleaseThreadHandle(unsigned int thread);   // Only after a non-null acquire
+int ProfileThreadStageDepth(unsigned int thread);
+int ProfileThreadStageStack(unsigned int thread, ProfileStage outStages[PROFILE_MAX_STAGE_DEPTH]);
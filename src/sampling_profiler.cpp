@@ -0,0 +1,175 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "sampling_profiler.h"
+#include "waitable_timer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+bool SamplingProfiler::SampleKey::operator<(const SampleKey& other) const
+{
+    if (ip != other.ip) return ip < other.ip;
+    if (depth != other.depth) return depth < other.depth;
+    return std::lexicographical_compare(stages, stages + depth, other.stages, other.stages + other.depth);
+}
+
+
+SamplingProfiler::SamplingProfiler(unsigned int frequency)
+    : mFrequency(std::max(frequency, 1U))
+    , mStop(false)
+{
+}
+
+
+SamplingProfiler::~SamplingProfiler()
+{
+    Stop();
+}
+
+
+void SamplingProfiler::Start()
+{
+    if (mThread.joinable()) return;
+    mStop = false;
+    mThread = std::thread([this]() { Run(); });
+}
+
+
+void SamplingProfiler::Stop()
+{
+    if (!mThread.joinable()) return;
+    mStop = true;
+    mThread.join();
+}
+
+
+void SamplingProfiler::Run()
+{
+    auto timer = CreateWaitableTimerWithFallback();
+    if (!timer) return;
+
+    // Sample as far ahead of the threads we interrupt as possible
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+
+    LARGE_INTEGER dueTime;
+    dueTime.QuadPart = -(LONGLONG)(10000000 / mFrequency); // Relative, 100ns units
+
+    QueryPerformanceCounter((LARGE_INTEGER*)&mBeginCount);
+    while (!mStop) {
+        if (!SetWaitableTimer(timer, &dueTime, 0, NULL, NULL, FALSE)) break;
+        WaitForSingleObject(timer, INFINITE);
+        ++mTickCount;
+
+        UINT64 tickBegin;
+        QueryPerformanceCounter((LARGE_INTEGER*)&tickBegin);
+
+        auto threadCount = ProfileThreadCount();
+        for (unsigned int t = 0; t < threadCount; ++t) {
+            // Idle pool threads aren't in any stage; skip them without suspending
+            if (ProfileThreadStageDepth(t) == 0) continue;
+            auto thread = (HANDLE)ProfileAcquireThreadHandle(t);
+            if (!thread) continue;
+
+            SampleKey key = {};
+            CONTEXT context = {};
+            context.ContextFlags = CONTEXT_CONTROL;
+
+            UINT64 suspendBegin, suspendEnd;
+            QueryPerformanceCounter((LARGE_INTEGER*)&suspendBegin);
+            bool sampled = false;
+            if (SuspendThread(thread) != (DWORD)-1) {
+                // Also waits for the suspension to take effect
+                sampled = GetThreadContext(thread, &context) != 0;
+                if (sampled) key.depth = ProfileThreadStageStack(t, key.stages);
+                ResumeThread(thread);
+            }
+            ProfileReleaseThreadHandle(t);
+            QueryPerformanceCounter((LARGE_INTEGER*)&suspendEnd);
+            mSuspendedCount += suspendEnd - suspendBegin;
+
+            if (!sampled || key.depth == 0) continue;
+#if defined(_M_X64)
+            key.ip = context.Rip;
+#else
+            key.ip = context.Eip;
+#endif
+            ++mSamples[key];
+            ++mSampleCount;
+        }
+
+        UINT64 tickEnd;
+        QueryPerformanceCounter((LARGE_INTEGER*)&tickEnd);
+        mSamplingCount += tickEnd - tickBegin;
+    }
+    QueryPerformanceCounter((LARGE_INTEGER*)&mEndCount);
+
+    CloseHandle(timer);
+}
+
+
+HRESULT SamplingProfiler::WriteFolded(const std::string& fileName) const
+{
+    std::ofstream file(fileName);
+    if (!file) return E_FAIL;
+
+    std::map<HMODULE, std::string> moduleNames;
+    for (auto& sample : mSamples) {
+        auto& key = sample.first;
+        for (int d = 0; d < key.depth; ++d) {
+            file << ProfileStageName(key.stages[d]) << ";";
+        }
+
+        HMODULE module = NULL;
+        if (GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                               (LPCSTR)key.ip, &module)) {
+            auto name = moduleNames.find(module);
+            if (name == moduleNames.end()) {
+                char path[MAX_PATH] = {};
+                GetModuleFileNameA(module, path, MAX_PATH);
+                std::string fullPath(path);
+                name = moduleNames.emplace(module, fullPath.substr(fullPath.find_last_of("\\/") + 1)).first;
+            }
+            file << name->second << "+0x" << std::hex << (key.ip - (UINT64)module);
+        } else {
+            file << "0x" << std::hex << key.ip;
+        }
+        file << std::dec << " " << sample.second << std::endl;
+    }
+
+    return file ? S_OK : E_FAIL;
+}
+
+
+void SamplingProfiler::PrintSummary() const
+{
+    UINT64 frequency;
+    QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+    double seconds = double(mEndCount - mBeginCount) / frequency;
+    if (seconds <= 0.0) return;
+
+    // Formatted apart, so std::cout's own format is left alone
+    std::ostringstream summary;
+    summary << "Sampling profiler: " << mSampleCount << " samples (" << mSamples.size() << " unique) over "
+            << std::fixed << std::setprecision(1) << seconds << " s at " << mTickCount / seconds << " Hz; "
+            << std::setprecision(2) << 100.0 * mSamplingCount / frequency / seconds << "% of one core, "
+            << (mSampleCount ? 1e6 * mSuspendedCount / frequency / mSampleCount : 0.0)
+            << " us suspended per sample";
+    std::cout << summary.str() << std::endl;
+}
@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <windows.h>
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+
+#include "profile.h"
+
+// Samples the instruction pointer of every thread that is inside a Profile* stage, at a fixed rate, together
+// with that thread's stage stack. Threads are briefly suspended to read both consistently; nothing is
+// allocated while a thread is suspended. Addresses are written as module+offset for offline symbolization.
+class SamplingProfiler
+{
+public:
+    explicit SamplingProfiler(unsigned int frequency = 1000);
+    ~SamplingProfiler();
+
+    void Start();
+    void Stop();
+
+    // Folded stacks ("Frame;Render;RenderSubset;module.exe+0x1234 count"), as consumed by flamegraph.pl
+    // and similar once the addresses are symbolized. Only valid once stopped.
+    HRESULT WriteFolded(const std::string& fileName) const;
+    void PrintSummary() const;
+
+private:
+    struct SampleKey
+    {
+        UINT64 ip;
+        int depth;
+        ProfileStage stages[PROFILE_MAX_STAGE_DEPTH];
+
+        bool operator<(const SampleKey& other) const;
+    };
+
+    void Run();
+
+    unsigned int mFrequency;
+    std::thread mThread;
+    std::atomic<bool> mStop;
+
+    // Owned by the sampling thread while running
+    std::map<SampleKey, UINT64> mSamples;
+    UINT64 mSampleCount = 0;
+    UINT64 mTickCount = 0;
+    UINT64 mSamplingCount = 0;  // Time spent sampling (QPC counts)
+    UINT64 mSuspendedCount = 0; // Time threads spent suspended
+    UINT64 mBeginCount = 0;
+    UINT64 mEndCount = 0;
+};
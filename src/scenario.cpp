@@ -0,0 +1,225 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "scenario.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+using namespace DirectX;
+
+namespace {
+
+struct SettingField
+{
+    const char* name;
+    void (*apply)(Settings* settings, double value);
+};
+
+const SettingField SETTING_FIELDS[] = {
+    { "d3d12",                   [](Settings* s, double v) { s->d3d12 = v != 0.0; } },
+    { "animate",                 [](Settings* s, double v) { s->animate = v != 0.0; } },
+    { "vsync",                   [](Settings* s, double v) { s->vsync = v != 0.0; } },
+    { "locked_fps",              [](Settings* s, double v) { s->lockFrameRate = v > 0.0;
+                                                             if (v > 0.0) s->lockedFrameRate = (unsigned int)v; } },
+    { "multithreaded_rendering", [](Settings* s, double v) { s->multithreadedRendering = v != 0.0; } },
+    { "submit_rendering",        [](Settings* s, double v) { s->submitRendering = v != 0.0; } },
+    { "execute_indirect",        [](Settings* s, double v) { s->executeIndirect = v != 0.0; } },
+    { "perf_overlay",            [](Settings* s, double v) { s->perfOverlay = v != 0.0; } },
+    { "render_scale",            [](Settings* s, double v) { s->renderScale = v; } },
+    { "lod_bias",                [](Settings* s, double v) { s->lodBias = (float)v; } },
+    { "draw_budget",             [](Settings* s, double v) { s->drawBudget = (unsigned int)v; } },
+    { "triangle_budget",         [](Settings* s, double v) { s->triangleBudget = (unsigned int)v; } },
+    { "incremental_lod",         [](Settings* s, double v) { s->incrementalLOD = v != 0.0; } },
+};
+
+// The eye sits on a sphere of the given radius around the origin, looking at the center.
+// The belt is a ring of radius SIM_ORBIT_RADIUS (450) in the XZ plane.
+const char* const BUILTIN_SCENARIOS[] = {
+    // flythrough: along the belt, looking ahead
+    "timestep 0.0166667\n"
+    "set 0 animate 1\n"
+    "set 0 lod_bias 0\n"
+    "camera  0  436.0 0  111.3  450 0.0 1.57\n"
+    "camera  5  329.3 0  306.7  450 0.5 1.55\n"
+    "camera 10  141.9 0  427.0  450 1.0 1.58\n"
+    "camera 15  -80.2 0  442.8  450 1.5 1.56\n"
+    "camera 20 -282.7 0  350.1  450 2.0 1.57\n"
+    "camera 25 -415.9 0  171.7  450 2.5 1.55\n"
+    "camera 30 -447.4 0  -48.7  450 3.0 1.57\n",
+
+    // closeup: just outside the belt, looking into it
+    "timestep 0.0166667\n"
+    "set 0 animate 1\n"
+    "set 0 lod_bias 0\n"
+    "camera  0  440.0   0    0.0  500 0.00 1.52\n"
+    "camera 10  440.0   0   60.0  490 0.15 1.60\n"
+    "camera 20  430.0 -10  120.0  480 0.30 1.55\n",
+
+    // wide: from the default view, pulling out and up over the whole belt
+    "timestep 0.0166667\n"
+    "set 0 animate 1\n"
+    "set 0 lod_bias 0\n"
+    "camera  0  0 -48 0   580 4.5 1.45\n"
+    "camera 10  0 -48 0  1100 5.3 0.90\n"
+    "camera 20  0 -48 0  1600 6.1 0.50\n",
+};
+static_assert(sizeof(BUILTIN_SCENARIOS) / sizeof(BUILTIN_SCENARIOS[0]) == Scenario::BUILTIN_COUNT,
+              "BUILTIN_SCENARIOS and BUILTIN_NAMES out of sync");
+
+} // namespace
+
+const char* const Scenario::BUILTIN_NAMES[] = { "flythrough", "closeup", "wide" };
+
+
+HRESULT Scenario::Load(const std::string& nameOrFileName)
+{
+    for (int i = 0; i < BUILTIN_COUNT; ++i) {
+        if (nameOrFileName == BUILTIN_NAMES[i]) {
+            return Parse(BUILTIN_SCENARIOS[i], nameOrFileName);
+        }
+    }
+
+    std::ifstream file(nameOrFileName);
+    if (!file) {
+        fprintf(stderr, "error: no built in scenario or file '%s'\n", nameOrFileName.c_str());
+        return E_FAIL;
+    }
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return Parse(text, nameOrFileName);
+}
+
+
+HRESULT Scenario::Parse(const std::string& text, const std::string& sourceName)
+{
+    mName = sourceName;
+    mTimeStep = 1.0 / 60.0;
+    mDuration = 0.0;
+    mCameraKeys.clear();
+    mChanges.clear();
+    mNextChange = 0;
+    mTime = 0.0;
+
+    bool durationGiven = false;
+    double lastTime = 0.0;
+
+    std::istringstream lines(text);
+    std::string line;
+    for (int lineNumber = 1; std::getline(lines, line); ++lineNumber) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream tokens(line);
+        std::string directive;
+        if (!(tokens >> directive)) continue;
+
+        bool valid = false;
+        if (directive == "timestep") {
+            valid = (tokens >> mTimeStep) && mTimeStep > 0.0;
+        } else if (directive == "duration") {
+            valid = (tokens >> mDuration) && mDuration >= 0.0;
+            durationGiven = true;
+        } else if (directive == "camera") {
+            CameraKey key;
+            valid = bool(tokens >> key.time);
+            for (int p = 0; p < CAMERA_PARAMETER_COUNT; ++p) {
+                valid = valid && (tokens >> key.parameters[p]);
+            }
+            valid = valid && (mCameraKeys.empty() || key.time > mCameraKeys.back().time);
+            if (valid) {
+                mCameraKeys.push_back(key);
+                lastTime = std::max(lastTime, key.time);
+            }
+        } else if (directive == "set") {
+            SettingChange change;
+            std::string name;
+            valid = (tokens >> change.time >> name >> change.value) &&
+                    (mChanges.empty() || change.time >= mChanges.back().time);
+            change.setting = 0;
+            while (change.setting < _countof(SETTING_FIELDS) && name != SETTING_FIELDS[change.setting].name) {
+                ++change.setting;
+            }
+            if (valid && change.setting == _countof(SETTING_FIELDS)) {
+                fprintf(stderr, "error: %s:%d: unknown setting '%s'\n", sourceName.c_str(), lineNumber, name.c_str());
+                return E_FAIL;
+            }
+            if (valid) {
+                mChanges.push_back(change);
+                lastTime = std::max(lastTime, change.time);
+            }
+        }
+
+        std::string extra;
+        if (!valid || (tokens >> extra)) {
+            fprintf(stderr, "error: %s:%d: invalid or out of order '%s'\n",
+                    sourceName.c_str(), lineNumber, directive.c_str());
+            return E_FAIL;
+        }
+    }
+
+    if (mCameraKeys.empty()) {
+        fprintf(stderr, "error: %s: no camera keys\n", sourceName.c_str());
+        return E_FAIL;
+    }
+    if (!durationGiven) mDuration = lastTime;
+    return S_OK;
+}
+
+
+void Scenario::ApplySettings(Settings* settings)
+{
+    for (; mNextChange < mChanges.size() && mChanges[mNextChange].time <= mTime; ++mNextChange) {
+        auto& change = mChanges[mNextChange];
+        SETTING_FIELDS[change.setting].apply(settings, change.value);
+    }
+}
+
+
+// Cubic Hermite segments with finite difference (Catmull-Rom) tangents, which allow uneven key spacing;
+// one-sided at the ends, constant outside the keys
+float Scenario::Interpolate(unsigned int parameter, double time) const
+{
+    auto& keys = mCameraKeys;
+    if (time <= keys.front().time) return keys.front().parameters[parameter];
+    if (time >= keys.back().time) return keys.back().parameters[parameter];
+
+    size_t i = 0;
+    while (keys[i + 1].time <= time) ++i;
+
+    auto value = [&](size_t k) { return double(keys[k].parameters[parameter]); };
+    auto tangent = [&](size_t k) {
+        size_t a = k > 0 ? k - 1 : k;
+        size_t b = k + 1 < keys.size() ? k + 1 : k;
+        return (value(b) - value(a)) / (keys[b].time - keys[a].time);
+    };
+
+    double h = keys[i + 1].time - keys[i].time;
+    double u = (time - keys[i].time) / h;
+    double u2 = u * u;
+    double u3 = u2 * u;
+    return float((2.0 * u3 - 3.0 * u2 + 1.0) * value(i) + (u3 - 2.0 * u2 + u) * h * tangent(i) +
+                 (-2.0 * u3 + 3.0 * u2) * value(i + 1) + (u3 - u2) * h * tangent(i + 1));
+}
+
+
+void Scenario::ApplyCamera(OrbitCamera* camera) const
+{
+    auto center = XMVectorSet(Interpolate(CAMERA_CENTER_X, mTime), Interpolate(CAMERA_CENTER_Y, mTime),
+                              Interpolate(CAMERA_CENTER_Z, mTime), 0.0f);
+    auto radius = Interpolate(CAMERA_RADIUS, mTime);
+    // Scripted; the radius limits only matter to interactive zoom
+    camera->View(center, radius, radius, radius, Interpolate(CAMERA_LONGITUDE, mTime), Interpolate(CAMERA_LATITUDE, mTime));
+}
@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <windows.h>
+
+#include <string>
+#include <vector>
+
+#include "camera.h"
+#include "settings.h"
+
+// Scripted benchmark run: camera keyframes (OrbitCamera::View parameters, interpolated with a Catmull-Rom
+// spline), settings changes at given times and a fixed simulation timestep, so that the same frames are
+// simulated and rendered regardless of frame rate. Text format, one directive per line, '#' comments:
+//
+//   timestep <seconds>                                           default 1/60
+//   duration <seconds>                                           default: time of the last key or change
+//   camera <time> <center x> <y> <z> <radius> <longitude> <latitude>
+//   set <time> <setting> <value>                                 see ApplySettings for the names
+//
+// Angles are in radians and aren't wrapped, so a key at 6.2 followed by one at 0.1 turns back the long way.
+class Scenario
+{
+public:
+    // Built in scenarios, loaded by name: "flythrough", "closeup" and "wide"
+    static const char* const BUILTIN_NAMES[];
+    enum { BUILTIN_COUNT = 3 };
+
+    // A built in scenario name or a scenario file name
+    HRESULT Load(const std::string& nameOrFileName);
+
+    const std::string& Name() const { return mName; }
+    double TimeStep() const { return mTimeStep; }
+    double Duration() const { return mDuration; }
+    double Time() const { return mTime; }
+    bool Finished() const { return mTime >= mDuration; }
+
+    // Applies the settings changes due by the current time, each once
+    void ApplySettings(Settings* settings);
+    void ApplyCamera(OrbitCamera* camera) const;
+
+    // Advances the scenario time by one timestep
+    void Step() { mTime += mTimeStep; }
+
+private:
+    enum { CAMERA_CENTER_X, CAMERA_CENTER_Y, CAMERA_CENTER_Z, CAMERA_RADIUS, CAMERA_LONGITUDE, CAMERA_LATITUDE,
+           CAMERA_PARAMETER_COUNT };
+
+    struct CameraKey
+    {
+        double time;
+        float parameters[CAMERA_PARAMETER_COUNT];
+    };
+
+    struct SettingChange
+    {
+        double time;
+        unsigned int setting; // Index into the settings table
+        double value;
+    };
+
+    HRESULT Parse(const std::string& text, const std::string& sourceName);
+    float Interpolate(unsigned int parameter, double time) const;
+
+    std::string mName;
+    double mTimeStep = 1.0 / 60.0;
+    double mDuration = 0.0;
+    std::vector<CameraKey> mCameraKeys;       // In time order
+    std::vector<SettingChange> mChanges;      // In time order
+    size_t mNextChange = 0;
+    double mTime = 0.0;
+};
@@ -0,0 +1,281 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "self_test.h"
+#include "asset_params.h"
+#include "frame_governor.h"
+#include "mip_residency.h"
+#include "texture_pool.h"
+
+#include <stdio.h>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+namespace {
+
+int gFailures = 0;
+
+void Check(bool passed, const char* condition, const char* file, int line)
+{
+    if (!passed) {
+        ++gFailures;
+        fprintf(stderr, "error: self test failed: %s (%s:%d)\n", condition, file, line);
+    }
+}
+
+#define CHECK(condition) Check((condition), #condition, __FILE__, __LINE__)
+
+// Stands in for a backend texture object
+class TestObject : public IUnknown
+{
+public:
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** object) override
+    {
+        *object = nullptr;
+        return E_NOINTERFACE;
+    }
+    ULONG STDMETHODCALLTYPE AddRef() override { return ++mRefs; }
+    ULONG STDMETHODCALLTYPE Release() override
+    {
+        auto refs = --mRefs;
+        if (refs == 0) delete this;
+        return refs;
+    }
+
+private:
+    std::atomic<ULONG> mRefs{ 1 };
+};
+
+// Views a different set of textures every few frames, plus one that is always in view, with a budget of
+// four textures: stale textures must be evicted for the new ones, never the one always in view
+void TestTexturePoolEviction()
+{
+    const UINT DIM = ProceduralTexturePool::MIN_DIM;
+    const UINT FALLBACK = 1000;
+    const UINT FRAMES_PER_VIEW = 4;
+    const UINT VIEWS = 10;
+
+    PooledTexture probe;
+    ProceduralTexturePool::Generate(0, DIM, AsteroidTextureParams(), &probe);
+    auto budget = 4 * (UINT64)probe.data.size();
+
+    ProceduralTexturePool pool(64, 0, 32, budget, 2,
+                               [](const PooledTexture&) -> IUnknown* { return new TestObject; },
+                               [](UINT, IUnknown*) {});
+
+    auto request = [&](UINT view) {
+        bool resident = pool.Request(0, DIM, FALLBACK) != FALLBACK;
+        for (UINT i = 1; i <= 3; ++i) {
+            resident = pool.Request(3 * view + i, DIM, FALLBACK) != FALLBACK && resident;
+        }
+        return resident;
+    };
+
+    for (UINT view = 0; view < VIEWS; ++view) {
+        bool resident = false;
+        for (UINT f = 0; f < FRAMES_PER_VIEW; ++f) {
+            pool.BeginFrame();
+            resident = request(view);
+            pool.WaitForGeneration();
+            CHECK(pool.ResidentBytes() <= budget);
+        }
+        // Requested, generated and published within the view's frames
+        CHECK(resident);
+    }
+
+    CHECK(pool.Evictions() >= 3 * (VIEWS - 1));
+}
+
+// A texture parameter change regenerates a resident texture once requested, showing the old one until then
+void TestTexturePoolParams()
+{
+    const UINT DIM = ProceduralTexturePool::MIN_DIM;
+    const UINT FALLBACK = 1000;
+
+    ProceduralTexturePool pool(4, 0, 4, ~0ULL, 2,
+                               [](const PooledTexture&) -> IUnknown* { return new TestObject; },
+                               [](UINT, IUnknown*) {});
+
+    auto view = [&](UINT frames) {
+        for (UINT f = 0; f < frames; ++f) {
+            pool.BeginFrame();
+            pool.Request(0, DIM, FALLBACK);
+            pool.WaitForGeneration();
+        }
+        return pool.Request(0, DIM, FALLBACK);
+    };
+
+    auto slot = view(3);
+    CHECK(slot != FALLBACK);
+
+    // Unchanged parameters don't regenerate
+    pool.SetTextureParams(AsteroidTextureParams());
+    CHECK(view(3) == slot);
+
+    AsteroidTextureParams params;
+    params.strength *= 0.5f;
+    pool.SetTextureParams(params);
+    CHECK(pool.Request(0, DIM, FALLBACK) == slot);
+
+    auto regenerated = view(3);
+    CHECK(regenerated != slot && regenerated != FALLBACK);
+}
+
+// Runs the governor for 60 simulated seconds against a synthetic frame cost: load times the target frame time,
+// scaled down by each knob the governor trades away, with +-5% uniform jitter
+struct GovernorRun
+{
+    double settledFrameTime = 0.0; // Mean over the last 30 seconds
+    unsigned int settledChanges = 0;
+    bool withinLimits = true;
+    FrameGovernor::Decision last = {};
+};
+
+GovernorRun RunGovernor(const FrameGovernor::Config& config, double load)
+{
+    const double SECONDS = 60.0;
+    const double SETTLED = 30.0;
+
+    FrameGovernor governor(config);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> jitter(-0.05, 0.05);
+
+    GovernorRun run;
+    double time = 0.0, settledTime = 0.0;
+    unsigned int settledFrames = 0;
+    while (time < SECONDS) {
+        auto& d = governor.Current();
+        double draw = 0.3 + 0.7 * double(d.drawBudget) / double(config.maxDrawBudget);
+        double pixels = 0.4 + 0.6 * (d.renderScale * d.renderScale) / (config.maxRenderScale * config.maxRenderScale);
+        double lod = 1.0 / (1.0 + 0.25 * d.lodBias);
+        double frameTime = config.targetFrameTime * load * draw * pixels * lod * (1.0 + jitter(rng));
+
+        time += frameTime;
+        bool changed = governor.Update(frameTime);
+        if (time >= SETTLED) {
+            settledTime += frameTime;
+            ++settledFrames;
+            if (changed) ++run.settledChanges;
+        }
+
+        auto& next = governor.Current();
+        run.withinLimits = run.withinLimits &&
+            next.renderScale >= config.minRenderScale && next.renderScale <= config.maxRenderScale &&
+            next.lodBias >= 0.0f && next.lodBias <= config.maxLODBias &&
+            next.drawBudget >= config.minDrawBudget && next.drawBudget <= config.maxDrawBudget;
+    }
+
+    run.settledFrameTime = settledTime / settledFrames;
+    run.last = governor.Current();
+    return run;
+}
+
+// Converges on the target when it can, then holds still (hysteresis); pinned at the limits when it can't
+void TestFrameGovernor()
+{
+    FrameGovernor::Config config;
+    config.maxDrawBudget = 100000;
+    config.minDrawBudget = 25000;
+
+    // Headroom: stays at full quality
+    auto light = RunGovernor(config, 0.5);
+    CHECK(light.last.renderScale == config.maxRenderScale);
+    CHECK(light.last.lodBias == 0.0f);
+    CHECK(light.last.drawBudget == config.maxDrawBudget);
+    CHECK(light.settledChanges == 0);
+
+    // Over budget by varying amounts: settles within the dead band (plus some slack for the jitter) and stops
+    for (double load : { 1.3, 1.6, 2.0 }) {
+        auto run = RunGovernor(config, load);
+        CHECK(std::abs(run.settledFrameTime - config.targetFrameTime) <= 1.5 * config.deadBand * config.targetFrameTime);
+        CHECK(run.settledChanges == 0);
+        CHECK(run.withinLimits);
+    }
+
+    // Far over budget: every knob traded away, and no further
+    auto heavy = RunGovernor(config, 10.0);
+    CHECK(heavy.withinLimits);
+    CHECK(heavy.last.renderScale == config.minRenderScale);
+    CHECK(heavy.last.lodBias == config.maxLODBias);
+    CHECK(heavy.last.drawBudget == config.minDrawBudget);
+}
+
+// Streams a 1024^2 chain: the tail (64^2 and down) first, then one mip at a time up to mip 0, with the clamp
+// following each step down and never back up
+void TestMipResidency()
+{
+    MipResidency residency(1024, 1024, 11);
+    CHECK(!residency.AnyResident());
+
+    const uint32_t expectedFirst[] = { 4, 3, 2, 1, 0 };
+    const uint32_t expectedCount[] = { 7, 1, 1, 1, 1 };
+    uint32_t steps = 0, firstMip = 0, mipCount = 0;
+    while (residency.NextStep(&firstMip, &mipCount)) {
+        if (steps >= 5) break;
+        CHECK(firstMip == expectedFirst[steps]);
+        CHECK(mipCount == expectedCount[steps]);
+
+        // Asking again before the upload completes gives the same step
+        uint32_t againFirst = 0, againCount = 0;
+        CHECK(residency.NextStep(&againFirst, &againCount) && againFirst == firstMip && againCount == mipCount);
+
+        residency.MarkResident(firstMip);
+        CHECK(residency.AnyResident());
+        CHECK(residency.MinLODClamp() == float(firstMip));
+
+        // A late mark for a coarser step leaves the clamp alone
+        residency.MarkResident(firstMip + 1);
+        CHECK(residency.MinLODClamp() == float(firstMip));
+        ++steps;
+    }
+    CHECK(steps == 5);
+    CHECK(residency.FullyResident());
+    CHECK(!residency.NextStep(&firstMip, &mipCount));
+
+    // A chain that is all tail is one step
+    MipResidency small(64, 32, 7);
+    CHECK(small.NextStep(&firstMip, &mipCount) && firstMip == 0 && mipCount == 7);
+    small.MarkResident(firstMip);
+    CHECK(small.FullyResident());
+}
+
+} // namespace
+
+
+int RunSelfTests()
+{
+    struct Test
+    {
+        const char* name;
+        void (*run)();
+    };
+    static const Test tests[] = {
+        { "texture pool eviction", TestTexturePoolEviction },
+        { "texture pool parameters", TestTexturePoolParams },
+        { "frame governor", TestFrameGovernor },
+        { "mip residency", TestMipResidency },
+    };
+
+    gFailures = 0;
+    for (auto& test : tests) {
+        auto failures = gFailures;
+        test.run();
+        std::cout << "Self test: " << test.name << (gFailures == failures ? " passed" : " FAILED") << std::endl;
+    }
+    return gFailures;
+}
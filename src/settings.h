@@ -48,7 +48,7 @@ enum { NUM_FRAMES_TO_BUFFER = 3 };
 enum { NUM_SUBSETS = 4 };
 
 // Buffer size for dynamic sprite data
-enum { MAX_SPRITE_VERTICES_PER_FRAME = 6 * 1024 };
+enum { MAX_SPRITE_VERTICES_PER_FRAME = 6 * 2048 };
 
 
 // This structure is often copied/passed by value so don't put anything really expensive in it.
@@ -73,6 +73,15 @@ struct Settings
 
     bool lockFrameRate = false;
     bool animate = true;
+    bool perfOverlay = false;
+
+    // Frame governor (see frame_governor.h) adapts renderScale and these to hold the target
+    double targetFrameRate = 0.0; // 0 => off
+    float lodBias = 0.0f; // Subdivision levels subtracted from the screen size based choice
+    unsigned int drawBudget = NUM_ASTEROIDS; // Asteroids drawn; a prefix, which is spatially random
+
+    unsigned int triangleBudget = 0; // Per frame, across all asteroids; 0 => LOD chosen per asteroid only
+    bool incrementalLOD = true; // Only recompute LODs that could have changed; not with a triangle budget
 
     // Multithreading actually makes debugging annoying so disable by default
 #if defined(_DEBUG)
@@ -84,7 +93,24 @@ struct Settings
     bool submitRendering = true;
     bool executeIndirect = false;
     bool warp = false;
+    bool threadPoolIO = false; // Asset loading; default is overlapped I/O on a completion port
+    bool ioReadIntoMemory = false; // Completion port loading reads every file into memory, rather than mapping the less urgent ones
+
+    bool proceduralSkybox = false; // Generate (and cache) a starfield instead of loading starbox_1024.dds
+    unsigned int skyboxResolution = 1024; // Procedural only; pow2
+    unsigned int skyboxSeed = 0;
+
+    float meshBakedNoiseTolerance = 0.0f; // > 0 => displace meshes from a baked noise volume (a different noise, not an approximation of the default)
+    unsigned int meshCraterCount = 0;  // > 0 => craters per mesh, over any asset parameters file
+    unsigned int texturePoolSize = 0; // Virtual procedural asteroid textures; 0 => unique textures only
+    unsigned int texturePoolBudgetMB = 48;
+    unsigned int sampleProfileHz = 1000;
 
 	std::string statsCsvFileName;
 	std::string statsSummaryCsvFileName;
+	std::string startupJsonFileName;
+	std::string resultsJsonFileName; // Benchmark results (see benchmark_results.h); -close_after only
+	std::string assetPackFileName; // Empty => load loose files
+	std::string metricsName; // Empty => live metrics not published (see metrics_shm.h)
+	std::string sampleProfileFileName; // Empty => no sampling profile (see sampling_profiler.h)
 };
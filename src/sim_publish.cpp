@@ -0,0 +1,342 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "sim_publish.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+
+using namespace DirectX;
+
+// Shared with other processes: layout changes must bump SIMULATION_BLOCK_VERSION.
+// The assets, their generation tags and the snapshot slots follow at the given offsets.
+struct SimulationBlock
+{
+    UINT32 magic; // Written last, once the assets are in place
+    UINT32 version;
+
+    // AsteroidsSimulation constructor arguments
+    UINT32 rngSeed;
+    UINT32 asteroidCount;
+    UINT32 meshInstanceCount;
+    UINT32 subdivCount;
+    UINT32 textureCount;
+    UINT32 slotCount;
+    UINT32 fieldCount;
+    AsteroidField fields[MAX_ASTEROID_FIELDS];
+
+    AsteroidAssets::Layout assets;
+    UINT64 verticesOffset;
+    UINT64 indicesOffset;
+    UINT64 texturesOffset;
+    UINT64 meshGenerationsOffset;    // Per mesh, the asset generation that last rewrote it
+    UINT64 textureGenerationsOffset; // Likewise per texture
+    UINT64 slotsOffset;
+    UINT64 slotStride;
+    INT32 colorSchemes[NUM_COLOR_SCHEMES][6];
+
+    std::atomic<UINT64> assetGeneration; // Odd while assets are being rewritten; 0 => as first published
+    std::atomic<UINT64> latest; // Frame index + 1 of the latest complete snapshot; 0 => none yet
+};
+
+// World matrices follow at SLOT_HEADER_SIZE
+struct SimulationSlot
+{
+    std::atomic<UINT64> sequence; // Odd while being written
+    UINT64 frameIndex;
+};
+
+static_assert(sizeof(std::atomic<UINT64>) == sizeof(UINT64), "Sequence must be lock-free to be shared");
+
+
+namespace {
+
+const UINT32 SIMULATION_BLOCK_MAGIC = 0x53534141; // "AASS"
+const UINT32 SIMULATION_BLOCK_VERSION = 3;
+const UINT32 SLOT_COUNT = 3;
+const UINT64 SLOT_HEADER_SIZE = 64;
+
+std::string MappingName(const std::string& name)
+{
+    return "Local\\" + name;
+}
+
+UINT64 Align64(UINT64 offset)
+{
+    return (offset + 63) & ~UINT64(63);
+}
+
+SimulationSlot* Slot(SimulationBlock* block, UINT64 frameIndex)
+{
+    return (SimulationSlot*)((BYTE*)block + block->slotsOffset + (frameIndex % SLOT_COUNT) * block->slotStride);
+}
+
+const SimulationSlot* Slot(const SimulationBlock* block, UINT64 frameIndex)
+{
+    return Slot(const_cast<SimulationBlock*>(block), frameIndex);
+}
+
+XMMATRIX* SlotWorlds(const SimulationSlot* slot)
+{
+    return (XMMATRIX*)((BYTE*)slot + SLOT_HEADER_SIZE);
+}
+
+std::atomic<UINT64>* AssetGenerations(const SimulationBlock* block, UINT64 offset)
+{
+    return (std::atomic<UINT64>*)((BYTE*)block + offset);
+}
+
+} // namespace
+
+
+SimulationPublisher::SimulationPublisher()
+{
+}
+
+
+SimulationPublisher::~SimulationPublisher()
+{
+    if (mBlock) UnmapViewOfFile(mBlock);
+    if (mMapping) CloseHandle(mMapping);
+}
+
+
+HRESULT SimulationPublisher::Open(const std::string& name, const AsteroidsSimulation& simulation, unsigned int rngSeed)
+{
+    if (simulation.SubdivCount() > MESH_MAX_SUBDIV_LEVELS) return E_INVALIDARG;
+
+    auto pool = simulation.Assets();
+    auto assets = pool->GetLayout();
+    auto meshes = pool->Meshes();
+    auto asteroidCount = simulation.AsteroidCount();
+
+    auto verticesOffset = Align64(sizeof(SimulationBlock));
+    auto indicesOffset = Align64(verticesOffset + assets.vertexCount * sizeof(Vertex));
+    auto texturesOffset = Align64(indicesOffset + assets.indexCount * sizeof(IndexType));
+    auto meshGenerationsOffset = Align64(texturesOffset + assets.textureStride * assets.textureCount);
+    auto textureGenerationsOffset = Align64(meshGenerationsOffset + pool->MeshInstanceCount() * sizeof(UINT64));
+    auto slotsOffset = Align64(textureGenerationsOffset + assets.textureCount * sizeof(UINT64));
+    auto slotStride = Align64(SLOT_HEADER_SIZE + asteroidCount * sizeof(XMMATRIX));
+    auto size = slotsOffset + SLOT_COUNT * slotStride;
+
+    mMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size,
+                                  MappingName(name).c_str());
+    if (!mMapping) return HRESULT_FROM_WIN32(GetLastError());
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(mMapping);
+        mMapping = NULL;
+        return HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS);
+    }
+
+    mBlock = (SimulationBlock*)MapViewOfFile(mMapping, FILE_MAP_WRITE, 0, 0, 0);
+    if (!mBlock) return HRESULT_FROM_WIN32(GetLastError());
+
+    // Mapping is zero filled, so no snapshot is marked as published yet and every asset is at generation 0
+    mBlock->version = SIMULATION_BLOCK_VERSION;
+    mBlock->rngSeed = rngSeed;
+    mBlock->asteroidCount = (UINT32)asteroidCount;
+    mBlock->meshInstanceCount = pool->MeshInstanceCount();
+    mBlock->subdivCount = simulation.SubdivCount();
+    mBlock->textureCount = assets.textureCount;
+    mBlock->slotCount = SLOT_COUNT;
+    mBlock->fieldCount = simulation.FieldCount();
+    std::copy(simulation.Fields(), simulation.Fields() + simulation.FieldCount(), mBlock->fields);
+    mBlock->assets = assets;
+    mBlock->verticesOffset = verticesOffset;
+    mBlock->indicesOffset = indicesOffset;
+    mBlock->texturesOffset = texturesOffset;
+    mBlock->meshGenerationsOffset = meshGenerationsOffset;
+    mBlock->textureGenerationsOffset = textureGenerationsOffset;
+    mBlock->slotsOffset = slotsOffset;
+    mBlock->slotStride = slotStride;
+    memcpy(mBlock->colorSchemes, pool->Params().colorSchemes, sizeof(mBlock->colorSchemes));
+
+    auto base = (BYTE*)mBlock;
+    memcpy(base + verticesOffset, meshes.vertices, meshes.vertexCount * sizeof(Vertex));
+    memcpy(base + indicesOffset, meshes.indices, meshes.indexCount * sizeof(IndexType));
+    memcpy(base + texturesOffset, pool->TextureBuffer(), assets.textureStride * assets.textureCount);
+
+    std::atomic_thread_fence(std::memory_order_release);
+    mBlock->magic = SIMULATION_BLOCK_MAGIC;
+
+    std::cout << "Publishing simulation as '" << name << "' (" << (size >> 20) << " MB)" << std::endl;
+    return S_OK;
+}
+
+
+void SimulationPublisher::Publish(UINT64 frameIndex, const AsteroidsSimulation& simulation)
+{
+    if (!mBlock) return;
+
+    auto slot = Slot(mBlock, frameIndex);
+    auto worlds = SlotWorlds(slot);
+    auto dynamicData = simulation.DynamicData();
+
+    auto sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->frameIndex = frameIndex;
+    for (size_t i = 0; i < mBlock->asteroidCount; ++i) {
+        worlds[i] = dynamicData[i].world;
+    }
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+
+    mBlock->latest.store(frameIndex + 1, std::memory_order_release);
+}
+
+
+void SimulationPublisher::PublishAssets(const AssetChanges& changes, const AsteroidsSimulation& simulation)
+{
+    if (!mBlock) return;
+
+    auto pool = simulation.Assets();
+    auto meshes = pool->Meshes();
+    auto meshVertices = pool->VertexCountPerMesh();
+    auto textureStride = mBlock->assets.textureStride;
+    auto base = (BYTE*)mBlock;
+    auto meshGenerations = AssetGenerations(mBlock, mBlock->meshGenerationsOffset);
+    auto textureGenerations = AssetGenerations(mBlock, mBlock->textureGenerationsOffset);
+
+    // Viewers only use the tags once the count is even again, so tagging with that is safe
+    auto generation = mBlock->assetGeneration.load(std::memory_order_relaxed);
+    mBlock->assetGeneration.store(generation + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (auto m : changes.meshes) {
+        memcpy(base + mBlock->verticesOffset + (UINT64)m * meshVertices * sizeof(Vertex),
+               meshes.vertices + (size_t)m * meshVertices, meshVertices * sizeof(Vertex));
+        meshGenerations[m].store(generation + 2, std::memory_order_relaxed);
+    }
+    for (auto t : changes.textures) {
+        memcpy(base + mBlock->texturesOffset + t * textureStride, pool->TextureBuffer() + t * textureStride,
+               (size_t)textureStride);
+        textureGenerations[t].store(generation + 2, std::memory_order_relaxed);
+    }
+    memcpy(mBlock->colorSchemes, pool->Params().colorSchemes, sizeof(mBlock->colorSchemes));
+
+    mBlock->assetGeneration.store(generation + 2, std::memory_order_release);
+}
+
+
+SimulationViewer::SimulationViewer()
+{
+}
+
+
+SimulationViewer::~SimulationViewer()
+{
+    if (mBlock) UnmapViewOfFile(mBlock);
+    if (mMapping) CloseHandle(mMapping);
+}
+
+
+HRESULT SimulationViewer::Open(const std::string& name, AsteroidsSimulation* simulation, unsigned int rngSeed,
+                               DWORD timeoutMs)
+{
+    // The publisher may still be generating its assets
+    auto startTime = GetTickCount();
+    for (;;) {
+        if (!mMapping) mMapping = OpenFileMappingA(FILE_MAP_READ, FALSE, MappingName(name).c_str());
+        if (mMapping && !mBlock) mBlock = (const SimulationBlock*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+        if (mBlock && *(volatile const UINT32*)&mBlock->magic == SIMULATION_BLOCK_MAGIC) break;
+
+        if (GetTickCount() - startTime >= timeoutMs) {
+            fprintf(stderr, "error: no simulation published as '%s'\n", name.c_str());
+            return HRESULT_FROM_WIN32(ERROR_TIMEOUT);
+        }
+        Sleep(10);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (mBlock->version != SIMULATION_BLOCK_VERSION || mBlock->slotCount != SLOT_COUNT ||
+        mBlock->rngSeed != rngSeed || mBlock->asteroidCount != simulation->AsteroidCount() ||
+        mBlock->meshInstanceCount != simulation->Assets()->MeshInstanceCount() ||
+        mBlock->subdivCount != simulation->SubdivCount() ||
+        mBlock->textureCount != simulation->Assets()->TextureCount() ||
+        mBlock->fieldCount != simulation->FieldCount() ||
+        memcmp(mBlock->fields, simulation->Fields(), simulation->FieldCount() * sizeof(AsteroidField)) != 0) {
+        fprintf(stderr, "error: '%s' is not a compatible simulation\n", name.c_str());
+        return E_FAIL;
+    }
+
+    auto base = (const BYTE*)mBlock;
+    simulation->Assets()->Attach(mBlock->assets, (const Vertex*)(base + mBlock->verticesOffset),
+                                 (const IndexType*)(base + mBlock->indicesOffset), base + mBlock->texturesOffset);
+
+    // If these are being rewritten, the next UpdateAssets sees a later generation and applies them again
+    int colorSchemes[NUM_COLOR_SCHEMES][6];
+    memcpy(colorSchemes, mBlock->colorSchemes, sizeof(colorSchemes));
+    simulation->SetColorSchemes(colorSchemes);
+
+    std::cout << "Viewing simulation '" << name << "'" << std::endl;
+    return S_OK;
+}
+
+
+bool SimulationViewer::Update(AsteroidsSimulation* simulation)
+{
+    if (!mBlock) return false;
+
+    auto latest = mBlock->latest.load(std::memory_order_acquire);
+    if (latest == 0 || latest - 1 == mLastFrameIndex) return false;
+
+    // The copy can only be validated after the fact, so it goes straight to the simulation and is redone
+    // (from the then latest slot) if the publisher lapped us
+    UINT64 before, after, frameIndex;
+    do {
+        auto slot = Slot(mBlock, mBlock->latest.load(std::memory_order_acquire) - 1);
+        before = slot->sequence.load(std::memory_order_acquire);
+        frameIndex = slot->frameIndex;
+        simulation->SetWorldMatrices(SlotWorlds(slot));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = slot->sequence.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    mLastFrameIndex = frameIndex;
+    return true;
+}
+
+
+AssetChanges SimulationViewer::UpdateAssets(AsteroidsSimulation* simulation, bool* outColorsChanged)
+{
+    AssetChanges changes;
+    *outColorsChanged = false;
+    if (!mBlock) return changes;
+
+    // Whatever the publisher starts rewriting from here on is tagged later than generation, so is picked up
+    // by the next call even if torn now
+    auto generation = mBlock->assetGeneration.load(std::memory_order_acquire);
+    if ((generation & 1) || generation == mAssetGeneration) return changes;
+
+    auto meshGenerations = AssetGenerations(mBlock, mBlock->meshGenerationsOffset);
+    auto textureGenerations = AssetGenerations(mBlock, mBlock->textureGenerationsOffset);
+    for (unsigned int m = 0; m < mBlock->meshInstanceCount; ++m) {
+        if (meshGenerations[m].load(std::memory_order_relaxed) > mAssetGeneration) changes.meshes.push_back(m);
+    }
+    for (unsigned int t = 0; t < mBlock->textureCount; ++t) {
+        if (textureGenerations[t].load(std::memory_order_relaxed) > mAssetGeneration) changes.textures.push_back(t);
+    }
+
+    int colorSchemes[NUM_COLOR_SCHEMES][6];
+    memcpy(colorSchemes, mBlock->colorSchemes, sizeof(colorSchemes));
+    *outColorsChanged = simulation->SetColorSchemes(colorSchemes);
+
+    mAssetGeneration = generation;
+    return changes;
+}
@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <windows.h>
+
+#include <string>
+
+#include "simulation.h"
+
+// One process simulates and generates the assets; any number of viewer processes render the same field from
+// their own cameras. Everything lives in a named file mapping ("Local\<name>"):
+// - the meshes, textures and colors, written before the block is marked ready; viewers read them in place. An
+//   asset parameter change rewrites the changed ones under an asset generation count, and tags each with it.
+// - a triple buffer of world matrix snapshots, one sequence lock per slot. The publisher writes the slot after
+//   the latest, so readers only retry if they fall two frames behind.
+// Viewers still pick their own LODs, since those depend on the camera.
+
+#define DEFAULT_SIMULATION_NAME "AsteroidsSimulation"
+
+struct SimulationBlock;
+
+class SimulationPublisher
+{
+public:
+    SimulationPublisher();
+    ~SimulationPublisher();
+
+    // Once the simulation's meshes and textures have been created; rngSeed as given to it and its asset pool
+    HRESULT Open(const std::string& name, const AsteroidsSimulation& simulation, unsigned int rngSeed);
+
+    // After each simulation update; never waits for viewers
+    void Publish(UINT64 frameIndex, const AsteroidsSimulation& simulation);
+
+    // After AsteroidAssets::Regenerate; rewrites the changed meshes and textures, and the colors
+    void PublishAssets(const AssetChanges& changes, const AsteroidsSimulation& simulation);
+
+private:
+    HANDLE mMapping = NULL;
+    SimulationBlock* mBlock = nullptr;
+};
+
+class SimulationViewer
+{
+public:
+    SimulationViewer();
+    ~SimulationViewer(); // simulation must no longer use the attached assets
+
+    // Waits up to timeoutMs for the publisher, then attaches simulation's asset pool (constructed with the same
+    // arguments as the publisher's, as are the fields) to the published assets instead of creating its own
+    HRESULT Open(const std::string& name, AsteroidsSimulation* simulation, unsigned int rngSeed, DWORD timeoutMs);
+
+    // Copies the latest snapshot into simulation; false if there is nothing new
+    bool Update(AsteroidsSimulation* simulation);
+
+    // The meshes and textures republished since the last call, for the caller to re-upload; also applies the
+    // published colors to simulation. Anything rewritten while being uploaded is returned again next time.
+    AssetChanges UpdateAssets(AsteroidsSimulation* simulation, bool* outColorsChanged);
+
+private:
+    HANDLE mMapping = NULL;
+    const SimulationBlock* mBlock = nullptr;
+    UINT64 mLastFrameIndex = ~0ULL;
+    UINT64 mAssetGeneration = 0; // What was last returned by UpdateAssets; Open uploads generation 0
+};
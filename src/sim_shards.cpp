@@ -0,0 +1,280 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "sim_shards.h"
+
+#include <iostream>
+#include <sstream>
+
+// Start of the mapping; the dynamic asteroid data follows at DynamicDataOffset()
+struct ShardBlock
+{
+    UINT32 magic;
+    UINT32 version;
+
+    // AsteroidsSimulation constructor arguments
+    UINT32 rngSeed;
+    UINT32 asteroidCount;
+    UINT32 meshInstanceCount;
+    UINT32 subdivCount;
+    UINT32 textureCount;
+    UINT32 indexOffsets[MESH_MAX_SUBDIV_LEVELS + 2];
+    UINT32 fieldCount;
+    AsteroidField fields[MAX_ASTEROID_FIELDS];
+
+    UINT32 shardCount;
+    UINT32 quit;
+    AsteroidsSimulation::ShardFrame frame;
+    AsteroidsSimulation::ShardResult results[SimulationShards::MAX_SHARDS];
+};
+
+
+namespace {
+
+const UINT32 SHARD_BLOCK_MAGIC = 0x44534141; // "AASD"
+const UINT32 SHARD_BLOCK_VERSION = 2;
+
+std::string EventName(const std::string& name, const char* kind, unsigned int shard)
+{
+    std::ostringstream eventName;
+    eventName << "Local\\" << name << "." << kind << shard;
+    return eventName.str();
+}
+
+size_t DynamicDataOffset()
+{
+    return (sizeof(ShardBlock) + 63) & ~size_t(63);
+}
+
+// First asteroid of the shard; the host and the worker must agree
+size_t ShardStart(const ShardBlock& block, unsigned int shard)
+{
+    return (size_t)block.asteroidCount * shard / block.shardCount;
+}
+
+} // namespace
+
+
+SimulationShards::SimulationShards()
+{
+}
+
+
+SimulationShards::~SimulationShards()
+{
+    Stop();
+}
+
+
+HRESULT SimulationShards::Start(AsteroidsSimulation* simulation, unsigned int rngSeed, unsigned int shardCount)
+{
+    auto hr = StartWorkers(simulation, rngSeed, shardCount);
+    if (FAILED(hr)) Stop();
+    return hr;
+}
+
+
+HRESULT SimulationShards::StartWorkers(AsteroidsSimulation* simulation, unsigned int rngSeed, unsigned int shardCount)
+{
+    auto assets = simulation->Assets();
+    auto asteroidCount = simulation->AsteroidCount();
+    if (shardCount < 1 || shardCount > MAX_SHARDS || shardCount > asteroidCount ||
+        simulation->SubdivCount() > MESH_MAX_SUBDIV_LEVELS) {
+        return E_INVALIDARG;
+    }
+
+    std::ostringstream name;
+    name << "AsteroidsShards." << GetCurrentProcessId();
+
+    auto size = (UINT64)DynamicDataOffset() + asteroidCount * sizeof(AsteroidDynamic);
+    mMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size,
+                                  ("Local\\" + name.str()).c_str());
+    if (!mMapping) return HRESULT_FROM_WIN32(GetLastError());
+    mBlock = (ShardBlock*)MapViewOfFile(mMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!mBlock) return HRESULT_FROM_WIN32(GetLastError());
+
+    mBlock->magic = SHARD_BLOCK_MAGIC;
+    mBlock->version = SHARD_BLOCK_VERSION;
+    mBlock->rngSeed = rngSeed;
+    mBlock->asteroidCount = (UINT32)asteroidCount;
+    mBlock->meshInstanceCount = assets->MeshInstanceCount();
+    mBlock->subdivCount = assets->SubdivCount();
+    mBlock->textureCount = assets->TextureCount();
+    std::copy(assets->IndexOffsets(), assets->IndexOffsets() + assets->SubdivCount() + 2, mBlock->indexOffsets);
+    mBlock->fieldCount = simulation->FieldCount();
+    std::copy(simulation->Fields(), simulation->Fields() + simulation->FieldCount(), mBlock->fields);
+    mBlock->shardCount = shardCount;
+    mBlock->quit = 0;
+
+    // Workers die with the host, however it exits
+    mJob = CreateJobObject(NULL, NULL);
+    JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits = {};
+    limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+    if (!mJob || !SetInformationJobObject(mJob, JobObjectExtendedLimitInformation, &limits, sizeof(limits))) {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    char exePath[MAX_PATH];
+    GetModuleFileNameA(NULL, exePath, MAX_PATH);
+    for (unsigned int s = 0; s < shardCount; ++s) {
+        auto startEvent = CreateEventA(NULL, FALSE, FALSE, EventName(name.str(), "start", s).c_str());
+        auto doneEvent = CreateEventA(NULL, FALSE, FALSE, EventName(name.str(), "done", s).c_str());
+        if (!startEvent || !doneEvent) return HRESULT_FROM_WIN32(GetLastError());
+        mStartEvents.push_back(startEvent);
+        mDoneEvents.push_back(doneEvent);
+
+        std::ostringstream commandLine;
+        commandLine << "\"" << exePath << "\" -sim_worker " << name.str() << " " << s;
+        auto commandLineText = commandLine.str();
+
+        STARTUPINFOA startupInfo = { sizeof(startupInfo) };
+        PROCESS_INFORMATION processInfo = {};
+        if (!CreateProcessA(NULL, &commandLineText[0], NULL, NULL, FALSE, CREATE_SUSPENDED, NULL, NULL,
+                            &startupInfo, &processInfo)) {
+            return HRESULT_FROM_WIN32(GetLastError());
+        }
+        AssignProcessToJobObject(mJob, processInfo.hProcess);
+        ResumeThread(processInfo.hThread);
+        CloseHandle(processInfo.hThread);
+        mProcesses.push_back(processInfo.hProcess);
+    }
+    mCompleted.assign(shardCount, false);
+
+    auto dynamicData = (AsteroidDynamic*)((BYTE*)mBlock + DynamicDataOffset());
+    std::copy(simulation->DynamicData(), simulation->DynamicData() + asteroidCount, dynamicData);
+    simulation->AttachDynamicData(dynamicData);
+    simulation->SetShards(this);
+    mSimulation = simulation;
+
+    std::cout << "Simulating " << asteroidCount << " asteroids in " << shardCount << " worker processes" << std::endl;
+    return S_OK;
+}
+
+
+bool SimulationShards::Run(const AsteroidsSimulation::ShardFrame& frame)
+{
+    mCompleted.assign(mCompleted.size(), false);
+    if (mFailed) return false;
+
+    mBlock->frame = frame;
+    for (auto startEvent : mStartEvents) {
+        SetEvent(startEvent);
+    }
+
+    // Waits for the remaining shards even after a failure, so the caller knows which ones finished
+    for (unsigned int s = 0; s < ShardCount(); ++s) {
+        HANDLE handles[] = { mDoneEvents[s], mProcesses[s] };
+        if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0) {
+            mCompleted[s] = true;
+        } else {
+            fprintf(stderr, "error: simulation worker %u exited; simulating locally\n", s);
+            mFailed = true;
+        }
+    }
+    return !mFailed;
+}
+
+
+void SimulationShards::ShardRange(unsigned int shard, size_t* startIndex, size_t* count) const
+{
+    *startIndex = ShardStart(*mBlock, shard);
+    *count = ShardStart(*mBlock, shard + 1) - *startIndex;
+}
+
+
+const AsteroidsSimulation::ShardResult& SimulationShards::Result(unsigned int shard) const
+{
+    return mBlock->results[shard];
+}
+
+
+void SimulationShards::Stop()
+{
+    if (mSimulation) {
+        // Carry on with the current state
+        auto dynamicData = (AsteroidDynamic*)((BYTE*)mBlock + DynamicDataOffset());
+        mSimulation->SetShards(nullptr);
+        mSimulation->AttachDynamicData(nullptr);
+        auto ownData = const_cast<AsteroidDynamic*>(mSimulation->DynamicData());
+        std::copy(dynamicData, dynamicData + mSimulation->AsteroidCount(), ownData);
+        mSimulation = nullptr;
+    }
+
+    if (mBlock) {
+        mBlock->quit = 1;
+        for (auto startEvent : mStartEvents) SetEvent(startEvent);
+    }
+    if (!mProcesses.empty()) {
+        WaitForMultipleObjects((DWORD)mProcesses.size(), mProcesses.data(), TRUE, 1000);
+    }
+
+    for (auto process : mProcesses) CloseHandle(process);
+    for (auto startEvent : mStartEvents) CloseHandle(startEvent);
+    for (auto doneEvent : mDoneEvents) CloseHandle(doneEvent);
+    mProcesses.clear();
+    mStartEvents.clear();
+    mDoneEvents.clear();
+    mCompleted.clear();
+
+    if (mJob) CloseHandle(mJob); // Kills any stragglers
+    if (mBlock) UnmapViewOfFile(mBlock);
+    if (mMapping) CloseHandle(mMapping);
+    mJob = NULL;
+    mBlock = nullptr;
+    mMapping = NULL;
+}
+
+
+int RunSimulationWorker(const std::string& name, unsigned int shard)
+{
+    auto mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, ("Local\\" + name).c_str());
+    auto block = mapping ? (ShardBlock*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0) : nullptr;
+    if (!block || block->magic != SHARD_BLOCK_MAGIC || block->version != SHARD_BLOCK_VERSION ||
+        shard >= block->shardCount) {
+        fprintf(stderr, "error: no simulation shard %u of '%s'\n", shard, name.c_str());
+        return -1;
+    }
+
+    auto startEvent = OpenEventA(SYNCHRONIZE, FALSE, EventName(name, "start", shard).c_str());
+    auto doneEvent = OpenEventA(EVENT_MODIFY_STATE, FALSE, EventName(name, "done", shard).c_str());
+    if (!startEvent || !doneEvent) {
+        fprintf(stderr, "error: no events for simulation shard %u of '%s'\n", shard, name.c_str());
+        return -1;
+    }
+
+    // Same layout as the host's; only the dynamic data (shared) and index offsets are used
+    auto assets = std::make_shared<AsteroidAssets>(block->rngSeed, block->meshInstanceCount, block->subdivCount,
+                                                   block->textureCount);
+    assets->SetIndexOffsets(block->indexOffsets);
+    AsteroidsSimulation simulation(assets, block->rngSeed, block->fields, block->fieldCount);
+    simulation.AttachDynamicData((AsteroidDynamic*)((BYTE*)block + DynamicDataOffset()));
+
+    size_t startIndex = ShardStart(*block, shard);
+    size_t endIndex = ShardStart(*block, shard + 1);
+
+    for (;;) {
+        WaitForSingleObject(startEvent, INFINITE);
+        if (block->quit) break;
+        simulation.UpdateShard(block->frame, startIndex, endIndex - startIndex, &block->results[shard]);
+        SetEvent(doneEvent);
+    }
+
+    CloseHandle(startEvent);
+    CloseHandle(doneEvent);
+    UnmapViewOfFile(block);
+    CloseHandle(mapping);
+    return 0;
+}
@@ -0,0 +1,72 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <windows.h>
+
+#include <string>
+#include <vector>
+
+#include "simulation.h"
+
+// Runs the simulation update in worker processes (this executable with -sim_worker), each owning a contiguous
+// shard of the asteroids. The dynamic asteroid data lives in a named file mapping ("Local\<name>") that the
+// workers update in place and the renderer reads directly. Each frame the host publishes the frame state and
+// signals each worker's start event, then waits for its done event; the events order the memory accesses.
+// Workers are in a job object that kills them when the host goes away.
+
+struct ShardBlock;
+
+class SimulationShards
+{
+public:
+    enum { MAX_SHARDS = 64 };
+
+    SimulationShards();
+    ~SimulationShards(); // Stops the workers; the simulation goes back to its own copy of the dynamic data
+
+    // After the simulation's meshes have been created. rngSeed (as given to the simulation and its asset pool)
+    // and the fields let the workers lay out identical asteroids.
+    // Moves simulation's dynamic data into the shared mapping and attaches the shards to it.
+    HRESULT Start(AsteroidsSimulation* simulation, unsigned int rngSeed, unsigned int shardCount);
+
+    unsigned int ShardCount() const { return (unsigned int)mProcesses.size(); }
+
+    // One update on every shard; false if a worker has gone away, after which the shards can't be used
+    bool Run(const AsteroidsSimulation::ShardFrame& frame);
+    // Whether the shard's worker finished the last Run; only then is its result valid
+    bool Completed(unsigned int shard) const { return mCompleted[shard]; }
+    const AsteroidsSimulation::ShardResult& Result(unsigned int shard) const;
+    void ShardRange(unsigned int shard, size_t* startIndex, size_t* count) const;
+
+private:
+    HRESULT StartWorkers(AsteroidsSimulation* simulation, unsigned int rngSeed, unsigned int shardCount);
+    void Stop();
+
+    AsteroidsSimulation* mSimulation = nullptr;
+    HANDLE mJob = NULL;
+    HANDLE mMapping = NULL;
+    ShardBlock* mBlock = nullptr;
+    std::vector<HANDLE> mProcesses;
+    std::vector<HANDLE> mStartEvents;
+    std::vector<HANDLE> mDoneEvents;
+    std::vector<bool> mCompleted;
+    bool mFailed = false;
+};
+
+// Worker process main; returns once the host stops the shards
+int RunSimulationWorker(const std::string& name, unsigned int shard);
@@ -16,28 +16,17 @@
 
 #include "simulation.h"
 #include "settings.h"
-#include "texture.h"
+#include "sim_shards.h"
 #include "util.h"
 
 #include <random>
 #include <limits>
+#include <cfloat>
+#include <cstring>
 #include <algorithm>
-#include <iostream>
-#include <ppl.h>
 
 using namespace DirectX;
 
-static int const COLOR_SCHEMES[] = {
-    156, 139, 113,  55,  49,  40,
-    156, 139, 113,  58,  38,  14,
-    156, 139, 113,  98, 101, 104,
-    156, 139, 113, 205, 197, 178,
-    153, 146, 136,  88,  88,  88,
-    189, 181, 164, 148, 108, 102,
-};
-
-static int const NUM_COLOR_SCHEMES = (int) (sizeof(COLOR_SCHEMES) / (6 * sizeof(int)));
-
 static XMVECTOR RandomPointOnSphere(std::mt19937& rng)
 {
     std::normal_distribution<float> dist;
@@ -53,6 +42,9 @@ static XMVECTOR RandomPointOnSphere(std::mt19937& rng)
     // Unreachable
 }
 
+// TODO: This constant should really depend on resolution and/or be configurable...
+static const float MIN_SUBDIV_SIZE_LOG2 = std::log2f(0.0019f);
+
 // From http://guihaire.com/code/?p=1135
 static inline float VeryApproxLog2f(float x)
 {   
@@ -62,28 +54,42 @@ static inline float VeryApproxLog2f(float x)
 }
 
 
-AsteroidsSimulation::AsteroidsSimulation(unsigned int rngSeed, unsigned int asteroidCount,
-                                         unsigned int meshInstanceCount, unsigned int subdivCount,
-                                         unsigned int textureCount)
-    : mAsteroidStatic(asteroidCount)
-    , mAsteroidDynamic(asteroidCount)
-    , mIndexOffsets(subdivCount + 2) // Mesh subdivs are inclusive on both ends and need forward differencing for count
-    , mSubdivCount(subdivCount)
+AsteroidsSimulation::AsteroidsSimulation(std::shared_ptr<AsteroidAssets> assets, unsigned int rngSeed,
+                                         const AsteroidField* fields, unsigned int fieldCount)
+    : mAssets(assets)
+    , mIndexOffsets(assets->IndexOffsets())
+    , mSubdivCount(assets->SubdivCount())
+    , mFields(fields, fields + fieldCount)
 {
-    std::mt19937 rng(rngSeed);
+    assert(fieldCount > 0 && fieldCount <= MAX_ASTEROID_FIELDS);
+
+    for (auto& bin : mLODHistogram) bin = 0;
+    ResetFrameCounters();
+
+    unsigned int asteroidCount = 0;
+    for (auto& field : mFields) {
+        FieldOrbit orbit;
+        orbit.axis = XMVectorSet(0.0f, std::cos(field.tilt), std::sin(field.tilt), 0.0f);
+        orbit.center = XMLoadFloat3(&field.center);
+        orbit.aligned = field.tilt == 0.0f && XMVector3Equal(orbit.center, XMVectorZero());
+        mFieldOrbits.push_back(orbit);
+        asteroidCount += field.asteroidCount;
+    }
+    mAsteroidStatic.resize(asteroidCount);
+    mAsteroidDynamic.resize(asteroidCount);
+    mDynamic = mAsteroidDynamic.data();
 
-    // Create meshes
-    std::cout
-        << "Creating " << meshInstanceCount << " meshes, each with "
-        << subdivCount << " subdivision levels..." << std::endl;
+    auto meshInstanceCount = assets->MeshInstanceCount();
+    auto vertexCountPerMesh = assets->VertexCountPerMesh();
+    auto textureCount = assets->TextureCount();
 
-    CreateAsteroidsFromGeospheres(&mMeshes, mSubdivCount, meshInstanceCount,
-                                  rng(), mIndexOffsets.data(), &mVertexCountPerMesh);
+    std::mt19937 rng(rngSeed);
 
-    CreateTextures(textureCount, rng());
+    // The asset pool draws its generator seeds from the same seed first (see AsteroidAssets)
+    rng();
+    rng();
 
     // Constants
-    std::normal_distribution<float> orbitRadiusDist(SIM_ORBIT_RADIUS, 0.6f * SIM_DISC_RADIUS);
     std::normal_distribution<float> heightDist(0.0f, 0.4f);
     std::uniform_real_distribution<float> angleDist(-XM_PI, XM_PI);
     std::uniform_real_distribution<float> radialVelocityDist(5.0f, 15.0f);
@@ -94,163 +100,426 @@ AsteroidsSimulation::AsteroidsSimulation(unsigned int rngSeed, unsigned int aste
 
     auto instancesPerMesh = std::max(1U, asteroidCount / meshInstanceCount);
 
-    // Approximate SRGB->Linear for colors
-    float linearColorSchemes[NUM_COLOR_SCHEMES * 6];
-    for (int i = 0; i < ARRAYSIZE(linearColorSchemes); ++i) {
-        linearColorSchemes[i] = std::powf((float)COLOR_SCHEMES[i] / 255.0f, 2.2f);
-    }
+    // Create a torus of asteroids per field that spin around the ring; meshes are spread across all the fields
+    unsigned int i = 0;
+    for (unsigned int f = 0; f < fieldCount; ++f) {
+        auto& field = mFields[f];
+        std::normal_distribution<float> orbitRadiusDist(field.orbitRadius, 0.6f * field.discRadius);
+        auto fieldToWorld = XMMatrixRotationX(field.tilt) * XMMatrixTranslationFromVector(mFieldOrbits[f].center);
 
-    // Create a torus of asteroids that spin around the ring
-    for (unsigned int i = 0; i < asteroidCount; ++i) {
-        auto scale = scaleDist(rng);
+        for (unsigned int end = i + field.asteroidCount; i < end; ++i) {
+            auto scale = scaleDist(rng);
 #if SIM_USE_GAMMA_DIST_SCALE
-        scale = scale * 0.3f;
+            scale = scale * 0.3f;
 #endif
-        scale = std::max(scale, SIM_MIN_SCALE);
-        auto scaleMatrix = XMMatrixScaling(scale, scale, scale);
+            scale = std::max(scale, SIM_MIN_SCALE);
+            auto scaleMatrix = XMMatrixScaling(scale, scale, scale);
+
+            auto orbitRadius = orbitRadiusDist(rng);
+            auto discPosY = field.discRadius * heightDist(rng);
+
+            auto disc = XMMatrixTranslation(orbitRadius, discPosY, 0.0f);
+
+            auto positionAngle = angleDist(rng);
+            auto orbit = XMMatrixRotationY(positionAngle);
+
+            auto meshInstance = (unsigned int)(i / instancesPerMesh); // Vcache friendly ordering
+
+            // Static data
+            mAsteroidStatic[i].spinVelocity = spinVelocityDist(rng) / scale; // Smaller asteroids spin faster
+            mAsteroidStatic[i].orbitVelocity = radialVelocityDist(rng) / (scale * orbitRadius); // Smaller asteroids go faster, and use arc length
+            mAsteroidStatic[i].orbitSpeed = std::abs(mAsteroidStatic[i].orbitVelocity * orbitRadius);
+            mAsteroidStatic[i].vertexStart = vertexCountPerMesh * meshInstance;
+            mAsteroidStatic[i].spinAxis = XMVector3Normalize(RandomPointOnSphere(rng));
+            mAsteroidStatic[i].scale = scale;
+            mAsteroidStatic[i].textureIndex = textureIndexDist(rng);
+            mAsteroidStatic[i].field = f;
+
+            mAsteroidStatic[i].colorScheme = ((int)abs(colorSchemeDist(rng))) % NUM_COLOR_SCHEMES;
+
+            // Initialize dynamic data
+            mAsteroidDynamic[i].world = scaleMatrix * disc * orbit * fieldToWorld;
+            mAsteroidDynamic[i].lodSlack = -1.0f;
+            mAsteroidDynamic[i].estimatedPixels = 0.0f;
+
+            assert(mAsteroidStatic[i].scale > 0.0f);
+            assert(mAsteroidStatic[i].orbitVelocity > 0.0f);
+        }
+    }
+
+    memcpy(mColorSchemes, DEFAULT_COLOR_SCHEMES, sizeof(mColorSchemes));
+    UpdateColors();
+}
+
+
+void AsteroidsSimulation::UpdateColors()
+{
+    // Approximate SRGB->Linear for colors
+    float linearColorSchemes[NUM_COLOR_SCHEMES][6];
+    for (int s = 0; s < NUM_COLOR_SCHEMES; ++s) {
+        for (int i = 0; i < 6; ++i) {
+            linearColorSchemes[s][i] = std::powf((float)mColorSchemes[s][i] / 255.0f, 2.2f);
+        }
+    }
+
+    for (auto& asteroid : mAsteroidStatic) {
+        auto c = linearColorSchemes[asteroid.colorScheme];
+        asteroid.surfaceColor = XMFLOAT3(c[0], c[1], c[2]);
+        asteroid.deepColor    = XMFLOAT3(c[3], c[4], c[5]);
+    }
+}
+
+
+bool AsteroidsSimulation::SetColorSchemes(const int schemes[NUM_COLOR_SCHEMES][6])
+{
+    if (memcmp(mColorSchemes, schemes, sizeof(mColorSchemes)) == 0) {
+        return false;
+    }
+    memcpy(mColorSchemes, schemes, sizeof(mColorSchemes));
+    UpdateColors();
+    return true;
+}
+
+
+void AsteroidsSimulation::ResetFrameCounters()
+{
+    for (auto& count : mCounterLODs) count = 0;
+    mCounterDraws = 0;
+    mCounterCulled = 0;
+    mCounterIndices = 0;
+    mCounterPixels = 0;
+}
 
-        auto orbitRadius = orbitRadiusDist(rng);
-        auto discPosY = float(SIM_DISC_RADIUS) * heightDist(rng);
 
-        auto disc = XMMatrixTranslation(orbitRadius, discPosY, 0.0f);
+WorkloadCounters AsteroidsSimulation::FrameCounters() const
+{
+    WorkloadCounters counters;
+    for (int l = 0; l <= MESH_MAX_SUBDIV_LEVELS; ++l) counters.lodCounts[l] = mCounterLODs[l];
+    counters.draws = mCounterDraws;
+    counters.culled = mCounterCulled;
+    counters.indices = mCounterIndices;
+    counters.estimatedPixels = mCounterPixels;
+    return counters;
+}
+
+
+void AsteroidsSimulation::BeginFrame(float frameTime, const Settings& settings, const OrbitCamera& camera)
+{
+    // Per-asteroid choice: step k -> k+1 is taken once the asteroid is 2^(k+1) times the min size
+    float threshold = 1.0f + settings.lodBias;
+
+    if (settings.triangleBudget > 0) {
+        // Only drawn asteroids are binned (see Update)
+        UINT64 drawn = std::min((UINT64)AsteroidCount(), (UINT64)settings.drawBudget);
+        UINT64 triangles = drawn * (mIndexOffsets[1] - mIndexOffsets[0]) / 3;
+        int bin = LOD_HISTOGRAM_BINS;
+        while (bin > 0 && triangles + mLODHistogram[bin - 1] <= settings.triangleBudget) {
+            triangles += mLODHistogram[--bin];
+        }
+        float budgetThreshold = bin == 0 ? -FLT_MAX :
+            bin == LOD_HISTOGRAM_BINS ? FLT_MAX : LOD_HISTOGRAM_MIN + bin / LOD_HISTOGRAM_BINS_PER_LEVEL;
+        threshold = std::max(threshold, budgetThreshold);
+    }
 
-        auto positionAngle = angleDist(rng);
-        auto orbit = XMMatrixRotationY(positionAngle);
+    for (auto& bin : mLODHistogram) bin = 0;
+
+    float pixelsPerRelativeSize = 0.5f * float(settings.renderHeight) * camera.ProjectionScaleY();
+
+    // The slack assumes the same threshold and projection; the budget needs every asteroid's screen size
+    mRecomputeAllLODs = !settings.incrementalLOD || settings.triangleBudget > 0 ||
+                        threshold != mLODThreshold || pixelsPerRelativeSize != mPixelsPerRelativeSize;
+    mCameraTravel = XMVectorGetX(XMVector3Length(XMVectorSubtract(camera.Eye(), mLastCameraEye)));
+    mLastCameraEye = camera.Eye();
+
+    mLODThreshold = threshold;
+    mPixelsPerRelativeSize = pixelsPerRelativeSize;
+
+    ResetFrameCounters();
+
+    mShardedFrame = false;
+    mUnfinishedShards.clear();
+    if (mShards) {
+        ShardFrame frame = {};
+        frame.frameTime = frameTime;
+        XMStoreFloat3(&frame.cameraEye, camera.Eye());
+        frame.lodThreshold = mLODThreshold;
+        frame.pixelsPerRelativeSize = mPixelsPerRelativeSize;
+        frame.cameraTravel = mCameraTravel;
+        frame.recomputeAllLODs = mRecomputeAllLODs;
+        frame.animate = settings.animate;
+        frame.triangleBudget = settings.triangleBudget;
+        frame.drawBudget = settings.drawBudget;
+
+        mShardedFrame = mShards->Run(frame);
+        for (unsigned int s = 0; s < mShards->ShardCount(); ++s) {
+            if (!mShards->Completed(s)) {
+                size_t startIndex, count;
+                mShards->ShardRange(s, &startIndex, &count);
+                mUnfinishedShards.push_back(std::make_pair(startIndex, startIndex + count));
+            } else {
+                auto& result = mShards->Result(s);
+                for (unsigned int l = 0; l <= mSubdivCount; ++l) mCounterLODs[l] += result.counters.lodCounts[l];
+                mCounterDraws += result.counters.draws;
+                mCounterCulled += result.counters.culled;
+                mCounterIndices += result.counters.indices;
+                mCounterPixels += result.counters.estimatedPixels;
+                for (int b = 0; b < LOD_HISTOGRAM_BINS; ++b) mLODHistogram[b] += result.lodHistogram[b];
+            }
+        }
+        if (!mShardedFrame) {
+            // A worker that died partway through its shard has already stepped some of it; those asteroids step
+            // twice this frame. The other shards are not touched again.
+            mShards = nullptr;
+        }
+    }
+}
 
-        auto meshInstance = (unsigned int)(i / instancesPerMesh); // Vcache friendly ordering
 
-        // Static data
-        mAsteroidStatic[i].spinVelocity = spinVelocityDist(rng) / scale; // Smaller asteroids spin faster
-        mAsteroidStatic[i].orbitVelocity = radialVelocityDist(rng) / (scale * orbitRadius); // Smaller asteroids go faster, and use arc length
-        mAsteroidStatic[i].vertexStart = mVertexCountPerMesh * meshInstance;
-        mAsteroidStatic[i].spinAxis = XMVector3Normalize(RandomPointOnSphere(rng));
-        mAsteroidStatic[i].scale = scale;
-        mAsteroidStatic[i].textureIndex = textureIndexDist(rng);
+void AsteroidsSimulation::UpdateShard(const ShardFrame& frame, size_t startIndex, size_t count, ShardResult* outResult)
+{
+    mLODThreshold = frame.lodThreshold;
+    mPixelsPerRelativeSize = frame.pixelsPerRelativeSize;
+    mCameraTravel = frame.cameraTravel;
+    mRecomputeAllLODs = frame.recomputeAllLODs != 0;
+    for (auto& bin : mLODHistogram) bin = 0;
+    ResetFrameCounters();
+
+    Settings settings;
+    settings.animate = frame.animate != 0;
+    settings.triangleBudget = frame.triangleBudget;
+    settings.drawBudget = frame.drawBudget;
+    Update(frame.frameTime, XMLoadFloat3(&frame.cameraEye), settings, startIndex, count);
+
+    outResult->counters = FrameCounters();
+    for (int b = 0; b < LOD_HISTOGRAM_BINS; ++b) outResult->lodHistogram[b] = mLODHistogram[b];
+}
 
-        auto colorScheme = ((int)abs(colorSchemeDist(rng))) % NUM_COLOR_SCHEMES;
-        auto c = linearColorSchemes + 6 * colorScheme;
-        mAsteroidStatic[i].surfaceColor = XMFLOAT3(c[0], c[1], c[2]);
-        mAsteroidStatic[i].deepColor    = XMFLOAT3(c[3], c[4], c[5]);
 
-        // Initialize dynamic data
-        mAsteroidDynamic[i].world = scaleMatrix * disc * orbit;
+void AsteroidsSimulation::RecomputeLODs(const unsigned int* indices, unsigned int count, XMVECTOR cameraEye)
+{
+    auto eyeX = XMVectorSplatX(cameraEye);
+    auto eyeY = XMVectorSplatY(cameraEye);
+    auto eyeZ = XMVectorSplatZ(cameraEye);
+    // subdiv = floor(log2(relative size) - offset + 1), clamped
+    auto offset = XMVectorReplicate(mLODThreshold + MIN_SUBDIV_SIZE_LOG2);
+    auto maxSubdiv = XMVectorReplicate(float(mSubdivCount));
+    auto pixelScale = XMVectorReplicate(mPixelsPerRelativeSize);
+
+    for (unsigned int b = 0; b < count; b += 4) {
+        // Lanes past the end repeat the last asteroid
+        XMFLOAT4A x, y, z, s;
+        for (unsigned int k = 0; k < 4; ++k) {
+            auto i = indices[std::min(b + k, count - 1)];
+            XMFLOAT3 position;
+            XMStoreFloat3(&position, mDynamic[i].world.r[3]);
+            (&x.x)[k] = position.x;
+            (&y.x)[k] = position.y;
+            (&z.x)[k] = position.z;
+            (&s.x)[k] = mAsteroidStatic[i].scale;
+        }
 
-        assert(mAsteroidStatic[i].scale > 0.0f);
-        assert(mAsteroidStatic[i].orbitVelocity > 0.0f);
+        auto dx = XMVectorSubtract(XMLoadFloat4A(&x), eyeX);
+        auto dy = XMVectorSubtract(XMLoadFloat4A(&y), eyeY);
+        auto dz = XMVectorSubtract(XMLoadFloat4A(&z), eyeZ);
+        auto distanceSq = XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz)));
+        auto distanceRcp = XMVectorReciprocalSqrt(distanceSq);
+        auto distance = XMVectorMultiply(distanceSq, distanceRcp);
+        auto scale = XMLoadFloat4A(&s);
+        auto relativeSize = XMVectorMultiply(scale, distanceRcp);
+
+        auto subdivFloat = XMVectorAdd(XMVectorSubtract(XMVectorLog2(relativeSize), offset), XMVectorSplatOne());
+        auto subdiv = XMVectorFloor(XMVectorClamp(subdivFloat, XMVectorZero(), maxSubdiv));
+
+        // Up a level at or nearer than this, down a level beyond twice it
+        auto nearer = XMVectorMultiply(scale, XMVectorExp2(XMVectorNegate(XMVectorAdd(subdiv, offset))));
+        auto farther = XMVectorAdd(nearer, nearer);
+        nearer = XMVectorSelect(nearer, XMVectorZero(), XMVectorGreaterOrEqual(subdiv, maxSubdiv));
+        farther = XMVectorSelect(farther, XMVectorReplicate(FLT_MAX), XMVectorLessOrEqual(subdiv, XMVectorZero()));
+        auto slack = XMVectorMax(XMVectorZero(),
+            XMVectorMin(XMVectorSubtract(distance, nearer), XMVectorSubtract(farther, distance)));
+
+        auto radius = XMVectorMultiply(relativeSize, pixelScale);
+        auto pixels = XMVectorMultiply(XMVectorReplicate(XM_PI), XMVectorMultiply(radius, radius));
+
+        XMFLOAT4A subdivs, slacks, pixelCounts;
+        XMStoreFloat4A(&subdivs, subdiv);
+        XMStoreFloat4A(&slacks, slack);
+        XMStoreFloat4A(&pixelCounts, pixels);
+        for (unsigned int k = 0; k < std::min(4U, count - b); ++k) {
+            auto& dynamicData = mDynamic[indices[b + k]];
+            auto level = (unsigned int)(&subdivs.x)[k];
+            dynamicData.subdiv = level;
+            dynamicData.indexStart = mIndexOffsets[level];
+            dynamicData.indexCount = mIndexOffsets[level + 1] - dynamicData.indexStart;
+            dynamicData.lodSlack = (&slacks.x)[k];
+            dynamicData.estimatedPixels = (&pixelCounts.x)[k];
+        }
     }
 }
 
 
 void AsteroidsSimulation::Update(float frameTime, DirectX::XMVECTOR cameraEye, const Settings& settings,
                                  size_t startIndex, size_t count)
+{
+    if (mShardedFrame) return;
+
+    if (!mUnfinishedShards.empty()) {
+        size_t last = count ? startIndex + count : AsteroidCount();
+        for (auto& shard : mUnfinishedShards) {
+            size_t first = std::max(startIndex, shard.first);
+            size_t end = std::min(last, shard.second);
+            if (first < end) UpdateRange(frameTime, cameraEye, settings, first, end - first);
+        }
+        return;
+    }
+
+    UpdateRange(frameTime, cameraEye, settings, startIndex, count);
+}
+
+
+void AsteroidsSimulation::UpdateRange(float frameTime, DirectX::XMVECTOR cameraEye, const Settings& settings,
+                                      size_t startIndex, size_t count)
 {
     bool animate = settings.animate;
 
-    // TODO: This constant should really depend on resolution and/or be configurable...
-    static const float minSubdivSizeLog2 = std::log2f(0.0019f);
+    // Asteroids whose slack runs out are batched up for RecomputeLODs
+    bool incremental = !mRecomputeAllLODs;
+    unsigned int recompute[LOD_RECOMPUTE_BATCH];
+    unsigned int recomputeCount = 0;
+
+    // Local histogram, merged once at the end. Asteroids past the draw budget don't add triangles, so only
+    // the drawn ones are binned, four at a time.
+    bool buildHistogram = settings.triangleBudget > 0;
+    unsigned int histogram[LOD_HISTOGRAM_BINS];
+    unsigned int stepTriangles[MESH_MAX_SUBDIV_LEVELS];
+    XMFLOAT4A binLODValues;
+    unsigned int binCount = 0;
+    if (buildHistogram) {
+        memset(histogram, 0, sizeof(histogram));
+        for (unsigned int k = 0; k < mSubdivCount; ++k) {
+            stepTriangles[k] = (mIndexOffsets[k + 2] - mIndexOffsets[k + 1] - (mIndexOffsets[k + 1] - mIndexOffsets[k])) / 3;
+        }
+    }
 
-    size_t last = count ? startIndex + count : mAsteroidDynamic.size();
+    size_t last = count ? startIndex + count : AsteroidCount();
     for (size_t i = startIndex; i < last; ++i) {
         const AsteroidStatic& staticData = mAsteroidStatic[i];
-        AsteroidDynamic& dynamicData = mAsteroidDynamic[i];
+        AsteroidDynamic& dynamicData = mDynamic[i];
 
         if (animate) {
+            auto& fieldOrbit = mFieldOrbits[staticData.field];
             auto orbit = XMMatrixRotationY(staticData.orbitVelocity * frameTime);
+            if (!fieldOrbit.aligned) {
+                // About the field's axis through its center: p' = (p - c) R + c
+                orbit = XMMatrixRotationNormal(fieldOrbit.axis, staticData.orbitVelocity * frameTime);
+                orbit.r[3] = XMVectorSetW(XMVectorSubtract(fieldOrbit.center,
+                                                           XMVector3TransformNormal(fieldOrbit.center, orbit)), 1.0f);
+            }
             auto spin = XMMatrixRotationNormal(staticData.spinAxis, staticData.spinVelocity * frameTime);
             dynamicData.world = spin * dynamicData.world * orbit;
         }
 
+        if (incremental) {
+            // Distance to the camera changes by at most the camera's plus the asteroid's travel
+            dynamicData.lodSlack -= mCameraTravel + (animate ? staticData.orbitSpeed * frameTime : 0.0f);
+            if (dynamicData.lodSlack < 0.0f) {
+                recompute[recomputeCount++] = (unsigned int)i;
+                if (recomputeCount == LOD_RECOMPUTE_BATCH) {
+                    RecomputeLODs(recompute, recomputeCount, cameraEye);
+                    recomputeCount = 0;
+                }
+            }
+            continue;
+        }
+
         // Pick LOD based on approx screen area - can be very approximate
         auto position = dynamicData.world.r[3];
         auto distanceToEyeRcp = XMVectorGetX(XMVector3ReciprocalLengthEst(XMVectorSubtract(cameraEye, position)));
         // Add one subdiv for each factor of 2 past min
         auto relativeScreenSizeLog2 = VeryApproxLog2f(staticData.scale * distanceToEyeRcp);
-        float subdivFloat = std::max(0.0f, relativeScreenSizeLog2 - minSubdivSizeLog2);
-        auto subdiv = std::min(mSubdivCount, (unsigned int)subdivFloat);
+        float lodValue = relativeScreenSizeLog2 - MIN_SUBDIV_SIZE_LOG2;
+        // Steps k with lodValue - k >= threshold; threshold = 1 gives floor(lodValue)
+        float subdivFloat = std::min(float(mSubdivCount), std::max(0.0f, lodValue - mLODThreshold + 1.0f));
+        auto subdiv = (unsigned int)subdivFloat;
+
+        if (buildHistogram && i < settings.drawBudget) {
+            (&binLODValues.x)[binCount++] = lodValue;
+            if (binCount == 4) {
+                BinLODSteps(binLODValues, binCount, stepTriangles, histogram);
+                binCount = 0;
+            }
+        }
 
         // TODO: Ignore/cull/force lowest subdiv if offscreen?
         
+        dynamicData.subdiv = subdiv;
         dynamicData.indexStart = mIndexOffsets[subdiv];
         dynamicData.indexCount = mIndexOffsets[subdiv+1] - dynamicData.indexStart;
-    }
-}
 
-
-void AsteroidsSimulation::CreateTextures(unsigned int textureCount, unsigned int rngSeed)
-{
-    mTextureDim = TEXTURE_DIM;
-    mTextureCount = textureCount;
-    mTextureArraySize = 3;
-    {
-        DWORD msbIndex = 0;
-        auto result = _BitScanReverse(&msbIndex, mTextureDim);
-        assert(result); // Should only fail if mTextureDim = 0
-        mTextureMipLevels = msbIndex + 1;
+        float radius = staticData.scale * distanceToEyeRcp * mPixelsPerRelativeSize;
+        dynamicData.estimatedPixels = XM_PI * radius * radius;
+        dynamicData.lodSlack = 0.0f; // Recomputed exactly as soon as anything moves
     }
 
-    assert((mTextureDim & (mTextureDim-1)) == 0); // Must be pow2 currently; we don't handle wacky mip chains
-
-    std::cout
-        << "Creating " << textureCount << " "
-        << mTextureDim << "x" << mTextureDim << " textures..." << std::endl;
-    
-    // Allocate space
-    UINT texelSizeInBytes = 4; // RGBA8
-    UINT extraSpaceForMips = 2;
-    UINT totalTextureSizeInBytes = texelSizeInBytes * mTextureDim * mTextureDim * mTextureArraySize * extraSpaceForMips;
-    totalTextureSizeInBytes = Align(totalTextureSizeInBytes, 64U); // Avoid false sharing
-
-    mTextureDataBuffer.resize(totalTextureSizeInBytes * textureCount);
-    mTextureSubresources.resize(mTextureArraySize * mTextureMipLevels * textureCount);
-    
-    // Parallel over textures
-    std::vector<unsigned int> rngSeeds(textureCount);
-    {
-        std::mt19937 seeds;
-        for (auto &i : rngSeeds) i = seeds();
+    if (recomputeCount) {
+        RecomputeLODs(recompute, recomputeCount, cameraEye);
+    }
+    if (binCount) {
+        BinLODSteps(binLODValues, binCount, stepTriangles, histogram);
     }
 
-    concurrency::parallel_for(UINT(0), textureCount, [&](UINT t) {
-        std::mt19937 rng(rngSeeds[t]);
-        auto randomNoise = std::uniform_real_distribution<float>(0.0f, 10000.0f);
-        auto randomNoiseScale = std::uniform_real_distribution<float>(100, 150);
-        auto randomPersistence = std::normal_distribution<float>(0.9f, 0.2f);
+    // Asteroids are drawn in order up to the budget
+    unsigned int lodCounts[MESH_MAX_SUBDIV_LEVELS + 1] = {};
+    UINT64 indices = 0;
+    double pixels = 0.0;
+    size_t drawEnd = std::min(last, std::max(startIndex, (size_t)settings.drawBudget));
+    for (size_t i = startIndex; i < drawEnd; ++i) {
+        const AsteroidDynamic& dynamicData = mDynamic[i];
+        ++lodCounts[dynamicData.subdiv];
+        indices += dynamicData.indexCount;
+        pixels += dynamicData.estimatedPixels;
+    }
 
-        BYTE* data = mTextureDataBuffer.data() + t * totalTextureSizeInBytes;
-        for (UINT a = 0; a < mTextureArraySize; ++a) {
-            for (UINT m = 0; m < mTextureMipLevels; ++m) {
-                auto width  = mTextureDim >> m;
-                auto height = mTextureDim >> m;
+    for (unsigned int l = 0; l <= mSubdivCount; ++l) {
+        if (lodCounts[l]) mCounterLODs[l] += lodCounts[l];
+    }
+    mCounterDraws += (unsigned int)(drawEnd - startIndex);
+    mCounterCulled += (unsigned int)(last - drawEnd);
+    mCounterIndices += indices;
+    mCounterPixels += (UINT64)pixels;
+
+    if (buildHistogram) {
+        for (int b = 0; b < LOD_HISTOGRAM_BINS; ++b) {
+            if (histogram[b]) mLODHistogram[b] += histogram[b];
+        }
+    }
+}
 
-                D3D11_SUBRESOURCE_DATA initialData = {};
-                initialData.pSysMem = data;
-                initialData.SysMemPitch = width * texelSizeInBytes;
-                mTextureSubresources[SubresourceIndex(t, a, m)] = initialData;
 
-                data += initialData.SysMemPitch * height;
-            }
+void AsteroidsSimulation::BinLODSteps(const XMFLOAT4A& lodValues, unsigned int count, const unsigned int* stepTriangles,
+                                      unsigned int* histogram) const
+{
+    // Step k of each asteroid goes in bin (lodValue - k - LOD_HISTOGRAM_MIN) * LOD_HISTOGRAM_BINS_PER_LEVEL
+    auto binsPerLevel = XMVectorReplicate(LOD_HISTOGRAM_BINS_PER_LEVEL);
+    auto firstBin = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4A(&lodValues), XMVectorReplicate(LOD_HISTOGRAM_MIN)),
+                                     binsPerLevel);
+    auto maxBin = XMVectorReplicate(float(LOD_HISTOGRAM_BINS - 1));
+
+    for (unsigned int k = 0; k < mSubdivCount; ++k) {
+        auto bin = XMVectorClamp(XMVectorSubtract(firstBin, XMVectorMultiply(XMVectorReplicate(float(k)), binsPerLevel)),
+                                 XMVectorZero(), maxBin);
+        XMINT4 bins;
+        XMStoreSInt4(&bins, XMConvertVectorFloatToInt(bin, 0));
+        for (unsigned int l = 0; l < count; ++l) {
+            histogram[(&bins.x)[l]] += stepTriangles[k];
         }
+    }
+}
 
-        // Use same parameters for each of the tri-planar projection planes/cube map faces/etc.
-        float noiseScale = randomNoiseScale(rng) / float(mTextureDim);
-        float persistence = randomPersistence(rng);
-        float strength = 1.5f;
-
-        for (UINT a = 0; a < mTextureArraySize; ++a) {
-            float redScale   = 255.0f;
-            float greenScale = 255.0f;
-            float blueScale  = 255.0f;
-
-            // DEBUG colors
-#if 0
-            redScale   = t & 1 ? 255.0f : 0.0f;
-            greenScale = t & 2 ? 255.0f : 0.0f;
-            blueScale  = t & 4 ? 255.0f : 0.0f;
-#endif
 
-            FillNoise2D_RGBA8(&mTextureSubresources[SubresourceIndex(t, a)], mTextureDim, mTextureDim, mTextureMipLevels,
-                              randomNoise(rng), persistence, noiseScale, strength,
-                              redScale, greenScale, blueScale);
-        }
-    }); // parallel_for
+void AsteroidsSimulation::SetWorldMatrices(const XMMATRIX* worlds)
+{
+    for (size_t i = 0; i < AsteroidCount(); ++i) {
+        mDynamic[i].world = worlds[i];
+    }
 }
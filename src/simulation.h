@@ -16,13 +16,14 @@
 
 #pragma once
 
-#include <d3d11.h> // For D3D11_SUBRESOURCE_DATA
 #include <DirectXMath.h>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <memory>
 #include <random>
 
-#include "mesh.h"
+#include "asteroid_assets.h"
 #include "settings.h"
 
 // We may want to ISPC-ify this down the road and just let it own the data structure in AoSoA format or similar
@@ -33,8 +34,43 @@ struct AsteroidDynamic
     // These depend on chosen subdiv level, hence are not constant
     unsigned int indexStart;
     unsigned int indexCount;
+    unsigned int subdiv;
+    float lodSlack;        // Distance the asteroid and camera may still move before the LOD could change
+    float estimatedPixels; // When the LOD was last computed
 };
 
+// What a frame submitted, for correlating frame time with workload
+struct WorkloadCounters
+{
+    unsigned int lodCounts[MESH_MAX_SUBDIV_LEVELS + 1]; // Drawn asteroids per subdiv level
+    unsigned int draws;
+    unsigned int culled;     // Not drawn: over the draw budget (there is no visibility culling)
+    UINT64 indices;          // Drawn asteroids only
+    UINT64 estimatedPixels;  // Projected sphere areas of drawn asteroids; ignores the frustum and overlap
+};
+
+// A ring of asteroids orbiting its axis. The axis is the field's y axis: world y tilted about x, through center.
+struct AsteroidField
+{
+    unsigned int asteroidCount;
+    float orbitRadius;
+    float discRadius;
+    float tilt; // Radians
+    DirectX::XMFLOAT3 center;
+};
+
+enum { MAX_ASTEROID_FIELDS = 16 };
+
+// The original single belt
+inline AsteroidField DefaultAsteroidField(unsigned int asteroidCount)
+{
+    AsteroidField field = { asteroidCount, SIM_ORBIT_RADIUS, SIM_DISC_RADIUS, 0.0f, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f) };
+    return field;
+}
+
+// Asteroid meshes (noise, craters and all) stay within this many times AsteroidStatic::scale of their center
+static const float ASTEROID_BOUNDING_SCALE = 2.0f;
+
 struct AsteroidStatic
 {
     DirectX::XMFLOAT3 surfaceColor;
@@ -43,52 +79,150 @@ struct AsteroidStatic
     float scale;
     float spinVelocity;
     float orbitVelocity;
+    float orbitSpeed; // Distance per second (orbitVelocity * orbit radius)
     unsigned int vertexStart;
     unsigned int textureIndex;
+    unsigned int field;
+    unsigned int colorScheme; // Of AssetParams::colorSchemes; picks surfaceColor and deepColor
 };
 
+class SimulationShards;
+
 class AsteroidsSimulation
 {
 private:
     // NOTE: Memory could be optimized further for efficient cache traversal, etc.
     std::vector<AsteroidStatic> mAsteroidStatic;
     std::vector<AsteroidDynamic> mAsteroidDynamic;
+    AsteroidDynamic* mDynamic; // mAsteroidDynamic, or memory shared with shard workers
 
-    Mesh mMeshes;
-    std::vector<unsigned int> mIndexOffsets;
-    unsigned int mSubdivCount;
-    unsigned int mVertexCountPerMesh;
+    // Sharded update: BeginFrame runs the whole frame's Update in the worker processes
+    SimulationShards* mShards = nullptr;
+    bool mShardedFrame = false;
+    // [start, end) of the shards whose worker went away during this frame's run; Update steps only these
+    std::vector<std::pair<size_t, size_t>> mUnfinishedShards;
 
-    unsigned int mTextureDim;
-    unsigned int mTextureCount;
-    unsigned int mTextureArraySize;
-    unsigned int mTextureMipLevels;
-    std::vector<BYTE> mTextureDataBuffer;
-    std::vector<D3D11_SUBRESOURCE_DATA> mTextureSubresources;
+    // Asteroids refer to meshes and textures in the pool by index
+    std::shared_ptr<AsteroidAssets> mAssets;
+    const unsigned int* mIndexOffsets; // Owned by mAssets
+    unsigned int mSubdivCount;
 
-    unsigned int SubresourceIndex(unsigned int texture, unsigned int arrayElement = 0, unsigned int mip = 0)
+    // Asteroids of each field are contiguous, in field order
+    struct FieldOrbit
     {
-        return mip + mTextureMipLevels * (arrayElement + mTextureArraySize * texture);
-    }
+        DirectX::XMVECTOR axis;
+        DirectX::XMVECTOR center;
+        bool aligned; // Orbits the world y axis through the origin
+    };
+    std::vector<AsteroidField> mFields;
+    std::vector<FieldOrbit> mFieldOrbits;
+
+    int mColorSchemes[NUM_COLOR_SCHEMES][6];
+    void UpdateColors();
+
+    // Triangle budget LOD: each possible refinement step (subdiv k -> k+1 of one asteroid) is binned by its
+    // priority, screen size log2 - k, weighted by the triangles it adds. Refinements are taken in priority order
+    // until the budget is spent, i.e. every step at or above a threshold.
+    enum { LOD_HISTOGRAM_BINS = 512 };
+    static constexpr float LOD_HISTOGRAM_MIN = -16.0f;
+    static constexpr float LOD_HISTOGRAM_BINS_PER_LEVEL = 16.0f;
+    std::atomic<unsigned int> mLODHistogram[LOD_HISTOGRAM_BINS];
+    float mLODThreshold = 1.0f;
+
+    // WorkloadCounters for the current frame; Update merges each range's counts with one atomic add per field
+    std::atomic<unsigned int> mCounterLODs[MESH_MAX_SUBDIV_LEVELS + 1];
+    std::atomic<unsigned int> mCounterDraws;
+    std::atomic<unsigned int> mCounterCulled;
+    std::atomic<UINT64> mCounterIndices;
+    std::atomic<UINT64> mCounterPixels;
+    float mPixelsPerRelativeSize = 0.0f; // Projected radius in pixels = relative size * this
+
+    // Incremental LOD: each asteroid's LOD is only recomputed once its slack (see AsteroidDynamic) runs out
+    enum { LOD_RECOMPUTE_BATCH = 256 };
+    bool mRecomputeAllLODs = true;
+    DirectX::XMVECTOR mLastCameraEye = DirectX::XMVectorZero();
+    float mCameraTravel = 0.0f;
+
+    // Exact LODs and slack for the given asteroids, four at a time
+    void RecomputeLODs(const unsigned int* indices, unsigned int count, DirectX::XMVECTOR cameraEye);
+
+    // Adds the refinement steps of count (<= 4) asteroids to a histogram; stepTriangles[k] is what step k adds
+    void BinLODSteps(const DirectX::XMFLOAT4A& lodValues, unsigned int count, const unsigned int* stepTriangles,
+                     unsigned int* histogram) const;
+
+    // Update's work on the given range, whoever owns it
+    void UpdateRange(float frameTime, DirectX::XMVECTOR cameraEye, const Settings& settings,
+                     size_t startIndex, size_t count);
+
+    void ResetFrameCounters();
 
-    void CreateTextures(unsigned int textureCount, unsigned int rngSeed);
-    
 public:
-    AsteroidsSimulation(unsigned int rngSeed, unsigned int asteroidCount,
-                        unsigned int meshInstanceCount, unsigned int subdivCount,
-                        unsigned int textureCount);
+    // What Update depends on besides the asteroids, as set up by BeginFrame; sent to the shard workers
+    struct ShardFrame
+    {
+        float frameTime;
+        DirectX::XMFLOAT3 cameraEye;
+        float lodThreshold;
+        float pixelsPerRelativeSize;
+        float cameraTravel;
+        UINT32 recomputeAllLODs;
+        UINT32 animate;
+        UINT32 triangleBudget;
+        UINT32 drawBudget;
+    };
 
-    const Mesh* Meshes() { return &mMeshes; }
-    const D3D11_SUBRESOURCE_DATA* TextureData(unsigned int textureIndex)
+    // What a shard's Update adds to the frame's counters and LOD histogram
+    struct ShardResult
     {
-        return mTextureSubresources.data() + SubresourceIndex(textureIndex);
-    }
+        WorkloadCounters counters;
+        UINT32 lodHistogram[LOD_HISTOGRAM_BINS];
+    };
+
+    // Lays out the asteroids of every field over the pool's meshes and textures, which needn't have been
+    // generated yet; they must be by the first Update. fieldCount <= MAX_ASTEROID_FIELDS.
+    AsteroidsSimulation(std::shared_ptr<AsteroidAssets> assets, unsigned int rngSeed,
+                        const AsteroidField* fields, unsigned int fieldCount);
+
+    AsteroidAssets* Assets() const { return mAssets.get(); }
+    const AsteroidField* Fields() const { return mFields.data(); }
+    unsigned int FieldCount() const { return (unsigned int)mFields.size(); }
 
     const AsteroidStatic* StaticData() const { return mAsteroidStatic.data(); }
-    const AsteroidDynamic* DynamicData() const { return mAsteroidDynamic.data(); }
+    const AsteroidDynamic* DynamicData() const { return mDynamic; }
+    size_t AsteroidCount() const { return mAsteroidStatic.size(); }
+    unsigned int SubdivCount() const { return mSubdivCount; }
+
+    // sRGB surface and deep colors (see AssetParams); returns whether anything changed. Renderers that bake the
+    // colors into their constants must then be told (e.g. Asteroids::UpdateStaticData in the D3D12 workload).
+    bool SetColorSchemes(const int schemes[NUM_COLOR_SCHEMES][6]);
+
+    // Keeps the dynamic data in the given (shared) memory from now on; null => back to our own copy.
+    // The caller copies the current contents across.
+    void AttachDynamicData(AsteroidDynamic* dynamicData)
+    {
+        mDynamic = dynamicData ? dynamicData : mAsteroidDynamic.data();
+    }
+
+    // See sim_shards.h; null => update locally again
+    void SetShards(SimulationShards* shards) { mShards = shards; }
+
+    // In a shard worker: Update for the range with the host's frame state
+    void UpdateShard(const ShardFrame& frame, size_t startIndex, size_t count, ShardResult* outResult);
+
+    // Complete once every Update for the frame has returned
+    WorkloadCounters FrameCounters() const;
+
+    // Transforms computed elsewhere; then Update with settings.animate off only picks the LODs
+    void SetWorldMatrices(const DirectX::XMMATRIX* worlds);
+
+    // Once per frame before any Update. Picks the LOD threshold for settings.triangleBudget from the previous
+    // frame's histogram (so the budget lags a frame behind the camera) and resets the workload counters.
+    // With shards, also runs the frame's update in the workers and waits for them.
+    void BeginFrame(float frameTime, const Settings& settings, const OrbitCamera& camera);
 
     // Can optionall provide a range of asteroids to update; count = 0 => to the end
-    // This is useful for multithreading
+    // This is useful for multithreading. Does nothing if BeginFrame already updated the shards, and only steps
+    // the shards that didn't finish if a worker went away.
     void Update(float frameTime, DirectX::XMVECTOR cameraEye, const Settings& settings,
                 size_t startIndex = 0, size_t count = 0);
 };
@@ -0,0 +1,331 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "starfield.h"
+#include "noise.h"
+#include "dds.h"
+
+#include <ppl.h>
+
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+// Bump if the output changes so stale caches are not picked up
+const UINT STARFIELD_VERSION = 1;
+
+const UINT TILE_SIZE = 64;
+const float STAR_SIGMA_TEXELS_AT_1024 = 0.6f;
+const float FAINTEST_MAGNITUDE = 8.0f;
+const float BRIGHTEST_MAGNITUDE = -1.0f;
+
+struct Star
+{
+    float u;        // Face coordinates in texels
+    float v;
+    float radius;   // Footprint, texels
+    float twoSigmaSq;
+    float r, g, b;  // Linear, already scaled by flux
+};
+
+
+// Direction through texel coordinates s, t in [-1, 1] of a D3D cube face
+inline void CubeFaceDirection(UINT face, float s, float t, float* x, float* y, float* z)
+{
+    switch (face) {
+    case 0: *x =  1.0f; *y = -t;    *z = -s;    break; // +X
+    case 1: *x = -1.0f; *y = -t;    *z =  s;    break; // -X
+    case 2: *x =  s;    *y =  1.0f; *z =  t;    break; // +Y
+    case 3: *x =  s;    *y = -1.0f; *z = -t;    break; // -Y
+    case 4: *x =  s;    *y = -t;    *z =  1.0f; break; // +Z
+    default:*x = -s;    *y = -t;    *z = -1.0f; break; // -Z
+    }
+}
+
+
+// Inverse of the above for the face the direction hits
+inline UINT CubeFaceFromDirection(float x, float y, float z, float* s, float* t)
+{
+    float ax = std::abs(x), ay = std::abs(y), az = std::abs(z);
+    if (ax >= ay && ax >= az) {
+        if (x > 0.0f) { *s = -z / ax; *t = -y / ax; return 0; }
+        else          { *s =  z / ax; *t = -y / ax; return 1; }
+    } else if (ay >= az) {
+        if (y > 0.0f) { *s =  x / ay; *t =  z / ay; return 2; }
+        else          { *s =  x / ay; *t = -z / ay; return 3; }
+    } else {
+        if (z > 0.0f) { *s =  x / az; *t = -y / az; return 4; }
+        else          { *s = -x / az; *t = -y / az; return 5; }
+    }
+}
+
+
+// Normalized linear RGB of a blackbody at the given temperature; Tanner Helland's fit of the sRGB curve
+void BlackbodyColor(float kelvin, float* r, float* g, float* b)
+{
+    float t = kelvin / 100.0f;
+    float sr, sg, sb;
+    if (t <= 66.0f) {
+        sr = 255.0f;
+        sg = 99.4708025861f * std::log(t) - 161.1195681661f;
+        sb = t <= 19.0f ? 0.0f : 138.5177312231f * std::log(t - 10.0f) - 305.0447927307f;
+    } else {
+        sr = 329.698727446f * std::pow(t - 60.0f, -0.1332047592f);
+        sg = 288.1221695283f * std::pow(t - 60.0f, -0.0755148492f);
+        sb = 255.0f;
+    }
+    *r = std::pow(std::min(std::max(sr, 0.0f), 255.0f) / 255.0f, 2.2f);
+    *g = std::pow(std::min(std::max(sg, 0.0f), 255.0f) / 255.0f, 2.2f);
+    *b = std::pow(std::min(std::max(sb, 0.0f), 255.0f) / 255.0f, 2.2f);
+}
+
+
+inline BYTE LinearToSRGB8(float c)
+{
+    c = std::min(std::max(c, 0.0f), 1.0f);
+    return (BYTE)(std::pow(c, 1.0f / 2.2f) * 255.0f + 0.5f);
+}
+
+
+void LayoutMipChain(UINT faceSize, TextureMipChain* chain)
+{
+    DWORD msbIndex = 0;
+    _BitScanReverse(&msbIndex, faceSize);
+
+    chain->width = faceSize;
+    chain->height = faceSize;
+    chain->arraySize = 6;
+    chain->mipLevels = msbIndex + 1;
+
+    size_t faceBytes = 0;
+    for (UINT m = 0; m < chain->mipLevels; ++m) {
+        faceBytes += 4 * (size_t)(faceSize >> m) * (faceSize >> m);
+    }
+    chain->generatedData.resize(faceBytes * chain->arraySize);
+    chain->subresources.resize(chain->arraySize * chain->mipLevels);
+
+    BYTE* data = chain->generatedData.data();
+    for (UINT a = 0; a < chain->arraySize; ++a) {
+        for (UINT m = 0; m < chain->mipLevels; ++m) {
+            auto& subresource = chain->subresources[a * chain->mipLevels + m];
+            subresource.pSysMem = data;
+            subresource.SysMemPitch = 4 * (faceSize >> m);
+            subresource.SysMemSlicePitch = subresource.SysMemPitch * (faceSize >> m);
+            data += subresource.SysMemSlicePitch;
+        }
+    }
+}
+
+
+HRESULT WriteMipChainDDS(const std::string& fileName, const TextureMipChain& chain)
+{
+    DDS_HEADER header = {};
+    header.dwSize = sizeof(DDS_HEADER);
+    header.dwFlags = DDS_HEADER_FLAGS_TEXTURE | DDS_HEADER_FLAGS_MIPMAP | DDS_HEADER_FLAGS_PITCH;
+    header.dwWidth = chain.width;
+    header.dwHeight = chain.height;
+    header.dwPitchOrLinearSize = 4 * chain.width;
+    header.dwMipMapCount = chain.mipLevels;
+    header.ddspf = DDSPF_A8R8G8B8;
+    header.dwCaps = DDS_SURFACE_FLAGS_TEXTURE | DDS_SURFACE_FLAGS_MIPMAP | DDS_SURFACE_FLAGS_CUBEMAP;
+    header.dwCaps2 = DDS_CUBEMAP_ALLFACES;
+
+    // Face-major, then mips; same order as the chain
+    std::ofstream file(fileName, std::ios::binary);
+    DWORD magic = DDS_MAGIC;
+    file.write((const char*)&magic, sizeof(magic));
+    file.write((const char*)&header, sizeof(header));
+    for (auto& subresource : chain.subresources) {
+        file.write((const char*)subresource.pSysMem, subresource.SysMemSlicePitch);
+    }
+    file.close();
+
+    return file ? S_OK : E_FAIL;
+}
+
+} // namespace
+
+
+std::string StarfieldCacheFileName(const StarfieldParams& params)
+{
+    std::ostringstream name;
+    name << "starfield_v" << STARFIELD_VERSION << "_" << params.faceSize << "_" << params.seed << "_" << params.starCount << ".dds";
+    return name.str();
+}
+
+
+void CreateStarfieldMipChain(const StarfieldParams& params, TextureMipChain* chain)
+{
+    auto faceSize = params.faceSize;
+    assert(faceSize > 0 && (faceSize & (faceSize - 1)) == 0);
+
+    LayoutMipChain(faceSize, chain);
+
+    // Everything random is drawn up front, serially, so the output doesn't depend on the tiling
+    std::mt19937 rng(params.seed);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::normal_distribution<float> normal;
+
+    float nebulaOffsetX = 1000.0f * uniform(rng);
+    float nebulaOffsetY = 1000.0f * uniform(rng);
+    float nebulaOffsetZ = 1000.0f * uniform(rng);
+    float nebulaHueA = uniform(rng);
+    float nebulaHueB = uniform(rng);
+
+    // Star counts grow roughly 10^0.5 per magnitude, i.e. N(< m) ~ 10^(0.5 m), so sample magnitudes by
+    // inverting that; flux relative to the faintest star is then 10^(-0.4 (m - faintest))
+    auto starCount = params.starCount ? params.starCount : 6 * faceSize * faceSize / 256;
+    auto sigmaScale = (float)faceSize / 1024.0f;
+    auto sigma = STAR_SIGMA_TEXELS_AT_1024 * std::max(1.0f, sigmaScale);
+
+    std::vector<std::vector<Star>> faceStars(6);
+    for (UINT i = 0; i < starCount; ++i) {
+        float x = normal(rng), y = normal(rng), z = normal(rng);
+        float magnitude = FAINTEST_MAGNITUDE + 2.0f * std::log10(std::max(uniform(rng), 1e-12f));
+        magnitude = std::max(magnitude, BRIGHTEST_MAGNITUDE);
+        float flux = 0.04f * std::pow(10.0f, -0.4f * (magnitude - FAINTEST_MAGNITUDE));
+
+        // Hot stars are rare
+        float kelvin = 2800.0f + 27000.0f * std::pow(uniform(rng), 4.0f);
+        if (x == 0.0f && y == 0.0f && z == 0.0f) continue;
+
+        float s, t;
+        auto face = CubeFaceFromDirection(x, y, z, &s, &t);
+
+        Star star;
+        star.u = (s * 0.5f + 0.5f) * faceSize;
+        star.v = (t * 0.5f + 0.5f) * faceSize;
+        // Bright stars bloom a little
+        float starSigma = sigma * std::max(1.0f, std::pow(flux, 0.25f));
+        star.radius = 3.0f * starSigma;
+        star.twoSigmaSq = 2.0f * starSigma * starSigma;
+        BlackbodyColor(kelvin, &star.r, &star.g, &star.b);
+        star.r *= flux;
+        star.g *= flux;
+        star.b *= flux;
+        faceStars[face].push_back(star);
+    }
+
+    NoiseOctaves<6> nebulaNoise(0.55f);
+    NoiseOctaves<3> hueNoise(0.5f);
+
+    float hueAR, hueAG, hueAB, hueBR, hueBG, hueBB;
+    BlackbodyColor(2000.0f + 4000.0f * nebulaHueA, &hueAR, &hueAG, &hueAB);   // Warm dust
+    BlackbodyColor(9000.0f + 20000.0f * nebulaHueB, &hueBR, &hueBG, &hueBB);  // Cool gas
+
+    // Parallel over faces and tiles; each tile owns its texels so there is no sharing
+    auto tilesPerSide = std::max(1U, faceSize / TILE_SIZE);
+    auto tileSize = faceSize / tilesPerSide;
+
+    concurrency::parallel_for(UINT(0), 6 * tilesPerSide * tilesPerSide, [&](UINT tile) {
+        UINT face = tile / (tilesPerSide * tilesPerSide);
+        UINT x0 = (tile % tilesPerSide) * tileSize;
+        UINT y0 = ((tile / tilesPerSide) % tilesPerSide) * tileSize;
+
+        std::vector<float> linear(3 * tileSize * tileSize);
+
+        // Nebulae
+        for (UINT y = 0; y < tileSize; ++y) {
+            for (UINT x = 0; x < tileSize; ++x) {
+                float s = 2.0f * (x0 + x + 0.5f) / faceSize - 1.0f;
+                float t = 2.0f * (y0 + y + 0.5f) / faceSize - 1.0f;
+                float dx, dy, dz;
+                CubeFaceDirection(face, s, t, &dx, &dy, &dz);
+                float rcpLength = 1.0f / std::sqrt(dx*dx + dy*dy + dz*dz);
+                dx *= rcpLength; dy *= rcpLength; dz *= rcpLength;
+
+                float n = nebulaNoise(1.5f * dx + nebulaOffsetX, 1.5f * dy + nebulaOffsetY, 1.5f * dz + nebulaOffsetZ);
+                float density = std::max(0.0f, n - 0.52f) * 2.5f;
+                density = 0.12f * density * density;
+
+                float mix = hueNoise(0.8f * dx - nebulaOffsetZ, 0.8f * dy - nebulaOffsetX, 0.8f * dz - nebulaOffsetY);
+
+                auto texel = &linear[3 * (y * tileSize + x)];
+                texel[0] = density * (hueAR + mix * (hueBR - hueAR));
+                texel[1] = density * (hueAG + mix * (hueBG - hueAG));
+                texel[2] = density * (hueAB + mix * (hueBB - hueAB));
+            }
+        }
+
+        // Stars overlapping the tile; same order in every tile, so sums are deterministic
+        for (auto& star : faceStars[face]) {
+            int minX = std::max((int)x0, (int)std::floor(star.u - star.radius));
+            int maxX = std::min((int)(x0 + tileSize) - 1, (int)std::ceil(star.u + star.radius));
+            int minY = std::max((int)y0, (int)std::floor(star.v - star.radius));
+            int maxY = std::min((int)(y0 + tileSize) - 1, (int)std::ceil(star.v + star.radius));
+            for (int y = minY; y <= maxY; ++y) {
+                for (int x = minX; x <= maxX; ++x) {
+                    float du = (x + 0.5f) - star.u;
+                    float dv = (y + 0.5f) - star.v;
+                    float w = std::exp(-(du*du + dv*dv) / star.twoSigmaSq);
+                    auto texel = &linear[3 * ((y - y0) * tileSize + (x - x0))];
+                    texel[0] += w * star.r;
+                    texel[1] += w * star.g;
+                    texel[2] += w * star.b;
+                }
+            }
+        }
+
+        // B8G8R8A8 sRGB
+        auto& level0 = chain->subresources[face * chain->mipLevels];
+        for (UINT y = 0; y < tileSize; ++y) {
+            BYTE* row = (BYTE*)level0.pSysMem + (y0 + y) * level0.SysMemPitch + 4 * x0;
+            for (UINT x = 0; x < tileSize; ++x) {
+                auto texel = &linear[3 * (y * tileSize + x)];
+                row[4*x+0] = LinearToSRGB8(texel[2]);
+                row[4*x+1] = LinearToSRGB8(texel[1]);
+                row[4*x+2] = LinearToSRGB8(texel[0]);
+                row[4*x+3] = 255;
+            }
+        }
+    });
+
+    concurrency::parallel_for(UINT(0), chain->arraySize, [&](UINT a) {
+        GenerateMips2D_XXXX8(&chain->subresources[a * chain->mipLevels], faceSize, faceSize, chain->mipLevels);
+    });
+}
+
+
+HRESULT CreateStarfieldMipChain(const StarfieldParams& params, DDSFile* cacheFile, TextureMipChain* chain)
+{
+    auto cacheFileName = StarfieldCacheFileName(params);
+
+    if (SUCCEEDED(cacheFile->Load(cacheFileName.c_str())) &&
+        cacheFile->Header()->dwWidth == params.faceSize &&
+        SUCCEEDED(CreateMipChainFromDDS_XXXX8(*cacheFile, chain))) {
+        std::cout << "Loaded procedural skybox from " << cacheFileName << std::endl;
+        return S_OK;
+    }
+
+    // A stale cache may still be mapped, which would make rewriting it fail
+    cacheFile->Unload();
+
+    std::cout << "Generating " << params.faceSize << "x" << params.faceSize << " procedural skybox..." << std::endl;
+    *chain = TextureMipChain();
+    CreateStarfieldMipChain(params, chain);
+
+    if (FAILED(WriteMipChainDDS(cacheFileName, *chain))) {
+        std::cerr << "warning: failed to write skybox cache " << cacheFileName << std::endl;
+    }
+    return S_OK;
+}
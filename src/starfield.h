@@ -0,0 +1,41 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <windows.h>
+#include <string>
+
+#include "texture.h"
+
+// Procedural replacement for starbox_1024.dds: point stars (power law magnitudes, blackbody colors) over
+// noise nebulae, rendered into the 6 cube faces in parallel tiles. Output depends only on the parameters,
+// not on the tiling or thread count.
+struct StarfieldParams
+{
+    UINT faceSize = 1024;   // Pow2
+    UINT seed = 0;
+    UINT starCount = 0;     // 0 => scale with face area
+};
+
+// Generates the full mip chain (B8G8R8A8 sRGB cube) into chain->generatedData.
+void CreateStarfieldMipChain(const StarfieldParams& params, TextureMipChain* chain);
+
+// As above, but first tries the DDS cache file for these parameters (see StarfieldCacheFileName), which
+// is loaded into cacheFile and referenced by the chain. A freshly generated chain is written back to it.
+HRESULT CreateStarfieldMipChain(const StarfieldParams& params, DDSFile* cacheFile, TextureMipChain* chain);
+
+std::string StarfieldCacheFileName(const StarfieldParams& params);
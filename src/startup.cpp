@@ -0,0 +1,152 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "startup.h"
+#include "json.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+StartupGraph::StartupGraph()
+{
+    QueryPerformanceFrequency((LARGE_INTEGER*)&mPerfCounterFreq);
+    QueryPerformanceCounter((LARGE_INTEGER*)&mStartCount);
+}
+
+
+StartupGraph::TaskId StartupGraph::AddTask(const char* name, std::function<void()> work,
+                                           std::initializer_list<TaskId> dependencies)
+{
+    TaskId id = mTasks.size();
+
+    std::unique_ptr<Task> task(new Task);
+    task->name = name;
+    task->work = std::move(work);
+    task->dependencies.assign(dependencies.begin(), dependencies.end());
+    task->remainingDependencies = (unsigned int)task->dependencies.size();
+
+    for (auto d : task->dependencies) {
+        assert(d < id); // Also guarantees the graph is acyclic
+        mTasks[d]->successors.push_back(id);
+    }
+
+    mTasks.push_back(std::move(task));
+    return id;
+}
+
+
+void StartupGraph::Schedule(TaskId id)
+{
+    mTaskGroup.run([this, id]() {
+        auto task = mTasks[id].get();
+
+        task->threadId = GetCurrentThreadId();
+        QueryPerformanceCounter((LARGE_INTEGER*)&task->beginCount);
+        task->work();
+        QueryPerformanceCounter((LARGE_INTEGER*)&task->endCount);
+
+        // Last dependency to finish kicks off the successor
+        for (auto s : task->successors) {
+            if (--mTasks[s]->remainingDependencies == 0) {
+                Schedule(s);
+            }
+        }
+    });
+}
+
+
+void StartupGraph::Run()
+{
+    for (TaskId id = 0; id < mTasks.size(); ++id) {
+        if (mTasks[id]->dependencies.empty()) {
+            Schedule(id);
+        }
+    }
+
+    // Successors are scheduled before their predecessor's task completes, so this covers the whole graph
+    mTaskGroup.wait();
+    QueryPerformanceCounter((LARGE_INTEGER*)&mGraphEndCount);
+}
+
+
+void StartupGraph::MarkFirstFrame()
+{
+    if (mFirstFrameCount == 0) {
+        QueryPerformanceCounter((LARGE_INTEGER*)&mFirstFrameCount);
+    }
+}
+
+
+double StartupGraph::Seconds(UINT64 count) const
+{
+    return count < mStartCount ? 0.0 : double(count - mStartCount) / double(mPerfCounterFreq);
+}
+
+
+void StartupGraph::PrintSummary() const
+{
+    std::vector<const Task*> tasks;
+    for (auto& t : mTasks) tasks.push_back(t.get());
+    std::sort(tasks.begin(), tasks.end(), [](const Task* a, const Task* b) { return a->beginCount < b->beginCount; });
+
+    // Formatted apart and written at once, leaving std::cout's format alone for other threads
+    std::ostringstream summary;
+    summary << std::fixed << std::setprecision(1);
+    summary << "Startup phases:" << std::endl;
+    for (auto t : tasks) {
+        summary << "  " << std::setw(8) << 1000.0 * Seconds(t->beginCount) << " -"
+            << std::setw(8) << 1000.0 * Seconds(t->endCount) << " ms  " << t->name << std::endl;
+    }
+    summary << "Startup graph completed in " << 1000.0 * Seconds(mGraphEndCount) << " ms" << std::endl;
+    std::cout << summary.str() << std::flush;
+}
+
+
+void StartupGraph::WriteReport(const std::string& fileName) const
+{
+    double taskSeconds = 0.0;
+    for (auto& t : mTasks) {
+        taskSeconds += Seconds(t->endCount) - Seconds(t->beginCount);
+    }
+    double graphSeconds = Seconds(mGraphEndCount);
+
+    std::ofstream file(fileName);
+    file << std::fixed << std::setprecision(3);
+    file << "{" << std::endl;
+    file << "  \"graph_ms\": " << 1000.0 * graphSeconds << "," << std::endl;
+    file << "  \"first_frame_ms\": " << 1000.0 * Seconds(mFirstFrameCount) << "," << std::endl;
+    file << "  \"task_sum_ms\": " << 1000.0 * taskSeconds << "," << std::endl;
+    file << "  \"parallelism\": " << (graphSeconds > 0.0 ? taskSeconds / graphSeconds : 0.0) << "," << std::endl;
+    file << "  \"phases\": [" << std::endl;
+    for (size_t i = 0; i < mTasks.size(); ++i) {
+        auto t = mTasks[i].get();
+        file << "    { \"name\": \"" << JsonEscape(t->name) << "\", \"dependencies\": [";
+        for (size_t d = 0; d < t->dependencies.size(); ++d) {
+            file << (d ? ", " : "") << "\"" << JsonEscape(mTasks[t->dependencies[d]]->name) << "\"";
+        }
+        file << "], \"begin_ms\": " << 1000.0 * Seconds(t->beginCount)
+             << ", \"end_ms\": " << 1000.0 * Seconds(t->endCount)
+             << ", \"duration_ms\": " << 1000.0 * (Seconds(t->endCount) - Seconds(t->beginCount))
+             << ", \"thread\": " << t->threadId << " }"
+             << (i + 1 < mTasks.size() ? "," : "") << std::endl;
+    }
+    file << "  ]" << std::endl;
+    file << "}" << std::endl;
+}
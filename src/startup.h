@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <windows.h>
+#include <ppl.h>
+
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Dependency graph for the startup work (asset generation, file loads, device/PSO creation, uploads).
+// Each task is kicked off on the concurrency runtime as soon as all of its dependencies have completed.
+// Per-task timings are recorded for the startup report.
+class StartupGraph
+{
+public:
+    typedef size_t TaskId;
+
+    StartupGraph();
+
+    // Dependencies must already have been added; tasks may not be added once Run() has been called
+    TaskId AddTask(const char* name, std::function<void()> work, std::initializer_list<TaskId> dependencies = {});
+
+    // Blocks until every task has completed
+    void Run();
+
+    // Time to first frame is measured from construction of the graph
+    void MarkFirstFrame();
+
+    void PrintSummary() const;
+    void WriteReport(const std::string& fileName) const;
+
+private:
+    struct Task
+    {
+        std::string name;
+        std::function<void()> work;
+        std::vector<TaskId> dependencies;
+        std::vector<TaskId> successors;
+        std::atomic<unsigned int> remainingDependencies;
+
+        // Filled in when run
+        UINT64 beginCount = 0;
+        UINT64 endCount = 0;
+        DWORD threadId = 0;
+    };
+
+    void Schedule(TaskId id);
+    double Seconds(UINT64 count) const;
+
+    std::vector<std::unique_ptr<Task>> mTasks;
+    concurrency::task_group mTaskGroup;
+
+    UINT64 mPerfCounterFreq = 0;
+    UINT64 mStartCount = 0;
+    UINT64 mGraphEndCount = 0;
+    UINT64 mFirstFrameCount = 0;
+};
@@ -20,7 +20,11 @@
 #include "DDSTextureLoader.h"
 
 #include <stdint.h>
-#include <sstream>
+#include <ppl.h>
+#include <algorithm>
+
+// Least work per upload copy task; a band of rows this big or a whole smaller subresource
+static const UINT UPLOAD_BAND_BYTES = 256 * 1024;
 
 
 static void WaitForAll(ID3D12Device* device, ID3D12CommandQueue* queue)
@@ -107,6 +111,19 @@ void InitializeTexture2D(
     ID3D12Resource* texture, const D3D12_RESOURCE_DESC* desc, UINT bytesPerPixel,
     const D3D11_SUBRESOURCE_DATA* initialData,
     D3D12_RESOURCE_STATES stateAfter)
+{
+    UploadTexture2DMips(device, cmdQueue, texture, desc, bytesPerPixel, initialData,
+                        0, desc->MipLevels, D3D12_RESOURCE_STATE_COMMON, stateAfter);
+}
+
+
+void UploadTexture2DMips(
+    ID3D12Device* device, ID3D12CommandQueue* cmdQueue,
+    ID3D12Resource* texture, const D3D12_RESOURCE_DESC* desc, UINT bytesPerPixel,
+    const D3D11_SUBRESOURCE_DATA* initialData,
+    UINT firstMip, UINT mipCount,
+    D3D12_RESOURCE_STATES stateBefore,
+    D3D12_RESOURCE_STATES stateAfter)
 {
     // Pull some data
     auto format = desc->Format;
@@ -115,17 +132,19 @@ void InitializeTexture2D(
     UINT arraySize = desc->DepthOrArraySize;
     UINT mipLevels = desc->MipLevels;
  
-    // Pow2 mip chain!
+    // Pow2 mip chain! Non-square ones bottom out at 1 texel along the shorter side
     assert(mipLevels == 1 || ((width & (width-1)) == 0 && (height & (height-1)) == 0));
+    assert(firstMip + mipCount <= mipLevels);
         
+    std::vector<UINT> subresources;
     std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> placedUpload;
     UINT64 totalSize = 0;
     for (UINT a = 0; a < arraySize; ++a) {
-        for (UINT m = 0; m < mipLevels; ++m) {
+        for (UINT m = firstMip; m < firstMip + mipCount; ++m) {
             D3D12_PLACED_SUBRESOURCE_FOOTPRINT placed = {};
             placed.Footprint.Format = format;
-            placed.Footprint.Width = width >> m;   // TODO: Handle mip sizes properly!
-            placed.Footprint.Height = height >> m; // TODO: Handle mip sizes properly!
+            placed.Footprint.Width = std::max(1U, width >> m);
+            placed.Footprint.Height = std::max(1U, height >> m);
             placed.Footprint.Depth = 1;
             placed.Footprint.RowPitch = Align<UINT>(placed.Footprint.Width * bytesPerPixel, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
             placed.Offset = totalSize;
@@ -133,6 +152,7 @@ void InitializeTexture2D(
             totalSize = Align<UINT64>(placed.Offset + (placed.Footprint.RowPitch * placed.Footprint.Height),
                                       D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
             placedUpload.push_back(placed);
+            subresources.push_back(a * mipLevels + m);
         }
     }
 
@@ -150,40 +170,61 @@ void InitializeTexture2D(
     ThrowIfFailed(uploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&baseData)));    
      
     // Fill in data (RGBA8)
-    for (UINT a = 0; a < arraySize; ++a) {
-        for (UINT m = 0; m < mipLevels; ++m) {
-            auto subresource = a * mipLevels + m;
-            
-            BYTE* dataSrc = (BYTE*)initialData[subresource].pSysMem;
-            auto rowPitchSrc = initialData[subresource].SysMemPitch;
-
-            auto placed = &placedUpload[subresource];
-            BYTE* dataDst = baseData + placed->Offset;
-            auto rowPitchDst = placed->Footprint.RowPitch;
-            UINT width_mip = placed->Footprint.Width;
-            UINT height_mip = placed->Footprint.Height;
-
-            for (UINT y = 0; y < height_mip; ++y) {
-                memcpy(dataDst + y*rowPitchDst, dataSrc + y*rowPitchSrc, bytesPerPixel * width_mip);
-            }
+    // Rows go straight from the source (which may be a file mapping) into the upload heap, in parallel bands
+    struct Band
+    {
+        size_t upload; // Index into subresources/placedUpload
+        UINT firstRow;
+        UINT rowCount;
+    };
+    std::vector<Band> bands;
+    for (size_t s = 0; s < subresources.size(); ++s) {
+        UINT height_mip = placedUpload[s].Footprint.Height;
+        UINT rowsPerBand = std::max(1U, UPLOAD_BAND_BYTES / (bytesPerPixel * placedUpload[s].Footprint.Width));
+        for (UINT y = 0; y < height_mip; y += rowsPerBand) {
+            bands.push_back({ s, y, std::min(rowsPerBand, height_mip - y) });
         }
     }
 
+    concurrency::parallel_for(size_t(0), bands.size(), [&](size_t b) {
+        auto& band = bands[b];
+        auto subresource = subresources[band.upload];
+
+        const BYTE* dataSrc = (const BYTE*)initialData[subresource].pSysMem;
+        auto rowPitchSrc = initialData[subresource].SysMemPitch;
+
+        auto placed = &placedUpload[band.upload];
+        BYTE* dataDst = baseData + placed->Offset;
+        auto rowPitchDst = placed->Footprint.RowPitch;
+        UINT width_mip = placed->Footprint.Width;
+
+        for (UINT y = band.firstRow; y < band.firstRow + band.rowCount; ++y) {
+            memcpy(dataDst + y*rowPitchDst, dataSrc + y*rowPitchSrc, bytesPerPixel * width_mip);
+        }
+    });
+
     // Create some new resources for initialization
     ID3D12GraphicsCommandList* cmdLst = nullptr;
     ID3D12CommandAllocator* cmdAlloc = nullptr;
     ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&cmdAlloc)));
     ThrowIfFailed(device->CreateCommandList(1, D3D12_COMMAND_LIST_TYPE_DIRECT, cmdAlloc, nullptr, IID_PPV_ARGS(&cmdLst)));
 
+    // Only the subresources being written are transitioned; the rest may be in use meanwhile
+    bool allSubresources = subresources.size() == arraySize * mipLevels;
+
     {
         ResourceBarrier rb;
-        rb.AddTransition(texture, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
+        if (allSubresources) {
+            rb.AddTransition(texture, stateBefore, D3D12_RESOURCE_STATE_COPY_DEST);
+        } else {
+            for (auto s : subresources) rb.AddTransition(texture, stateBefore, D3D12_RESOURCE_STATE_COPY_DEST, s);
+        }
         rb.Submit(cmdLst);
     }
 
     // Copy data from each subresource into texture
     for (size_t s = 0; s < placedUpload.size(); ++s) {
-        CD3DX12_TEXTURE_COPY_LOCATION dest(texture, static_cast<UINT>(s));
+        CD3DX12_TEXTURE_COPY_LOCATION dest(texture, subresources[s]);
         CD3DX12_TEXTURE_COPY_LOCATION src(uploadBuffer, placedUpload[s]);
 
         cmdLst->CopyTextureRegion(
@@ -193,7 +234,11 @@ void InitializeTexture2D(
 
     {
         ResourceBarrier rb;
-        rb.AddTransition(texture, D3D12_RESOURCE_STATE_COPY_DEST, stateAfter);
+        if (allSubresources) {
+            rb.AddTransition(texture, D3D12_RESOURCE_STATE_COPY_DEST, stateAfter);
+        } else {
+            for (auto s : subresources) rb.AddTransition(texture, D3D12_RESOURCE_STATE_COPY_DEST, stateAfter, s);
+        }
         rb.Submit(cmdLst);
     }
 
@@ -209,6 +254,92 @@ void InitializeTexture2D(
 }
 
 
+DDSFile::~DDSFile()
+{
+    Unload();
+}
+
+
+void DDSFile::Unload()
+{
+    if (mView) UnmapViewOfFile(mView);
+    if (mMapping) CloseHandle(mMapping);
+    mView = nullptr;
+    mMapping = NULL;
+    mHeapData.reset();
+    mHeader = nullptr;
+    mBitData = nullptr;
+    mBitSize = 0;
+}
+
+
+HRESULT DDSFile::Load(const char* fileName, bool prefetch)
+{
+    assert(!Loaded());
+
+    auto file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    LARGE_INTEGER fileSize = {};
+    GetFileSizeEx(file, &fileSize);
+    if (fileSize.HighPart > 0) {
+        CloseHandle(file);
+        return E_FAIL;
+    }
+
+    // Copy-on-write so the D3D11 loader's in-place swizzling (if it ever needs it) can't touch the file
+    // The mapping keeps its own reference to the file
+    mMapping = CreateFileMapping(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mMapping == NULL) {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    mView = (BYTE*)MapViewOfFile(mMapping, FILE_MAP_COPY, 0, 0, 0);
+    if (mView == nullptr) {
+        HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+        CloseHandle(mMapping);
+        mMapping = NULL;
+        return hr;
+    }
+
+    HRESULT hr = ParseTextureDataFromMemory(mView, fileSize.LowPart, &mHeader, &mBitData, &mBitSize);
+    if (FAILED(hr)) {
+        Unload();
+        return hr;
+    }
+
+    // Everything past the header is about to be read front to back by the uploads, so start paging it in
+    // now rather than faulting it in a page at a time. Just a hint; ignore failure.
+    if (prefetch) {
+        WIN32_MEMORY_RANGE_ENTRY range = { mBitData, mBitSize };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+
+    return S_OK;
+}
+
+
+HRESULT DDSFile::Load(std::unique_ptr<BYTE[]> data, UINT size)
+{
+    assert(!Loaded());
+
+    HRESULT hr = ParseTextureDataFromMemory(data.get(), size, &mHeader, &mBitData, &mBitSize);
+    if (FAILED(hr)) {
+        mHeader = nullptr;
+        mBitData = nullptr;
+        mBitSize = 0;
+        return hr;
+    }
+
+    mHeapData = std::move(data);
+    return S_OK;
+}
+
+
 HRESULT CreateTexture2DFromDDS_XXXX8(
     ID3D12Device* device, ID3D12CommandQueue* cmdQueue,
     ID3D12Resource** texture, 
@@ -216,20 +347,27 @@ HRESULT CreateTexture2DFromDDS_XXXX8(
     DXGI_FORMAT format, 
     D3D12_RESOURCE_STATES stateAfter )
 {
-    BYTE* heapData = nullptr;
-    DDS_HEADER* header = nullptr;
-    BYTE* bitData = nullptr;
-    UINT bitSize = 0;
-
-    std::wostringstream wfileName;
-    wfileName << fileName;
-
-    HRESULT hr = LoadTextureDataFromFile(wfileName.str().c_str(), &heapData, &header, &bitData, &bitSize);
+    DDSFile file;
+    HRESULT hr = file.Load(fileName);
     if (FAILED(hr)) {
-        delete[] heapData;
         return hr;
     }
 
+    return CreateTexture2DFromDDS_XXXX8(device, cmdQueue, texture, file, format, stateAfter);
+}
+
+
+HRESULT CreateTexture2DFromDDS_XXXX8(
+    ID3D12Device* device, ID3D12CommandQueue* cmdQueue,
+    ID3D12Resource** texture, 
+    const DDSFile& file,
+    DXGI_FORMAT format, 
+    D3D12_RESOURCE_STATES stateAfter )
+{
+    auto header = file.Header();
+    auto bitData = file.Bits();
+    auto bitSize = file.BitSize();
+
     unsigned int arraySize = 1;
 
     if (header->dwCaps2 & DDS_CUBEMAP) {
@@ -263,20 +401,20 @@ HRESULT CreateTexture2DFromDDS_XXXX8(
 
     std::vector<D3D11_SUBRESOURCE_DATA> initialData(desc.MipLevels * arraySize);
     
-    BYTE* srcBits = bitData;
+    const BYTE* srcBits = bitData;
     const BYTE *endBits = bitData + bitSize;
 
     for (UINT a = 0; a < arraySize; ++a) {
         for (UINT m = 0; m < desc.MipLevels; ++m) {
-            auto width  = (UINT)desc.Width >> m;
-            auto height = desc.Height >> m;
+            auto width  = std::max(1U, (UINT)desc.Width >> m);
+            auto height = std::max(1U, desc.Height >> m);
             auto subresource = a * desc.MipLevels + m;
             auto rowPitch = 4 * width;
             auto bytes = rowPitch * height;
 
             assert(srcBits + bytes <= endBits);
 
-            initialData[subresource].pSysMem = (void*)srcBits;
+            initialData[subresource].pSysMem = (const void*)srcBits;
             initialData[subresource].SysMemPitch = rowPitch;
             initialData[subresource].SysMemSlicePitch = bytes;
                 
@@ -286,6 +424,81 @@ HRESULT CreateTexture2DFromDDS_XXXX8(
 
     InitializeTexture2D(device, cmdQueue, *texture, &desc, 4, initialData.data(), stateAfter);
     
-    delete[] heapData;
+    return S_OK;
+}
+
+
+HRESULT CreateMipChainFromDDS_XXXX8(const DDSFile& file, TextureMipChain* chain)
+{
+    auto header = file.Header();
+
+    chain->width = header->dwWidth;
+    chain->height = header->dwHeight;
+    chain->arraySize = 1;
+    if (header->dwCaps2 & DDS_CUBEMAP) {
+        assert((header->dwCaps2 & DDS_CUBEMAP_ALLFACES ) == DDS_CUBEMAP_ALLFACES);
+        chain->arraySize = 6;
+    }
+
+    // Pow2 only; see GenerateMips2D_XXXX8
+    if ((chain->width & (chain->width-1)) != 0 || (chain->height & (chain->height-1)) != 0) {
+        return E_NOTIMPL;
+    }
+
+    DWORD msbIndex = 0;
+    _BitScanReverse(&msbIndex, std::max(chain->width, chain->height));
+    chain->mipLevels = msbIndex + 1;
+
+    UINT fileMipLevels = std::max(1UL, header->dwMipMapCount);
+    fileMipLevels = std::min(fileMipLevels, chain->mipLevels);
+
+    // Lay out the subresources: file mips point into the file, the rest into generatedData
+    chain->subresources.resize(chain->arraySize * chain->mipLevels);
+
+    size_t generatedSize = 0;
+    for (UINT a = 0; a < chain->arraySize; ++a) {
+        for (UINT m = fileMipLevels; m < chain->mipLevels; ++m) {
+            generatedSize += 4 * std::max(1U, chain->width >> m) * std::max(1U, chain->height >> m);
+        }
+    }
+    chain->generatedData.resize(generatedSize);
+
+    const BYTE* srcBits = file.Bits();
+    const BYTE* endBits = file.Bits() + file.BitSize();
+    BYTE* generatedBits = chain->generatedData.data();
+
+    for (UINT a = 0; a < chain->arraySize; ++a) {
+        for (UINT m = 0; m < chain->mipLevels; ++m) {
+            auto rowPitch = 4 * std::max(1U, chain->width >> m);
+            auto bytes = rowPitch * std::max(1U, chain->height >> m);
+
+            auto& subresource = chain->subresources[a * chain->mipLevels + m];
+            subresource.SysMemPitch = rowPitch;
+            subresource.SysMemSlicePitch = bytes;
+
+            if (m < fileMipLevels) {
+                if (srcBits + bytes > endBits) return E_FAIL;
+                subresource.pSysMem = srcBits;
+                srcBits += bytes;
+            } else {
+                subresource.pSysMem = generatedBits;
+                generatedBits += bytes;
+            }
+        }
+        // Skip any file mips past what we use
+        for (UINT m = fileMipLevels; m < header->dwMipMapCount; ++m) {
+            srcBits += 4 * std::max(1U, chain->width >> m) * std::max(1U, chain->height >> m);
+        }
+    }
+
+    // Generate the missing levels, in parallel over array slices
+    if (fileMipLevels < chain->mipLevels) {
+        concurrency::parallel_for(UINT(0), chain->arraySize, [&](UINT a) {
+            GenerateMips2D_XXXX8(&chain->subresources[a * chain->mipLevels + fileMipLevels - 1],
+                                 chain->width >> (fileMipLevels - 1), chain->height >> (fileMipLevels - 1),
+                                 chain->mipLevels - fileMipLevels + 1);
+        });
+    }
+
     return S_OK;
 }
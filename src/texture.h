@@ -20,6 +20,11 @@
 #include <d3dx12.h>
 #include <d3d11.h>
 
+#include "dds.h"
+
+#include <memory>
+#include <vector>
+
 void GenerateMips2D_XXXX8(D3D11_SUBRESOURCE_DATA* subresources, size_t widthLevel0, size_t heightLevel0, size_t mipLevels);
 
 // Will generate mips (into subresources array) is mipLevels > 0
@@ -41,6 +46,69 @@ void InitializeTexture2D(
     const D3D11_SUBRESOURCE_DATA* initialData,
     D3D12_RESOURCE_STATES stateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 
+// As above but only uploads mips [firstMip, firstMip + mipCount) of each array slice (initialData still
+// covers the whole resource). Only those subresources are transitioned, so the rest of the texture can be
+// in use by the GPU meanwhile.
+void UploadTexture2DMips(
+    ID3D12Device* device, 
+    ID3D12CommandQueue* cmdQueue,
+    ID3D12Resource* texture, 
+    const D3D12_RESOURCE_DESC* desc, 
+    UINT bytesPerPixel, 
+    const D3D11_SUBRESOURCE_DATA* initialData,
+    UINT firstMip,
+    UINT mipCount,
+    D3D12_RESOURCE_STATES stateBefore,
+    D3D12_RESOURCE_STATES stateAfter);
+
+// A DDS file in memory, loaded once and shared by the D3D11 and D3D12 workloads.
+// The header is parsed in place and Bits() points directly into the file data - either a (copy-on-write)
+// mapping of the file or a buffer it was read into - so there is no extra copy ahead of the upload.
+class DDSFile
+{
+public:
+    DDSFile() {}
+    ~DDSFile();
+
+    // prefetch queues reads of the whole file; without it pages come in as they are touched (or prefetched)
+    HRESULT Load(const char* fileName, bool prefetch = true);
+    // Takes ownership of a file that was already read into memory (see AssetLoader)
+    HRESULT Load(std::unique_ptr<BYTE[]> data, UINT size);
+    // Releases the data (and any mapping of the file, so it can be rewritten)
+    void Unload();
+
+    bool Loaded() const { return mHeader != nullptr; }
+    const DDS_HEADER* Header() const { return mHeader; }
+    const BYTE* Bits() const { return mBitData; }
+    UINT BitSize() const { return mBitSize; }
+
+private:
+    DDSFile(const DDSFile&);
+    DDSFile& operator=(const DDSFile&);
+
+    HANDLE mMapping = NULL;
+    BYTE* mView = nullptr;
+    std::unique_ptr<BYTE[]> mHeapData;
+    DDS_HEADER* mHeader = nullptr;
+    BYTE* mBitData = nullptr;
+    UINT mBitSize = 0;
+};
+
+// Complete mip chain of a pow2 XXXX8 DDS texture. Mips present in the file reference the file data directly,
+// the rest are generated. API neutral, so it is built once and streamed into both workloads.
+struct TextureMipChain
+{
+    UINT width = 0;
+    UINT height = 0;
+    UINT arraySize = 0;
+    UINT mipLevels = 0;
+    std::vector<BYTE> generatedData;
+    std::vector<D3D11_SUBRESOURCE_DATA> subresources; // [arraySlice * mipLevels + mip]
+};
+
+// File must outlive the chain
+HRESULT CreateMipChainFromDDS_XXXX8(const DDSFile& file, TextureMipChain* chain);
+
 // NOTE: This function very much only works for the specific path(s) that we use it for!
 // Not very general-purpose yet.
 HRESULT CreateTexture2DFromDDS_XXXX8(
@@ -50,3 +118,11 @@ HRESULT CreateTexture2DFromDDS_XXXX8(
     const char* fileName,
     DXGI_FORMAT format, // Should match file otherwise expect explosion/wackiness...
     D3D12_RESOURCE_STATES stateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+
+HRESULT CreateTexture2DFromDDS_XXXX8(
+    ID3D12Device* device, 
+    ID3D12CommandQueue* cmdQueue,
+    ID3D12Resource** texture, 
+    const DDSFile& file,
+    DXGI_FORMAT format,
+    D3D12_RESOURCE_STATES stateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
@@ -0,0 +1,316 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "texture_pool.h"
+#include "asset_params.h"
+#include "texture.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <random>
+
+namespace {
+
+const UINT ARRAY_SIZE = 3; // Tri-planar projection planes, same as the startup textures
+const UINT MAX_GENERATING = 8;
+const UINT MAX_PUBLISHED_PER_FRAME = 8;
+
+} // namespace
+
+
+ProceduralTexturePool::ProceduralTexturePool(UINT virtualCount, UINT firstSlot, UINT slotCount, UINT64 budgetBytes,
+                                             UINT framesInFlight, CreateFunc create, BindFunc bind)
+    : mVirtualCount(virtualCount)
+    , mFirstSlot(firstSlot)
+    , mBudgetBytes(budgetBytes)
+    , mFramesInFlight(framesInFlight)
+    , mCreate(std::move(create))
+    , mBind(std::move(bind))
+    , mVirtual(new Virtual[virtualCount])
+    , mSlots(slotCount)
+    , mResidentBytes(0)
+    , mFrame(0)
+    , mTextureParams(std::make_shared<AsteroidTextureParams>())
+{
+    for (UINT i = 0; i < mVirtualCount; ++i) {
+        mVirtual[i].slot = INVALID_SLOT;
+        mVirtual[i].residentDim = 0;
+        mVirtual[i].requestedDim = 0;
+        mVirtual[i].lastUsedFrame = 0;
+    }
+}
+
+
+ProceduralTexturePool::~ProceduralTexturePool()
+{
+    mTasks.wait();
+
+    for (auto& c : mCompleted) {
+        if (c.object) c.object->Release();
+    }
+    for (auto& s : mSlots) {
+        if (s.texture) s.texture->Release();
+    }
+}
+
+
+UINT ProceduralTexturePool::DimForLOD(UINT subdiv, UINT maxSubdiv, UINT maxDim)
+{
+    auto dim = maxDim >> (maxSubdiv - std::min(subdiv, maxSubdiv));
+    return std::max(dim, std::min(MIN_DIM, maxDim));
+}
+
+
+void ProceduralTexturePool::Generate(UINT virtualIndex, UINT dim, const AsteroidTextureParams& params,
+                                     PooledTexture* texture)
+{
+    assert((dim & (dim - 1)) == 0);
+
+    DWORD msbIndex = 0;
+    _BitScanReverse(&msbIndex, dim);
+
+    texture->virtualIndex = virtualIndex;
+    texture->dim = dim;
+    texture->arraySize = ARRAY_SIZE;
+    texture->mipLevels = msbIndex + 1;
+
+    size_t sliceBytes = 0;
+    for (UINT m = 0; m < texture->mipLevels; ++m) {
+        sliceBytes += 4 * (size_t)(dim >> m) * (dim >> m);
+    }
+    texture->data.resize(sliceBytes * ARRAY_SIZE);
+    texture->subresources.resize(ARRAY_SIZE * texture->mipLevels);
+
+    BYTE* data = texture->data.data();
+    for (UINT a = 0; a < ARRAY_SIZE; ++a) {
+        for (UINT m = 0; m < texture->mipLevels; ++m) {
+            auto& subresource = texture->subresources[a * texture->mipLevels + m];
+            subresource.pSysMem = data;
+            subresource.SysMemPitch = 4 * (dim >> m);
+            subresource.SysMemSlicePitch = subresource.SysMemPitch * (dim >> m);
+            data += subresource.SysMemSlicePitch;
+        }
+    }
+
+    // Same parameter ranges as the startup textures (see AsteroidAssets::CreateTexture)
+    std::mt19937 rng(virtualIndex * 2654435761U + 1);
+    auto randomNoise = std::uniform_real_distribution<float>(0.0f, 10000.0f);
+    auto randomNoiseScale = std::uniform_real_distribution<float>(params.noiseScaleMin, params.noiseScaleMax);
+    auto randomPersistence = std::normal_distribution<float>(params.persistenceMean, params.persistenceStdDev);
+
+    float noiseScale = randomNoiseScale(rng) / float(dim);
+    float persistence = randomPersistence(rng);
+    float strength = params.strength;
+
+    for (UINT a = 0; a < ARRAY_SIZE; ++a) {
+        FillNoise2D_RGBA8(&texture->subresources[a * texture->mipLevels], dim, dim, texture->mipLevels,
+                          randomNoise(rng), persistence, noiseScale, strength,
+                          255.0f, 255.0f, 255.0f);
+    }
+}
+
+
+void ProceduralTexturePool::SetTextureParams(const AsteroidTextureParams& params)
+{
+    if (memcmp(&params, mTextureParams.get(), sizeof(params)) == 0) return;
+
+    // Generation in flight completes with the old parameters and is dropped at publish
+    mTextureParams = std::make_shared<AsteroidTextureParams>(params);
+    for (UINT i = 0; i < mVirtualCount; ++i) {
+        mVirtual[i].residentDim = 0;
+    }
+}
+
+
+UINT ProceduralTexturePool::Request(UINT virtualIndex, UINT dim, UINT fallbackSlot)
+{
+    assert(virtualIndex < mVirtualCount);
+    auto v = &mVirtual[virtualIndex];
+
+    v->lastUsedFrame.store(mFrame, std::memory_order_relaxed);
+
+    if (v->residentDim.load(std::memory_order_relaxed) < dim) {
+        // First request this frame queues it; later ones only raise the resolution
+        UINT requested = v->requestedDim.load(std::memory_order_relaxed);
+        while (requested < dim && !v->requestedDim.compare_exchange_weak(requested, dim)) {}
+        if (requested == 0) mRequests.push(virtualIndex);
+    }
+
+    UINT slot = v->slot.load(std::memory_order_acquire);
+    return slot == INVALID_SLOT ? fallbackSlot : slot;
+}
+
+
+bool ProceduralTexturePool::EvictLeastRecentlyUsed(UINT64 usedBefore)
+{
+    // The oldest resident texture, if it was last used before usedBefore. Retiring slots (possibly still
+    // sampled by frames in flight) are already out of the running.
+    UINT lru = INVALID_SLOT;
+    UINT64 lruFrame = usedBefore;
+    for (UINT s = 0; s < mSlots.size(); ++s) {
+        if (mSlots[s].state != Slot::RESIDENT) continue;
+        auto lastUsed = mVirtual[mSlots[s].virtualIndex].lastUsedFrame.load(std::memory_order_relaxed);
+        if (lastUsed < lruFrame) {
+            lru = s;
+            lruFrame = lastUsed;
+        }
+    }
+    if (lru == INVALID_SLOT) return false;
+
+    auto& evicted = mSlots[lru];
+    auto v = &mVirtual[evicted.virtualIndex];
+    v->slot = INVALID_SLOT;
+    v->residentDim = 0;
+    Retire(&evicted);
+    ++mEvictions;
+    return true;
+}
+
+
+void ProceduralTexturePool::Retire(Slot* slot)
+{
+    mResidentBytes -= slot->bytes;
+    slot->state = Slot::RETIRING;
+    slot->retiredFrame = mFrame;
+}
+
+
+ProceduralTexturePool::AllocateResult ProceduralTexturePool::AllocateSlot(UINT64 bytes, UINT64 lastUsedFrame,
+                                                                         UINT* slot)
+{
+    // Retired slots are reusable once every frame that could have sampled them has completed
+    for (auto& s : mSlots) {
+        if (s.state == Slot::RETIRING && mFrame >= s.retiredFrame + mFramesInFlight) {
+            s.texture->Release();
+            s.texture = nullptr;
+            s.state = Slot::FREE;
+        }
+    }
+
+    while (mResidentBytes + bytes > mBudgetBytes) {
+        if (!EvictLeastRecentlyUsed(lastUsedFrame)) return ALLOCATE_FULL;
+    }
+
+    for (UINT s = 0; s < mSlots.size(); ++s) {
+        if (mSlots[s].state == Slot::FREE) {
+            *slot = s;
+            return ALLOCATE_OK;
+        }
+    }
+
+    // Out of slots rather than bytes; the evicted slot only becomes usable a few frames from now
+    return EvictLeastRecentlyUsed(lastUsedFrame) ? ALLOCATE_RETRY : ALLOCATE_FULL;
+}
+
+
+void ProceduralTexturePool::BeginFrame()
+{
+    ++mFrame;
+
+    // Publish finished textures
+    std::vector<Completed> completed;
+    {
+        std::lock_guard<std::mutex> lock(mCompletedMutex);
+        auto count = std::min((size_t)MAX_PUBLISHED_PER_FRAME, mCompleted.size());
+        std::move(mCompleted.begin(), mCompleted.begin() + count, std::back_inserter(completed));
+        mCompleted.erase(mCompleted.begin(), mCompleted.begin() + count);
+    }
+
+    std::vector<Completed> retry;
+    for (auto& c : completed) {
+        auto virtualIndex = c.texture->virtualIndex;
+        auto v = &mVirtual[virtualIndex];
+
+        UINT slot = INVALID_SLOT;
+        auto lastUsed = v->lastUsedFrame.load(std::memory_order_relaxed);
+        auto stale = c.params != mTextureParams;
+        auto result = c.object && !stale ? AllocateSlot(c.bytes, lastUsed, &slot) : ALLOCATE_FULL;
+        if (result == ALLOCATE_RETRY) {
+            retry.push_back(std::move(c));
+            continue;
+        }
+
+        --mInFlight;
+        v->pending = false;
+        if (result == ALLOCATE_FULL) {
+            // Dropped; it will be asked for again if still needed
+            if (c.object) c.object->Release();
+            continue;
+        }
+
+        // A lower resolution version is replaced, but its slot may still be sampled by frames in flight
+        auto oldSlot = v->slot.load();
+        if (oldSlot != INVALID_SLOT) {
+            Retire(&mSlots[oldSlot - mFirstSlot]);
+        }
+
+        auto& slotData = mSlots[slot];
+        slotData.texture = c.object;
+        slotData.virtualIndex = virtualIndex;
+        slotData.bytes = c.bytes;
+        slotData.state = Slot::RESIDENT;
+        mResidentBytes += c.bytes;
+
+        mBind(mFirstSlot + slot, c.object);
+        v->residentDim = c.texture->dim;
+        v->slot.store(mFirstSlot + slot, std::memory_order_release);
+    }
+
+    if (!retry.empty()) {
+        std::lock_guard<std::mutex> lock(mCompletedMutex);
+        mCompleted.insert(mCompleted.begin(), std::make_move_iterator(retry.begin()), std::make_move_iterator(retry.end()));
+    }
+
+    // Gather last frame's requests, most detailed first
+    std::vector<std::pair<UINT, UINT>> requests; // dim, virtual index
+    UINT virtualIndex = 0;
+    while (mRequests.try_pop(virtualIndex)) {
+        auto dim = mVirtual[virtualIndex].requestedDim.exchange(0);
+        if (!mVirtual[virtualIndex].pending && dim > mVirtual[virtualIndex].residentDim) {
+            requests.emplace_back(dim, virtualIndex);
+        }
+    }
+    std::sort(requests.begin(), requests.end(), [](const std::pair<UINT, UINT>& a, const std::pair<UINT, UINT>& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+
+    for (auto& r : requests) {
+        if (mInFlight >= MAX_GENERATING) break;
+        ++mInFlight;
+        mVirtual[r.second].pending = true;
+
+        auto dim = r.first;
+        auto index = r.second;
+        auto params = mTextureParams;
+        mTasks.run([this, dim, index, params]() {
+            std::unique_ptr<PooledTexture> texture(new PooledTexture);
+            Generate(index, dim, *params, texture.get());
+
+            Completed c;
+            c.params = params;
+            c.object = mCreate(*texture);
+            c.bytes = texture->data.size();
+
+            // Only the backend's copy is kept
+            texture->data = std::vector<BYTE>();
+            texture->subresources.clear();
+            c.texture = std::move(texture);
+
+            std::lock_guard<std::mutex> lock(mCompletedMutex);
+            mCompleted.push_back(std::move(c));
+        });
+    }
+}
@@ -0,0 +1,149 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <windows.h>
+#include <unknwn.h>
+#include <d3d11.h> // For D3D11_SUBRESOURCE_DATA
+#include <concurrent_queue.h>
+#include <ppl.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct AsteroidTextureParams;
+
+// CPU side data of one generated pool texture (RGBA8 sRGB, full mip chain, 3 array slices like the
+// startup textures)
+struct PooledTexture
+{
+    UINT virtualIndex = 0;
+    UINT dim = 0;
+    UINT arraySize = 0;
+    UINT mipLevels = 0;
+    std::vector<BYTE> data;
+    std::vector<D3D11_SUBRESOURCE_DATA> subresources; // [arraySlice * mipLevels + mip]
+};
+
+// Pool of many virtual procedural asteroid textures, backed by a fixed range of shader texture slots.
+// A virtual texture is generated (on worker threads, at the resolution asked for) only once something
+// requests it; until then callers get their fallback slot. Resident textures are evicted least recently
+// used first to stay within a byte budget, but only for a texture requested more recently than they were,
+// so a working set larger than the budget doesn't thrash. Callers should only request what is in view.
+//
+// API neutral: the backend turns generated data into its own texture object on the worker thread
+// (CreateFunc) and points a slot at it on the render thread (BindFunc). The pool owns the returned
+// reference and releases it once no buffered frame can still be using the slot.
+class ProceduralTexturePool
+{
+public:
+    typedef std::function<IUnknown*(const PooledTexture&)> CreateFunc;
+    typedef std::function<void(UINT slot, IUnknown* texture)> BindFunc;
+
+    static const UINT MIN_DIM = 32;
+
+    ProceduralTexturePool(UINT virtualCount, UINT firstSlot, UINT slotCount, UINT64 budgetBytes,
+                          UINT framesInFlight, CreateFunc create, BindFunc bind);
+    // Waits for outstanding generation
+    ~ProceduralTexturePool();
+
+    // Render thread, once per frame before any Request. Publishes finished textures and kicks off
+    // generation for what was requested last frame (largest first).
+    void BeginFrame();
+
+    // Render thread, between frames. The pool starts with the default parameters; a change regenerates every
+    // texture as it is next requested, showing the old one until then.
+    void SetTextureParams(const AsteroidTextureParams& params);
+
+    // Any thread, between BeginFrame calls. Returns the slot to sample for this frame.
+    UINT Request(UINT virtualIndex, UINT dim, UINT fallbackSlot);
+
+    UINT VirtualCount() const { return mVirtualCount; }
+    UINT VirtualIndexForAsteroid(UINT asteroidIndex) const
+    {
+        return (UINT)(((UINT64)asteroidIndex * 2654435761ULL) % mVirtualCount);
+    }
+
+    UINT64 ResidentBytes() const { return mResidentBytes; }
+    UINT64 Evictions() const { return mEvictions; }
+
+    // Blocks until outstanding generation has completed; BeginFrame then publishes it (up to its per-frame limit)
+    void WaitForGeneration() { mTasks.wait(); }
+
+    // Texture resolution for a mesh subdivision level (coarsest LOD => MIN_DIM)
+    static UINT DimForLOD(UINT subdiv, UINT maxSubdiv, UINT maxDim);
+
+    // Deterministic per virtual index; noise frequency scales with dim so every resolution looks the same
+    static void Generate(UINT virtualIndex, UINT dim, const AsteroidTextureParams& params, PooledTexture* texture);
+
+private:
+    static const UINT INVALID_SLOT = ~0U;
+
+    struct Virtual
+    {
+        std::atomic<UINT> slot;
+        std::atomic<UINT> residentDim;
+        std::atomic<UINT> requestedDim;  // Largest asked for since the last BeginFrame; 0 => none
+        std::atomic<UINT64> lastUsedFrame;
+        bool pending = false;            // Render thread only
+    };
+
+    struct Slot
+    {
+        IUnknown* texture = nullptr;
+        UINT virtualIndex = 0;
+        UINT64 bytes = 0;
+        UINT64 retiredFrame = 0;
+        enum State { FREE, RESIDENT, RETIRING } state = FREE;
+    };
+
+    enum AllocateResult { ALLOCATE_OK, ALLOCATE_RETRY, ALLOCATE_FULL };
+    AllocateResult AllocateSlot(UINT64 bytes, UINT64 lastUsedFrame, UINT* slot);
+    bool EvictLeastRecentlyUsed(UINT64 usedBefore);
+    void Retire(Slot* slot);
+
+    UINT mVirtualCount;
+    UINT mFirstSlot;
+    UINT64 mBudgetBytes;
+    UINT mFramesInFlight;
+    CreateFunc mCreate;
+    BindFunc mBind;
+
+    std::unique_ptr<Virtual[]> mVirtual;
+    std::vector<Slot> mSlots;
+    std::atomic<UINT64> mResidentBytes;
+    std::atomic<UINT64> mFrame;
+    UINT64 mEvictions = 0;
+    std::shared_ptr<const AsteroidTextureParams> mTextureParams; // Replaced, never modified, on a change
+
+    concurrency::concurrent_queue<UINT> mRequests;
+
+    struct Completed
+    {
+        std::unique_ptr<PooledTexture> texture;
+        IUnknown* object = nullptr;
+        UINT64 bytes = 0;
+        std::shared_ptr<const AsteroidTextureParams> params; // Generated with; stale once replaced
+    };
+    std::mutex mCompletedMutex;
+    std::vector<Completed> mCompleted;
+    UINT mInFlight = 0; // Render thread only
+    concurrency::task_group mTasks;
+};